@@ -483,26 +483,28 @@ void nvim_buf_set_lines(uint64_t channel_id,
     lines[i] = NULL;
   }
 
-  // Now we may need to insert the remaining new old_len
-  for (size_t i = to_replace; i < new_len; i++) {
-    int64_t lnum = start + (int64_t)i - 1;
-
-    if (lnum >= MAXLNUM) {
+  // Now we may need to insert the remaining new old_len, all at once
+  if (new_len > to_replace) {
+    if (start + (int64_t)new_len - 2 >= MAXLNUM) {
       api_set_error(err, kErrorTypeValidation, "Index value is too high");
       goto end;
     }
 
-    if (ml_append((linenr_T)lnum, (char_u *)lines[i], 0, false) == FAIL) {
+    if (ml_append_lines((linenr_T)(start + (int64_t)to_replace - 1),
+                        (char_u **)lines + to_replace, NULL,
+                        (linenr_T)(new_len - to_replace), false) == FAIL) {
       api_set_error(err, kErrorTypeException, "Failed to insert line");
       goto end;
     }
 
-    inserted_bytes += (bcount_t)strlen(lines[i]) + 1;
+    for (size_t i = to_replace; i < new_len; i++) {
+      inserted_bytes += (bcount_t)strlen(lines[i]) + 1;
 
-    // Same as with replacing, but we also need to free lines
-    xfree(lines[i]);
-    lines[i] = NULL;
-    extra++;
+      // Same as with replacing, but we also need to free lines
+      xfree(lines[i]);
+      lines[i] = NULL;
+      extra++;
+    }
   }
 
   // Adjust marks. Invalidate any which lie in the
@@ -723,24 +725,26 @@ void nvim_buf_set_text(uint64_t channel_id, Buffer buffer,
     lines[i] = NULL;
   }
 
-  // Now we may need to insert the remaining new old_len
-  for (size_t i = to_replace; i < new_len; i++) {
-    int64_t lnum = start_row + (int64_t)i - 1;
-
-    if (lnum >= MAXLNUM) {
+  // Now we may need to insert the remaining new old_len, all at once
+  if (new_len > to_replace) {
+    if (start_row + (int64_t)new_len - 2 >= MAXLNUM) {
       api_set_error(err, kErrorTypeValidation, "Index value is too high");
       goto end;
     }
 
-    if (ml_append((linenr_T)lnum, (char_u *)lines[i], 0, false) == FAIL) {
+    if (ml_append_lines((linenr_T)(start_row + (int64_t)to_replace - 1),
+                        (char_u **)lines + to_replace, NULL,
+                        (linenr_T)(new_len - to_replace), false) == FAIL) {
       api_set_error(err, kErrorTypeException, "Failed to insert line");
       goto end;
     }
 
-    // Same as with replacing, but we also need to free lines
-    xfree(lines[i]);
-    lines[i] = NULL;
-    extra++;
+    for (size_t i = to_replace; i < new_len; i++) {
+      // Same as with replacing, but we also need to free lines
+      xfree(lines[i]);
+      lines[i] = NULL;
+      extra++;
+    }
   }
 
   // Adjust marks. Invalidate any which lie in the
@@ -11,10 +11,12 @@
 #include "nvim/memory.h"
 #include "nvim/map.h"
 #include "nvim/msgpack_rpc/channel.h"
+#include "nvim/msgpack_rpc/helpers.h"
 #include "nvim/api/ui.h"
 #include "nvim/api/private/defs.h"
 #include "nvim/api/private/helpers.h"
 #include "nvim/popupmnu.h"
+#include "nvim/profile.h"
 #include "nvim/cursor_shape.h"
 #include "nvim/highlight.h"
 #include "nvim/screen.h"
@@ -27,7 +29,17 @@
 
 typedef struct {
   uint64_t channel_id;
-  Array buffer;
+
+  // "redraw" notification with the events since the last flush, encoded as
+  // they are pushed.  Array sizes that are not known yet are filled in later,
+  // see reserve_array_size().
+  msgpack_sbuffer sbuffer;
+  msgpack_packer packer;
+  size_t nevents;          // number of events in sbuffer
+  size_t nevents_pos;      // offset of the size of the array of events
+  const char *cur_event;   // name of the last event, a static string
+  size_t ncalls;           // number of items in the last event
+  size_t ncalls_pos;       // offset of the size of the last event
 
   int hl_id;  // Current highlight for legacy put event.
   Integer cursor_row, cursor_col;  // Intended visible cursor position.
@@ -53,7 +65,7 @@ void remote_ui_disconnect(uint64_t channel_id)
     return;
   }
   UIData *data = ui->data;
-  api_free_array(data->buffer);  // Destroy pending screen updates.
+  msgpack_sbuffer_destroy(&data->sbuffer);  // Destroy pending screen updates.
   pmap_del(uint64_t)(connected_uis, channel_id);
   xfree(ui->data);
   ui->data = NULL;  // Flag UI as "stopped".
@@ -166,7 +178,10 @@ void nvim_ui_attach(uint64_t channel_id, Integer width, Integer height,
 
   UIData *data = xmalloc(sizeof(UIData));
   data->channel_id = channel_id;
-  data->buffer = (Array)ARRAY_DICT_INIT;
+  msgpack_sbuffer_init(&data->sbuffer);
+  msgpack_packer_init(&data->packer, &data->sbuffer, msgpack_sbuffer_write);
+  data->nevents = 0;
+  data->cur_event = NULL;
   data->hl_id = 0;
   data->client_col = -1;
   data->wildmenu_active = false;
@@ -397,27 +412,71 @@ void nvim_ui_pum_set_bounds(uint64_t channel_id, Float width, Float height,
   ui->pum_pos = true;
 }
 
-/// Pushes data into UI.UIData, to be consumed later by remote_ui_flush().
-static void push_call(UI *ui, const char *name, Array args)
+/// Writes a placeholder for the size of an array to "sbuffer", to be filled
+/// in by set_array_size() when the number of items is known.
+///
+/// @return offset of the placeholder in "sbuffer".
+static size_t reserve_array_size(msgpack_sbuffer *sbuffer)
+{
+  size_t pos = sbuffer->size;
+  msgpack_sbuffer_write(sbuffer, "\xdd\0\0\0\0", 5);
+  return pos;
+}
+
+/// Fills in the placeholder written by reserve_array_size().  Always uses
+/// the 32 bit form, which is valid msgpack for any size.
+static void set_array_size(msgpack_sbuffer *sbuffer, size_t pos, size_t size)
+{
+  uint8_t *p = (uint8_t *)sbuffer->data + pos + 1;
+  p[0] = (uint8_t)(size >> 24);
+  p[1] = (uint8_t)(size >> 16);
+  p[2] = (uint8_t)(size >> 8);
+  p[3] = (uint8_t)size;
+}
+
+/// Starts a call of "name" in UIData.sbuffer, the caller encodes the
+/// arguments array with UIData.packer.  Sent later by remote_ui_flush().
+///
+/// @param name  event name, must be a static string
+static void prepare_call(UI *ui, const char *name)
 {
-  Array call = ARRAY_DICT_INIT;
   UIData *data = ui->data;
+  msgpack_packer *pac = &data->packer;
 
-  // To optimize data transfer(especially for "put"), we bundle adjacent
-  // calls to same method together, so only add a new call entry if the last
-  // method call is different from "name"
-  if (kv_size(data->buffer)) {
-    call = kv_A(data->buffer, kv_size(data->buffer) - 1).data.array;
+  if (data->nevents == 0) {
+    // [2, "redraw", [event, ...]]
+    msgpack_sbuffer_clear(&data->sbuffer);
+    msgpack_pack_array(pac, 3);
+    msgpack_pack_int(pac, 2);
+    msgpack_rpc_from_string(STATIC_CSTR_AS_STRING("redraw"), pac);
+    data->nevents_pos = reserve_array_size(&data->sbuffer);
+    data->cur_event = NULL;
   }
 
-  if (!kv_size(call) || strcmp(kv_A(call, 0).data.string.data, name)) {
-    call = (Array)ARRAY_DICT_INIT;
-    ADD(data->buffer, ARRAY_OBJ(call));
-    ADD(call, STRING_OBJ(cstr_to_string(name)));
+  // To optimize data transfer(especially for "put"), we bundle adjacent
+  // calls to same method together: [name, args, args, ...]. Only start a new
+  // event if the last method call is different from "name".
+  if (data->cur_event == NULL || strcmp(data->cur_event, name) != 0) {
+    if (data->cur_event != NULL) {
+      set_array_size(&data->sbuffer, data->ncalls_pos, data->ncalls);
+    }
+    data->ncalls_pos = reserve_array_size(&data->sbuffer);
+    msgpack_rpc_from_string(cstr_as_string((char *)name), pac);
+    data->cur_event = name;
+    data->ncalls = 1;
+    data->nevents++;
   }
+  data->ncalls++;
+}
 
-  ADD(call, ARRAY_OBJ(args));
-  kv_A(data->buffer, kv_size(data->buffer) - 1).data.array = call;
+/// Pushes data into UI.UIData, to be consumed later by remote_ui_flush().
+/// Takes ownership of "args".
+static void push_call(UI *ui, const char *name, Array args)
+{
+  UIData *data = ui->data;
+  prepare_call(ui, name);
+  msgpack_rpc_from_array(args, &data->packer);
+  api_free_array(args);
 }
 
 static void remote_ui_grid_clear(UI *ui, Integer grid)
@@ -598,47 +657,54 @@ static void remote_ui_raw_line(UI *ui, Integer grid, Integer row,
 {
   UIData *data = ui->data;
   if (ui->ui_ext[kUILinegrid]) {
-    Array args = ARRAY_DICT_INIT;
-    ADD(args, INTEGER_OBJ(grid));
-    ADD(args, INTEGER_OBJ(row));
-    ADD(args, INTEGER_OBJ(startcol));
-    Array cells = ARRAY_DICT_INIT;
+    // Encoded directly, a full screen redraw would otherwise allocate an
+    // Array and a String for every cell.
+    msgpack_packer *pac = &data->packer;
+    prepare_call(ui, "grid_line");
+    msgpack_pack_array(pac, 4);
+    msgpack_rpc_from_integer(grid, pac);
+    msgpack_rpc_from_integer(row, pac);
+    msgpack_rpc_from_integer(startcol, pac);
+    size_t cells_pos = reserve_array_size(&data->sbuffer);
+    size_t ncells_out = 0;
     int repeat = 0;
     size_t ncells = (size_t)(endcol-startcol);
     int last_hl = -1;
     for (size_t i = 0; i < ncells; i++) {
       repeat++;
-      if (i == ncells-1 || attrs[i] != attrs[i+1]
-          || STRCMP(chunk[i], chunk[i+1])) {
-        Array cell = ARRAY_DICT_INIT;
-        ADD(cell, STRING_OBJ(cstr_to_string((const char *)chunk[i])));
-        if (attrs[i] != last_hl || repeat > 1) {
-          ADD(cell, INTEGER_OBJ(attrs[i]));
+      if (i == ncells-1 || attrs[i] != attrs[i+1] || chunk[i] != chunk[i+1]) {
+        bool add_hl = attrs[i] != last_hl || repeat > 1;
+        msgpack_pack_array(pac, 1 + (size_t)add_hl + (repeat > 1));
+        char text[MAX_SCHAR_SIZE];
+        size_t len = schar_get(text, chunk[i]);
+        msgpack_rpc_from_string((String){ .data = text, .size = len }, pac);
+        if (add_hl) {
+          msgpack_rpc_from_integer(attrs[i], pac);
           last_hl = attrs[i];
         }
         if (repeat > 1) {
-          ADD(cell, INTEGER_OBJ(repeat));
+          msgpack_rpc_from_integer(repeat, pac);
         }
-        ADD(cells, ARRAY_OBJ(cell));
+        ncells_out++;
         repeat = 0;
       }
     }
     if (endcol < clearcol) {
-      Array cell = ARRAY_DICT_INIT;
-      ADD(cell, STRING_OBJ(cstr_to_string(" ")));
-      ADD(cell, INTEGER_OBJ(clearattr));
-      ADD(cell, INTEGER_OBJ(clearcol-endcol));
-      ADD(cells, ARRAY_OBJ(cell));
+      msgpack_pack_array(pac, 3);
+      msgpack_rpc_from_string(STATIC_CSTR_AS_STRING(" "), pac);
+      msgpack_rpc_from_integer(clearattr, pac);
+      msgpack_rpc_from_integer(clearcol-endcol, pac);
+      ncells_out++;
     }
-    ADD(args, ARRAY_OBJ(cells));
-
-    push_call(ui, "grid_line", args);
+    set_array_size(&data->sbuffer, cells_pos, ncells_out);
   } else {
     for (int i = 0; i < endcol-startcol; i++) {
       remote_ui_cursor_goto(ui, row, startcol+i);
       remote_ui_highlight_set(ui, attrs[i]);
-      remote_ui_put(ui, (const char *)chunk[i]);
-      if (utf_ambiguous_width(utf_ptr2char(chunk[i]))) {
+      char text[MAX_SCHAR_SIZE];
+      schar_get(text, chunk[i]);
+      remote_ui_put(ui, text);
+      if (utf_ambiguous_width(utf_ptr2char((char_u *)text))) {
         data->client_col = -1;  // force cursor update
       }
     }
@@ -662,13 +728,17 @@ static void remote_ui_raw_line(UI *ui, Integer grid, Integer row,
 static void remote_ui_flush(UI *ui)
 {
   UIData *data = ui->data;
-  if (data->buffer.size > 0) {
+  if (data->nevents > 0) {
     if (!ui->ui_ext[kUILinegrid]) {
       remote_ui_cursor_goto(ui, data->cursor_row, data->cursor_col);
     }
     push_call(ui, "flush", (Array)ARRAY_DICT_INIT);
-    rpc_send_event(data->channel_id, "redraw", data->buffer);
-    data->buffer = (Array)ARRAY_DICT_INIT;
+    set_array_size(&data->sbuffer, data->ncalls_pos, data->ncalls);
+    set_array_size(&data->sbuffer, data->nevents_pos, data->nevents);
+    REDRAW_PROF_COUNT(kRedrawCountBytes, data->sbuffer.size);
+    rpc_send_encoded(data->channel_id, &data->sbuffer);
+    data->nevents = 0;
+    data->cur_event = NULL;
   }
 }
 
@@ -748,7 +818,7 @@ static void remote_ui_event(UI *ui, char *name, Array args, bool *args_consumed)
         if (args.items[1].data.integer != -1) {
           Array new_args2 = ARRAY_DICT_INIT;
           ADD(new_args2, args.items[1]);
-          push_call(ui, "wildmenu_select", new_args);
+          push_call(ui, "wildmenu_select", new_args2);
         }
         return;
       }
@@ -764,18 +834,9 @@ static void remote_ui_event(UI *ui, char *name, Array args, bool *args_consumed)
   }
 
 
-  Array my_args = ARRAY_DICT_INIT;
-  // Objects are currently single-reference
-  // make a copy, but only if necessary
-  if (*args_consumed) {
-    for (size_t i = 0; i < args.size; i++) {
-      ADD(my_args, copy_object(args.items[i]));
-    }
-  } else {
-    my_args = args;
-    *args_consumed = true;
-  }
-  push_call(ui, name, my_args);
+  // Encoded right away, no need to copy or consume "args".
+  prepare_call(ui, name);
+  msgpack_rpc_from_array(args, &data->packer);
 }
 
 static void remote_ui_inspect(UI *ui, Dictionary *info)
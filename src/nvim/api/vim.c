@@ -34,6 +34,7 @@
 #include "nvim/memory.h"
 #include "nvim/message.h"
 #include "nvim/popupmnu.h"
+#include "nvim/profile.h"
 #include "nvim/edit.h"
 #include "nvim/eval.h"
 #include "nvim/eval/typval.h"
@@ -2130,35 +2131,11 @@ Array nvim_call_atomic(uint64_t channel_id, Array calls, Error *err)
 
   size_t i;  // also used for freeing the variables
   for (i = 0; i < calls.size; i++) {
-    if (calls.items[i].type != kObjectTypeArray) {
-      api_set_error(err,
-                    kErrorTypeValidation,
-                    "Items in calls array must be arrays");
+    String name;
+    Array args;
+    if (!parse_call(calls.items[i], &name, &args, err)) {
       goto validation_error;
     }
-    Array call = calls.items[i].data.array;
-    if (call.size != 2) {
-      api_set_error(err,
-                    kErrorTypeValidation,
-                    "Items in calls array must be arrays of size 2");
-      goto validation_error;
-    }
-
-    if (call.items[0].type != kObjectTypeString) {
-      api_set_error(err,
-                    kErrorTypeValidation,
-                    "Name must be String");
-      goto validation_error;
-    }
-    String name = call.items[0].data.string;
-
-    if (call.items[1].type != kObjectTypeArray) {
-      api_set_error(err,
-                    kErrorTypeValidation,
-                    "Args must be Array");
-      goto validation_error;
-    }
-    Array args = call.items[1].data.array;
 
     MsgpackRpcRequestHandler handler =
         msgpack_rpc_get_handler_for(name.data,
@@ -2196,6 +2173,121 @@ theend:
   return rv;
 }
 
+/// Calls many API methods like |nvim_call_atomic()|, but sends the result of
+/// each call back as soon as it returns instead of collecting all results in
+/// one array. For a batch that returns a lot of data this keeps memory use
+/// flat and lets the client start processing before the batch is done.
+///
+/// Each result is sent as a "nvim__call_batch" notification with the
+/// zero-based index of the call and its return value. The notifications
+/// arrive before the response to this request.
+///
+/// @param channel_id
+/// @param calls an array of calls, where each call is described by an array
+///              with two elements: the request name, and an array of arguments.
+/// @param[out] err Validation error details (malformed `calls` parameter),
+///             if any. No call is made then.
+///
+/// @return Array of two elements. The first is the number of calls that
+/// succeeded. The second is NIL if all calls succeeded. If a call resulted in
+/// an error, it is a three-element array with the zero-based index of the call
+/// which resulted in an error, the error type and the error message. The calls
+/// after it are not made.
+Array nvim__call_batch(uint64_t channel_id, Array calls, Error *err)
+  FUNC_API_REMOTE_ONLY
+{
+  Array rv = ARRAY_DICT_INIT;
+  Error nested_error = ERROR_INIT;
+
+  // Check all calls first, results are sent while going.
+  for (size_t i = 0; i < calls.size; i++) {
+    String name;
+    Array args;
+    if (!parse_call(calls.items[i], &name, &args, err)) {
+      return rv;
+    }
+  }
+
+  size_t i;
+  for (i = 0; i < calls.size; i++) {
+    String name;
+    Array args;
+    parse_call(calls.items[i], &name, &args, err);
+    MsgpackRpcRequestHandler handler =
+        msgpack_rpc_get_handler_for(name.data,
+                                    name.size,
+                                    &nested_error);
+    if (ERROR_SET(&nested_error)) {
+      break;
+    }
+    Object result = handler.fn(channel_id, args, &nested_error);
+    if (ERROR_SET(&nested_error)) {
+      break;
+    }
+
+    Array event = ARRAY_DICT_INIT;
+    ADD(event, INTEGER_OBJ((Integer)i));
+    ADD(event, result);
+    if (!rpc_send_event(channel_id, "nvim__call_batch", event)) {
+      // The channel was closed by the call.
+      i++;
+      break;
+    }
+  }
+
+  ADD(rv, INTEGER_OBJ((Integer)i));
+  if (ERROR_SET(&nested_error)) {
+    Array errval = ARRAY_DICT_INIT;
+    ADD(errval, INTEGER_OBJ((Integer)i));
+    ADD(errval, INTEGER_OBJ(nested_error.type));
+    ADD(errval, STRING_OBJ(cstr_to_string(nested_error.msg)));
+    ADD(rv, ARRAY_OBJ(errval));
+  } else {
+    ADD(rv, NIL);
+  }
+  api_clear_error(&nested_error);
+  return rv;
+}
+
+/// Gets the name and the arguments of an item of the "calls" argument of
+/// nvim_call_atomic().
+///
+/// @return false if the item is not a [name, args] pair.
+static bool parse_call(Object item, String *name, Array *args, Error *err)
+  FUNC_ATTR_NONNULL_ALL
+{
+  if (item.type != kObjectTypeArray) {
+    api_set_error(err,
+                  kErrorTypeValidation,
+                  "Items in calls array must be arrays");
+    return false;
+  }
+  Array call = item.data.array;
+  if (call.size != 2) {
+    api_set_error(err,
+                  kErrorTypeValidation,
+                  "Items in calls array must be arrays of size 2");
+    return false;
+  }
+
+  if (call.items[0].type != kObjectTypeString) {
+    api_set_error(err,
+                  kErrorTypeValidation,
+                  "Name must be String");
+    return false;
+  }
+  *name = call.items[0].data.string;
+
+  if (call.items[1].type != kObjectTypeArray) {
+    api_set_error(err,
+                  kErrorTypeValidation,
+                  "Args must be Array");
+    return false;
+  }
+  *args = call.items[1].data.array;
+  return true;
+}
+
 typedef struct {
   ExprASTNode **node_p;
   Object *ret_node_p;
@@ -2738,10 +2830,119 @@ Dictionary nvim__stats(void)
   Dictionary rv = ARRAY_DICT_INIT;
   PUT(rv, "fsync", INTEGER_OBJ(g_stats.fsync));
   PUT(rv, "redraw", INTEGER_OBJ(g_stats.redraw));
+  PUT(rv, "memfile_hit", INTEGER_OBJ(g_stats.memfile_hit));
+  PUT(rv, "memfile_read", INTEGER_OBJ(g_stats.memfile_read));
+  PUT(rv, "memfile_write", INTEGER_OBJ(g_stats.memfile_write));
+  PUT(rv, "memfile_release", INTEGER_OBJ(g_stats.memfile_release));
+  PUT(rv, "memfile_pack", INTEGER_OBJ(g_stats.memfile_pack));
+  PUT(rv, "memfile_nopack", INTEGER_OBJ(g_stats.memfile_nopack));
+  PUT(rv, "rpc_write", INTEGER_OBJ(g_stats.rpc_write));
   PUT(rv, "lua_refcount", INTEGER_OBJ(nlua_refcount));
   return rv;
 }
 
+/// Controls the redraw profiler and gets what it collected.
+///
+/// A frame starts when the screen is redrawn and ends when the UIs are
+/// flushed. Times are in microseconds. Phases nest, the time of "line" is
+/// also counted for "window" and "screen".
+///
+/// @param opts  Optional parameters, applied in order:
+///              - enable: (boolean) start or stop profiling
+///              - reset:  (boolean) clear the collected data
+///              - log:    (string) append a line per frame to this file, an
+///                        empty string stops logging. Also see
+///                        |--redrawtime-log|.
+/// @param[out] err Error details, if any
+/// @return Map with these keys:
+///   - "enabled" true if the profiler is running
+///   - "frames"  number of frames
+///   - "lines", "cells", "bytes"  number of buffer lines drawn, grid cells
+///               sent to the UIs and bytes written to the UIs
+///   - "phases"  map of "screen", "window", "line", "decor", "syntax",
+///               "compose", "flush" and "frame" to maps with keys "total",
+///               "max" (longest frame), "count" (times entered) and "hist"
+///               (frames by time, bucket i is [2^i, 2^(i+1)) microseconds)
+Dictionary nvim__redraw_profile(Dictionary opts, Error *err)
+{
+  for (size_t i = 0; i < opts.size; i++) {
+    String k = opts.items[i].key;
+    Object v = opts.items[i].value;
+    if (strequal("enable", k.data) || strequal("reset", k.data)) {
+      if (v.type != kObjectTypeBoolean) {
+        api_set_error(err, kErrorTypeValidation, "invalid value for key: %s",
+                      k.data);
+        return (Dictionary)ARRAY_DICT_INIT;
+      }
+      if (strequal("enable", k.data)) {
+        redraw_prof_enabled = v.data.boolean;
+      } else if (v.data.boolean) {
+        redraw_prof_reset();
+      }
+    } else if (strequal("log", k.data)) {
+      if (v.type != kObjectTypeString) {
+        api_set_error(err, kErrorTypeValidation, "invalid value for key: %s",
+                      k.data);
+        return (Dictionary)ARRAY_DICT_INIT;
+      }
+      const char *fname = v.data.string.size ? v.data.string.data : NULL;
+      if (!redraw_prof_set_log(fname)) {
+        api_set_error(err, kErrorTypeException, "Failed to open log file: %s",
+                      fname);
+        return (Dictionary)ARRAY_DICT_INIT;
+      }
+    } else {
+      api_set_error(err, kErrorTypeValidation, "unexpected key: %s", k.data);
+      return (Dictionary)ARRAY_DICT_INIT;
+    }
+  }
+
+  const RedrawProfStats *stats = redraw_prof_stats();
+  Dictionary rv = ARRAY_DICT_INIT;
+  PUT(rv, "enabled", BOOLEAN_OBJ(redraw_prof_enabled));
+  PUT(rv, "frames", INTEGER_OBJ(stats->frames));
+  for (int i = 0; i < kRedrawCountCount; i++) {
+    PUT(rv, redraw_prof_counter_name(i),
+        INTEGER_OBJ(redraw_prof_get_count(i)));
+  }
+  Dictionary phases = ARRAY_DICT_INIT;
+  for (int i = 0; i < kRedrawPhaseCount; i++) {
+    const RedrawPhaseStats *phase = &stats->phase[i];
+    Dictionary d = ARRAY_DICT_INIT;
+    PUT(d, "total", INTEGER_OBJ((Integer)(phase->total / 1000)));
+    PUT(d, "max", INTEGER_OBJ((Integer)(phase->max / 1000)));
+    PUT(d, "count", INTEGER_OBJ(phase->count));
+    Array hist = ARRAY_DICT_INIT;
+    for (int j = 0; j < REDRAW_HIST_SIZE; j++) {
+      ADD(hist, INTEGER_OBJ(phase->hist[j]));
+    }
+    PUT(d, "hist", ARRAY_OBJ(hist));
+    PUT(phases, redraw_prof_phase_name(i), DICTIONARY_OBJ(d));
+  }
+  PUT(rv, "phases", DICTIONARY_OBJ(phases));
+  return rv;
+}
+
+/// Moves the messages of this channel to shared memory, for a client on the
+/// same machine that exchanges a lot of data, like a GUI.
+///
+/// Nvim creates a file that both processes map, see |rpc-shm|. After the
+/// response to this request, messages in both directions go through the
+/// shared memory and the channel only carries bytes that wake up the other
+/// side. The client must not send anything until it got the response.
+///
+/// @param channel_id
+/// @param size  Minimal size in bytes of each ring buffer, 0 for the
+///              default (64 KiB)
+/// @param[out] err Error details, if any
+/// @return Map with keys "path" (the file to map) and "size" (the size of each
+///         ring buffer)
+Dictionary nvim__shm_attach(uint64_t channel_id, Integer size, Error *err)
+  FUNC_API_REMOTE_ONLY
+{
+  return rpc_shm_attach(channel_id, size, err);
+}
+
 /// Gets a list of dictionaries representing attached UIs.
 ///
 /// @return Array of UI dictionaries, each with these keys:
@@ -2895,7 +3096,9 @@ Array nvim__inspect_cell(Integer grid, Integer row, Integer col, Error *err)
     return ret;
   }
   size_t off = g->line_offset[(size_t)row] + (size_t)col;
-  ADD(ret, STRING_OBJ(cstr_to_string((char *)g->chars[off])));
+  char text[MAX_SCHAR_SIZE];
+  schar_get(text, g->chars[off]);
+  ADD(ret, STRING_OBJ(cstr_to_string(text)));
   int attr = g->attrs[off];
   ADD(ret, DICTIONARY_OBJ(hl_get_attr_by_id(attr, true, err)));
   // will not work first time
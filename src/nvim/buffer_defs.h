@@ -964,6 +964,42 @@ typedef struct w_line {
   linenr_T wl_lastlnum;         // last buffer line number for logical line
 } wline_T;
 
+/// Screen row of a line in the cache of drawn lines: the arguments used for
+/// grid_put_linebuf() and where its cells are stored.
+typedef struct {
+  int lcr_off;                  // index of the first cell in lc_chars[]
+  int lcr_endcol;               // number of cells
+  int lcr_clear_width;          // "clear_width" argument
+  bool lcr_wrap;                // line continues in the next row
+} linecache_row_T;
+
+/// Buffer line as drawn by win_line().  Used to draw it again without
+/// evaluating syntax, listchars, etc. when it was scrolled out of the window
+/// and back in.  See line_cache_draw().
+typedef struct {
+  linenr_T lc_lnum;             // buffer line number, zero when unused
+  int lc_nrows;                 // number of screen rows
+  int lc_rowsize;               // allocated entries in lc_rows[]
+  linecache_row_T *lc_rows;
+  int lc_ncells;                // number of used cells
+  int lc_cellsize;              // allocated cells
+  schar_T *lc_chars;
+  sattr_T *lc_attrs;
+} linecache_T;
+
+/// Everything that may change how a line is drawn, other than the window
+/// options and highlights (see "line_cache_gen").  The cache of drawn lines
+/// of a window is emptied when one of these changes.
+typedef struct {
+  handle_T lck_buf;             // handle of the buffer
+  varnumber_T lck_changedtick;  // b:changedtick
+  int lck_gen;                  // "line_cache_gen"
+  int lck_width;                // width of the window grid
+  int lck_columns;              // "Columns"
+  colnr_T lck_leftcol;          // w_leftcol
+  int lck_nrwidth;              // w_nrwidth
+} linecache_key_T;
+
 /*
  * Windows are kept in a tree of frames.  Each frame has a column (FR_COL)
  * or row (FR_ROW) layout or is a leaf, which has a window.
@@ -1334,6 +1370,11 @@ struct window_S {
   int w_lines_valid;                // number of valid entries
   wline_T     *w_lines;
 
+  // Cache of drawn lines, indexed by line number modulo LINE_CACHE_SIZE.
+  // NULL until it is used.
+  linecache_T *w_line_cache;
+  linecache_key_T w_line_cache_key;
+
   garray_T w_folds;                 // array of nested folds
   bool w_fold_manual;               // when true: some folds are opened/closed
                                     // manually
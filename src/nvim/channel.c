@@ -32,6 +32,7 @@ static uint64_t next_chan_id = CHAN_STDERR+1;
 /// Teardown the module
 void channel_teardown(void)
 {
+  rpc_teardown();
   if (!channels) {
     return;
   }
@@ -1560,7 +1560,7 @@ static int pc_status;
 #define PC_STATUS_RIGHT 1       // right halve of double-wide char
 #define PC_STATUS_LEFT  2       // left halve of double-wide char
 #define PC_STATUS_SET   3       // pc_bytes was filled
-static char_u pc_bytes[MB_MAXBYTES + 1];  // saved bytes
+static char_u pc_bytes[MAX_SCHAR_SIZE];  // saved bytes
 static int pc_attr;
 static int pc_row;
 static int pc_col;
@@ -7804,7 +7804,7 @@ static void f_screenchar(typval_T *argvars, typval_T *rettv, FunPtr fptr)
   } else {
     ScreenGrid *grid = &default_grid;
     screenchar_adjust_grid(&grid, &row, &col);
-    c = utf_ptr2char(grid->chars[grid->line_offset[row] + col]);
+    c = schar_get_first_codepoint(grid->chars[grid->line_offset[row] + col]);
   }
   rettv->vval.v_number = c;
 }
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <uv.h>
 
@@ -18,8 +19,10 @@
 
 typedef struct {
   Stream *stream;
-  WBuffer *buffer;
   uv_write_t uv_req;
+  size_t size;        // total size of the buffers
+  size_t count;
+  WBuffer *buffers[];
 } WRequest;
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
@@ -72,36 +75,71 @@ void wstream_set_write_cb(Stream *stream, stream_write_cb cb, void *data)
 /// @return false if the write failed
 bool wstream_write(Stream *stream, WBuffer *buffer)
   FUNC_ATTR_NONNULL_ALL
+{
+  return wstream_write_many(stream, &buffer, 1);
+}
+
+/// Like wstream_write(), but queues several buffers with a single write
+/// request, so that they are written with one writev() call.
+///
+/// @param stream The `Stream` instance
+/// @param buffers The buffers, released when written or on failure
+/// @param count Number of buffers
+/// @return false if the write failed
+bool wstream_write_many(Stream *stream, WBuffer **buffers, size_t count)
+  FUNC_ATTR_NONNULL_ALL
 {
   assert(stream->maxmem);
   // This should not be called after a stream was freed
   assert(!stream->closed);
 
+  if (count == 0) {
+    return true;
+  }
   if (stream->curmem > stream->maxmem) {
     goto err;
   }
 
-  stream->curmem += buffer->size;
+  size_t size = 0;
+  for (size_t i = 0; i < count; i++) {
+    size += buffers[i]->size;
+  }
 
-  WRequest *data = xmalloc(sizeof(WRequest));
+  WRequest *data = xmalloc(sizeof(WRequest) + count * sizeof(WBuffer *));
   data->stream = stream;
-  data->buffer = buffer;
+  data->size = size;
+  data->count = count;
+  memcpy(data->buffers, buffers, count * sizeof(WBuffer *));
   data->uv_req.data = data;
 
-  uv_buf_t uvbuf;
-  uvbuf.base = buffer->data;
-  uvbuf.len = UV_BUF_LEN(buffer->size);
+  // uv_write() copies the array of uv_buf_t.
+  uv_buf_t uvbufs_small[8];
+  uv_buf_t *uvbufs = (count <= ARRAY_SIZE(uvbufs_small)
+                      ? uvbufs_small
+                      : xmalloc(count * sizeof(uv_buf_t)));
+  for (size_t i = 0; i < count; i++) {
+    uvbufs[i].base = buffers[i]->data;
+    uvbufs[i].len = UV_BUF_LEN(buffers[i]->size);
+  }
 
-  if (uv_write(&data->uv_req, stream->uvstream, &uvbuf, 1, write_cb)) {
+  int status = uv_write(&data->uv_req, stream->uvstream, uvbufs,
+                        (unsigned)count, write_cb);
+  if (uvbufs != uvbufs_small) {
+    xfree(uvbufs);
+  }
+  if (status) {
     xfree(data);
     goto err;
   }
 
+  stream->curmem += size;
   stream->pending_reqs++;
   return true;
 
 err:
-  wstream_release_wbuffer(buffer);
+  for (size_t i = 0; i < count; i++) {
+    wstream_release_wbuffer(buffers[i]);
+  }
   return false;
 }
 
@@ -136,9 +174,11 @@ static void write_cb(uv_write_t *req, int status)
 {
   WRequest *data = req->data;
 
-  data->stream->curmem -= data->buffer->size;
+  data->stream->curmem -= data->size;
 
-  wstream_release_wbuffer(data->buffer);
+  for (size_t i = 0; i < data->count; i++) {
+    wstream_release_wbuffer(data->buffers[i]);
+  }
 
   if (data->stream->write_cb) {
     data->stream->write_cb(data->stream, data->stream->cb_data, status);
@@ -10,6 +10,8 @@
 #include <inttypes.h>
 #include <fcntl.h>
 
+#include <uv.h>
+
 #include "nvim/vim.h"
 #include "nvim/api/private/handle.h"
 #include "nvim/ascii.h"
@@ -19,6 +21,7 @@
 #include "nvim/change.h"
 #include "nvim/charset.h"
 #include "nvim/cursor.h"
+#include "nvim/decoration.h"
 #include "nvim/diff.h"
 #include "nvim/edit.h"
 #include "nvim/eval/userfunc.h"
@@ -37,6 +40,7 @@
 #include "nvim/message.h"
 #include "nvim/misc1.h"
 #include "nvim/garray.h"
+#include "nvim/lib/kvec.h"
 #include "nvim/move.h"
 #include "nvim/normal.h"
 #include "nvim/option.h"
@@ -87,6 +91,75 @@
  * with iconv() to be able to allocate a buffer. */
 #define ICONV_MULT 8
 
+// Files of at least this size are read by mapping them into memory, when
+// no conversion is needed.  See readfile_mmap().
+#define READ_MMAP_MIN (1024L * 1024L)
+// Number of lines passed to ml_append_lines() at a time by readfile_mmap().
+#define READ_MMAP_BATCH 256
+// Number of bytes readfile_mmap() appends and draws before scanning the
+// rest of the file.
+#define READ_MMAP_HEAD (64L * 1024L)
+
+// Big files are scanned by several threads, each taking parts of at least
+// READ_SCAN_PART bytes.  A part must fit in the uint32_t line end offsets.
+#define READ_SCAN_PART (4L * 1024L * 1024L)
+#define READ_SCAN_PART_MAX (1024L * 1024L * 1024L)
+#define READ_SCAN_THREADS 8
+
+/// Part of a file scanned by readfile_scan_part().
+typedef struct {
+  const char_u *text;      ///< start of the whole text
+  const char_u *text_end;  ///< end of the whole text
+  const char_u *start;     ///< start of this part, at a character boundary
+  const char_u *end;       ///< end of this part, start of the next one
+  bool check_utf8;         ///< check for illegal UTF-8
+  size_t crlf;             ///< number of NL characters preceded by a CR
+  size_t cr;               ///< number of CR characters
+  bool has_nul;            ///< found a NUL byte, scanning stopped there
+  bool bad_utf8;           ///< found an illegal byte, scanning stopped there
+  bool faulted;            ///< the file was truncated, scanning stopped there
+  kvec_t(uint32_t) eols;   ///< offsets of the NL characters from "start"
+} ReadScanPart;
+
+/// Line index and counts produced by readfile_scan() for a whole file.
+typedef struct {
+  size_t nl;            ///< number of NL characters
+  size_t crlf;          ///< number of NL characters preceded by a CR
+  size_t cr;            ///< number of CR characters
+  size_t max_len;       ///< length of the longest line, including a CR
+  bool has_nul;         ///< found a NUL byte
+  bool bad_utf8;        ///< found an illegal UTF-8 sequence
+  bool faulted;         ///< the file was truncated while scanning it
+  int nparts;           ///< number of items in "parts"
+  ReadScanPart *parts;  ///< line ends in file order
+} ReadScan;
+
+/// State of readfile_append_scan().
+typedef struct {
+  linenr_T *lnump;              ///< line to append after
+  bool newfile;                 ///< passed on to ml_append_lines()
+  int fileformat;               ///< EOL_UNIX or EOL_DOS
+  context_sha256_T *sha_ctx;    ///< updated for the undo file, can be NULL
+  const char_u *line;           ///< start of the next line in the mapping
+  const char_u *next_check;     ///< check for CTRL-C when reaching this
+  bool interrupted;             ///< got CTRL-C
+  bool faulted;                 ///< the file was truncated while reading it
+  const char_u *batch_start;    ///< start of the first line of the batch
+  size_t batch_offs[READ_MMAP_BATCH];  ///< line offsets from "batch_start"
+  colnr_T batch_lens[READ_MMAP_BATCH];
+  char_u *batch[READ_MMAP_BATCH];      ///< the lines in "copy"
+  linenr_T nbatch;              ///< number of lines in the batch
+  char_u *copy;                 ///< text copied out of the mapping
+  size_t copy_size;             ///< allocated size of "copy"
+} ReadAppend;
+
+/// Arguments for readfile_scan_worker().
+typedef struct {
+  ReadScan *scan;
+  int first;  ///< first part to scan
+  int step;   ///< scan every "step" part from "first"
+} ReadScanWorker;
+
 /*
  * Structure to pass arguments from buf_write() to buf_write_bytes().
  */
@@ -905,6 +978,23 @@ retry:
       sha256_start(&sha_ctx);
   }
 
+  // Big file that doesn't need conversion: try reading it from a mapping.
+  if (!skip_read && !converted && fio_flags == 0 && tmpname == NULL
+      && !read_stdin && !read_buffer && !read_fifo
+      && skip_count == 0 && read_count == MAXLNUM) {
+    int ret = readfile_mmap(fd, fenc, &lnum, newfile, &fileformat,
+                            try_unix, try_dos, try_mac, set_options,
+                            newfile && !filtering && !(flags & READ_DUMMY)
+                            && curwin->w_buffer == curbuf,
+                            read_undo_file ? &sha_ctx : NULL,
+                            &filesize, &read_no_eol_lnum);
+    if (ret != NOTDONE) {
+      error = (ret == FAIL);
+      linerest = 0;
+      goto failed;
+    }
+  }
+
   while (!error && !got_int) {
     /*
      * We allocate as much space for the file as we can get, plus
@@ -1911,6 +2001,567 @@ failed:
   return OK;
 }
 
+/// Read a big file that needs no conversion by mapping it into memory and
+/// appending the lines straight from the mapping.  This avoids copying the
+/// text into a read buffer and the byte-by-byte loop of readfile().
+///
+/// Nothing is appended when the file needs the special handling done by the
+/// read() loop: NUL bytes, illegal UTF-8, a BOM, Mac line endings, missing
+/// CRs in Dos format or very long lines.
+///
+/// @param fd  File to read, at the start of the file.
+/// @param fenc  'fileencoding' used for reading.
+/// @param[in,out] lnump  Line to append after, incremented for every line.
+/// @param newfile  Passed on to ml_append().
+/// @param[in,out] fileformatp  End-of-line format, EOL_UNKNOWN to detect it.
+/// @param try_unix  'fileformats' contains "unix".
+/// @param try_dos  'fileformats' contains "dos".
+/// @param try_mac  'fileformats' contains "mac".
+/// @param set_options  Set 'fileformat' and 'eol' for the buffer.
+/// @param show_top  Draw the window once the lines in the first
+///                  READ_MMAP_HEAD bytes are appended, before the rest of
+///                  the file is scanned.  Not done when drawing would run
+///                  user code on the partly read buffer, see
+///                  readfile_can_show_top().  CTRL-C stops reading, like
+///                  for the read() loop.
+/// @param sha_ctx  When not NULL, updated with the text for the undo file.
+/// @param[out] filesizep  Number of bytes read.
+/// @param[out] no_eol_lnump  Set when the last line has no end-of-line.
+///
+/// @return NOTDONE when the file must be read with read(), FAIL when
+///         appending a line failed, OK otherwise.
+static int readfile_mmap(int fd, char_u *fenc, linenr_T *lnump, bool newfile,
+                         int *fileformatp, int try_unix, int try_dos,
+                         int try_mac, bool set_options, bool show_top,
+                         context_sha256_T *sha_ctx, off_T *filesizep,
+                         linenr_T *no_eol_lnump)
+  FUNC_ATTR_NONNULL_ARG(2, 3, 5, 12, 13)
+{
+  FileInfo file_info;
+  if (!os_fileinfo_fd(fd, &file_info)
+      || !S_ISREG(file_info.stat.st_mode)
+      || file_info.stat.st_size < READ_MMAP_MIN
+      || (uint64_t)file_info.stat.st_size > SIZE_MAX) {
+    return NOTDONE;
+  }
+  const size_t size = (size_t)file_info.stat.st_size;
+  const char_u *const text = (const char_u *)os_mmap_read(fd, size);
+  if (text == NULL) {
+    return NOTDONE;
+  }
+
+  // The file may be truncated or rewritten while reading it, e.g. by
+  // logrotate.  The mapping is only read with os_mmap_call() and
+  // os_mmap_copy(), which fail instead of raising SIGBUS, and read() is used
+  // then.
+  int ret = NOTDONE;
+  const int orig_fileformat = *fileformatp;
+  int fileformat = *fileformatp;
+  const char_u *const end = text + size;
+  const linenr_T first_lnum = *lnump;
+  const bool check_utf8 = !curbuf->b_p_bin;
+  ReadAppend ra = {
+    .lnump = lnump,
+    .newfile = newfile,
+    .sha_ctx = sha_ctx,
+    .line = text,
+    .next_check = text + 0x100000,
+  };
+  context_sha256_T sha_save;
+  ReadScan head;
+  ReadScan scan;
+  memset(&sha_save, 0, sizeof(sha_save));
+  memset(&head, 0, sizeof(head));
+  memset(&scan, 0, sizeof(scan));
+  if (sha_ctx != NULL) {
+    sha_save = *sha_ctx;
+  }
+
+  // Append and draw the first lines before the rest of the file is scanned,
+  // scanning a big cold file means reading all of it from disk.
+  size_t head_size = 0;
+  if (show_top && readfile_can_show_top()) {
+    char_u *const top = xmalloc((size_t)READ_MMAP_HEAD);
+    if (os_mmap_copy((char *)top, (const char *)text,
+                     (size_t)READ_MMAP_HEAD)) {
+      const char_u *eol = xmemrchr(top, NL, (size_t)READ_MMAP_HEAD);
+      head_size = eol == NULL ? 0 : (size_t)(eol - top) + 1;
+    }
+    xfree(top);
+  }
+  if (head_size > 0) {
+    readfile_scan(text, head_size, check_utf8, &head);
+    // When the first lines can't be used the whole file can't either.
+    if (!readfile_scan_ok(&head, text, head_size, fenc, &fileformat,
+                          try_unix, try_dos, try_mac)) {
+      goto theend;
+    }
+    ra.fileformat = fileformat;
+    if (readfile_append_scan(&ra, &head) == FAIL) {
+      if (ra.faulted) {
+        goto undo;
+      }
+      ret = FAIL;
+      goto theend;
+    }
+    readfile_show_top();
+    fileformat = *fileformatp;
+  }
+
+  readfile_scan(text + head_size, size - head_size, check_utf8, &scan);
+  readfile_scan_add(&scan, &head);
+
+  // Check again before appending, read() can still take over.
+  if (!readfile_unchanged(fd, &file_info)
+      || !readfile_scan_ok(&scan, text, size, fenc, &fileformat,
+                           try_unix, try_dos, try_mac)
+      || (head_size > 0 && fileformat != ra.fileformat)) {
+    goto undo;
+  }
+  *fileformatp = fileformat;
+  if (set_options) {
+    set_fileformat(fileformat, OPT_LOCAL);
+  }
+
+  ra.fileformat = fileformat;
+  if (readfile_append_scan(&ra, &scan) == FAIL) {
+    if (ra.faulted) {
+      goto undo;
+    }
+    ret = FAIL;
+    goto theend;
+  }
+
+  // Last line without an end-of-line.  In Dos format ignore a trailing
+  // CTRL-Z, unless 'binary' set.
+  const char_u *line = ra.line;
+  const colnr_T len = (colnr_T)(end - line);
+  if (!got_int && len > 0) {
+    line = readfile_copy(&ra, line, (size_t)len);
+    if (line == NULL) {
+      goto undo;
+    }
+  }
+  ret = OK;
+  if (!got_int && len > 0
+      && !(!curbuf->b_p_bin && fileformat == EOL_DOS
+           && *line == Ctrl_Z && len == 1)) {
+    if (set_options) {
+      curbuf->b_p_eol = false;
+    }
+    if (ml_append(*lnump, (char_u *)line, len + 1, newfile) == FAIL) {
+      ret = FAIL;
+    } else {
+      if (sha_ctx != NULL) {
+        sha256_update(sha_ctx, line, (size_t)len);
+        sha256_update(sha_ctx, (const char_u *)"", 1);
+      }
+      *no_eol_lnump = ++(*lnump);
+    }
+  }
+  *filesizep = (off_T)size;
+  goto theend;
+
+undo:
+  // The read() loop reads the file after all, remove the lines appended
+  // already.
+  ret = NOTDONE;
+  while (*lnump > first_lnum) {
+    ml_delete(first_lnum + 1, false);
+    (*lnump)--;
+  }
+  if (sha_ctx != NULL) {
+    *sha_ctx = sha_save;
+  }
+  *fileformatp = orig_fileformat;
+
+theend:
+  xfree(ra.copy);
+  readfile_scan_free(&head);
+  readfile_scan_free(&scan);
+  os_munmap((const char *)text, size);
+  return ret;
+}
+
+/// Check the result of readfile_scan() for anything that needs the read()
+/// loop, and decide on the end-of-line format the same way it does.
+///
+/// @param[in,out] fileformatp  End-of-line format, EOL_UNKNOWN to detect it.
+/// @return false when the file must be read with read().
+static bool readfile_scan_ok(const ReadScan *scan, const char_u *text,
+                             size_t size, char_u *fenc, int *fileformatp,
+                             int try_unix, int try_dos, int try_mac)
+  FUNC_ATTR_NONNULL_ALL
+{
+  int blen;
+  char_u start[4];  // enough for any BOM
+  const size_t nstart = MIN(size, sizeof(start));
+  if (scan->faulted || scan->has_nul || scan->bad_utf8
+      || scan->max_len >= (size_t)MAXCOL - 1
+      || !os_mmap_copy((char *)start, (const char *)text, nstart)
+      || (!curbuf->b_p_bin && !curbuf->b_p_bomb
+          && check_for_bom(start, (long)nstart, &blen,
+                           get_fio_flags(fenc)) != NULL)) {
+    return false;
+  }
+
+  int fileformat = *fileformatp;
+  if (fileformat == EOL_UNKNOWN) {
+    if (scan->nl == 0 || !(try_unix || try_dos)
+        || (try_mac && scan->cr != scan->crlf)) {
+      return false;
+    }
+    if (try_dos && (!try_unix || scan->crlf == scan->nl)) {
+      fileformat = EOL_DOS;
+    } else {
+      fileformat = EOL_UNIX;
+    }
+  }
+  if (fileformat == EOL_MAC
+      || (fileformat == EOL_DOS && scan->crlf != scan->nl)) {
+    return false;
+  }
+  *fileformatp = fileformat;
+  return true;
+}
+
+/// Add the counts of "head", the scan of the text before "scan", to "scan".
+static void readfile_scan_add(ReadScan *scan, const ReadScan *head)
+  FUNC_ATTR_NONNULL_ALL
+{
+  scan->nl += head->nl;
+  scan->crlf += head->crlf;
+  scan->cr += head->cr;
+  scan->max_len = MAX(scan->max_len, head->max_len);
+  scan->has_nul |= head->has_nul;
+  scan->bad_utf8 |= head->bad_utf8;
+  scan->faulted |= head->faulted;
+}
+
+/// Append the lines found by readfile_scan() in batches, starting at
+/// "ra->line".
+///
+/// @return FAIL when appending a line failed, or the file was truncated
+///         and "ra->faulted" is set.
+static int readfile_append_scan(ReadAppend *ra, const ReadScan *scan)
+  FUNC_ATTR_NONNULL_ALL
+{
+  for (int i = 0; i < scan->nparts && !ra->interrupted; i++) {
+    const ReadScanPart *const part = &scan->parts[i];
+    for (size_t j = 0; j < kv_size(part->eols); j++) {
+      const char_u *const eol = part->start + kv_A(part->eols, j);
+      const char_u *const line = ra->line;
+      colnr_T len = (colnr_T)(eol - line);
+      if (ra->fileformat == EOL_DOS) {
+        len--;  // remove CR before NL
+      }
+      if (ra->nbatch == 0) {
+        ra->batch_start = line;
+      }
+      ra->batch_offs[ra->nbatch] = (size_t)(line - ra->batch_start);
+      ra->batch_lens[ra->nbatch] = len + 1;
+      ra->nbatch++;
+      ra->line = eol + 1;
+
+      if (ra->nbatch == READ_MMAP_BATCH || ra->line >= ra->next_check) {
+        if (readfile_append_batch(ra) == FAIL) {
+          return FAIL;
+        }
+      }
+
+      // Check for CTRL-C once every Mbyte, like the read() loop.
+      if (ra->line >= ra->next_check) {
+        os_breakcheck();
+        if (got_int) {
+          ra->interrupted = true;
+          break;
+        }
+        ra->next_check = ra->line + 0x100000;
+      }
+    }
+  }
+  return readfile_append_batch(ra);
+}
+
+static int readfile_append_batch(ReadAppend *ra)
+  FUNC_ATTR_NONNULL_ALL
+{
+  if (ra->nbatch == 0) {
+    return OK;
+  }
+  const linenr_T n = ra->nbatch;
+  ra->nbatch = 0;
+  char_u *const copy = readfile_copy(ra, ra->batch_start,
+                                     (size_t)(ra->line - ra->batch_start));
+  if (copy == NULL) {
+    return FAIL;
+  }
+  for (linenr_T i = 0; i < n; i++) {
+    ra->batch[i] = copy + ra->batch_offs[i];
+    if (ra->sha_ctx != NULL) {
+      sha256_update(ra->sha_ctx, ra->batch[i], (size_t)ra->batch_lens[i] - 1);
+      sha256_update(ra->sha_ctx, (const char_u *)"", 1);
+    }
+  }
+  if (ml_append_lines(*ra->lnump, ra->batch, ra->batch_lens, n,
+                      ra->newfile) == FAIL) {
+    return FAIL;
+  }
+  *ra->lnump += n;
+  return OK;
+}
+
+/// Copy "size" bytes of the mapping at "from" to "ra->copy".
+///
+/// @return the copy, NUL terminated, NULL when the file was truncated.
+static char_u *readfile_copy(ReadAppend *ra, const char_u *from, size_t size)
+  FUNC_ATTR_NONNULL_ALL
+{
+  if (size >= ra->copy_size) {
+    ra->copy_size = MAX(size + 1, 2 * ra->copy_size);
+    xfree(ra->copy);
+    ra->copy = xmalloc(ra->copy_size);
+  }
+  if (!os_mmap_copy((char *)ra->copy, (const char *)from, size)) {
+    ra->faulted = true;
+    return NULL;
+  }
+  ra->copy[size] = NUL;
+  return ra->copy;
+}
+
+/// Check that the size and modification time of the file "fd" are still
+/// those in "file_info".
+static bool readfile_unchanged(int fd, const FileInfo *file_info)
+  FUNC_ATTR_NONNULL_ALL
+{
+  FileInfo now;
+  return os_fileinfo_fd(fd, &now)
+         && now.stat.st_size == file_info->stat.st_size
+         && now.stat.st_mtim.tv_sec == file_info->stat.st_mtim.tv_sec
+         && now.stat.st_mtim.tv_nsec == file_info->stat.st_mtim.tv_nsec;
+}
+
+/// Check that drawing the buffer before it is completely read only runs
+/// Nvim's own code: BufRead autocommands have not been triggered yet, and
+/// decoration providers, 'foldexpr', 'foldtext' or an expression in a status
+/// line may expect the whole buffer.
+static bool readfile_can_show_top(void)
+{
+  return kv_size(decor_providers) == 0
+         && STRCMP(curwin->w_p_fdm, "expr") != 0
+         && STRCMP(curwin->w_p_fdt, "foldtext()") == 0
+         && !readfile_has_expr(p_stl) && !readfile_has_expr(curwin->w_p_stl)
+         && !readfile_has_expr(p_ruf) && !readfile_has_expr(p_tal);
+}
+
+/// Check if a 'statusline' like option evaluates an expression.
+static bool readfile_has_expr(const char_u *fmt)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_PURE
+{
+  return (fmt[0] == '%' && fmt[1] == '!') || strstr((char *)fmt, "%{") != NULL;
+}
+
+/// Draw the current window while readfile_mmap() is still appending lines,
+/// so that the top of a big file shows up right away.
+static void readfile_show_top(void)
+{
+  if (starting != 0 || !redrawing() || !ui_active()) {
+    return;
+  }
+  check_cursor();
+  update_topline(curwin);
+  redraw_curbuf_later(NOT_VALID);
+  update_screen(0);
+  setcursor();
+  ui_flush();
+}
+
+/// Find the line ends in "text", count CR characters and check for NUL
+/// bytes and illegal UTF-8 sequences.
+///
+/// Big texts are split in parts that are scanned in parallel.  Nothing is
+/// counted after finding a NUL or illegal byte, the file then has to be
+/// read with read() anyway.
+///
+/// @param text  Text to scan.
+/// @param size  Number of bytes in "text".
+/// @param check_utf8  Check that "text" is valid UTF-8.
+/// @param[out] scan  Result, to be freed with readfile_scan_free().
+static void readfile_scan(const char_u *text, size_t size, bool check_utf8,
+                          ReadScan *scan)
+  FUNC_ATTR_NONNULL_ALL
+{
+  const char_u *const text_end = text + size;
+  int nthreads = 1;
+
+  memset(scan, 0, sizeof(*scan));
+
+  // Use one thread for every READ_SCAN_PART bytes, up to the number of
+  // CPUs.  Very big files get more parts than threads.
+  if (size >= (size_t)(2 * READ_SCAN_PART)) {
+    uv_cpu_info_t *cpu_info;
+    int ncpu;
+    if (uv_cpu_info(&cpu_info, &ncpu) == 0) {
+      uv_free_cpu_info(cpu_info, ncpu);
+      nthreads = MAX(1, MIN(ncpu, READ_SCAN_THREADS));
+    }
+  }
+  size_t part_size = MAX(size / (size_t)nthreads, (size_t)READ_SCAN_PART);
+  part_size = MIN(part_size, (size_t)READ_SCAN_PART_MAX);
+  scan->nparts = (int)((size + part_size - 1) / part_size);
+  nthreads = MIN(nthreads, scan->nparts);
+  scan->parts = xcalloc((size_t)scan->nparts, sizeof(ReadScanPart));
+
+  for (int i = 0; i < scan->nparts; i++) {
+    ReadScanPart *const part = &scan->parts[i];
+    part->text = text;
+    part->text_end = text_end;
+    part->check_utf8 = check_utf8;
+    if (i == 0) {
+      part->start = text;
+    } else {
+      // Don't start in the middle of a multi-byte character, it belongs to
+      // the previous part.
+      const char_u *p = text + (size_t)i * part_size;
+      for (int n = 0; n < 3 && p < text_end && (*p & 0xc0) == 0x80; n++) {
+        p++;
+      }
+      part->start = p;
+      scan->parts[i - 1].end = p;
+    }
+  }
+  scan->parts[scan->nparts - 1].end = text_end;
+
+  ReadScanWorker workers[READ_SCAN_THREADS];
+  uv_thread_t threads[READ_SCAN_THREADS];
+  bool started[READ_SCAN_THREADS] = { false };
+  for (int t = 0; t < nthreads; t++) {
+    workers[t] = (ReadScanWorker){ .scan = scan, .first = t,
+                                   .step = nthreads };
+  }
+  // The current thread does the first share of the work itself.  When
+  // starting a thread fails do its share here as well.
+  for (int t = 1; t < nthreads; t++) {
+    started[t] = uv_thread_create(&threads[t], readfile_scan_worker,
+                                  &workers[t]) == 0;
+  }
+  for (int t = 0; t < nthreads; t++) {
+    if (!started[t]) {
+      readfile_scan_worker(&workers[t]);
+    }
+  }
+  for (int t = 1; t < nthreads; t++) {
+    if (started[t]) {
+      uv_thread_join(&threads[t]);
+    }
+  }
+
+  // Combine the results of the parts.
+  const char_u *line = text;
+  for (int i = 0; i < scan->nparts; i++) {
+    const ReadScanPart *const part = &scan->parts[i];
+    scan->has_nul |= part->has_nul;
+    scan->bad_utf8 |= part->bad_utf8;
+    scan->faulted |= part->faulted;
+    scan->nl += kv_size(part->eols);
+    scan->crlf += part->crlf;
+    scan->cr += part->cr;
+    for (size_t j = 0; j < kv_size(part->eols); j++) {
+      const char_u *const eol = part->start + kv_A(part->eols, j);
+      scan->max_len = MAX(scan->max_len, (size_t)(eol - line));
+      line = eol + 1;
+    }
+  }
+  scan->max_len = MAX(scan->max_len, (size_t)(text_end - line));
+}
+
+/// Free the line index allocated by readfile_scan().
+static void readfile_scan_free(ReadScan *scan)
+  FUNC_ATTR_NONNULL_ALL
+{
+  for (int i = 0; i < scan->nparts; i++) {
+    kv_destroy(scan->parts[i].eols);
+  }
+  XFREE_CLEAR(scan->parts);
+  scan->nparts = 0;
+}
+
+/// Thread function for readfile_scan().
+static void readfile_scan_worker(void *arg)
+{
+  ReadScanWorker *const worker = arg;
+  for (int i = worker->first; i < worker->scan->nparts; i += worker->step) {
+    ReadScanPart *const part = &worker->scan->parts[i];
+    part->faulted = !os_mmap_call(readfile_scan_part_cb, part);
+  }
+}
+
+/// os_mmap_call() callback for readfile_scan_part().
+static void readfile_scan_part_cb(void *arg)
+{
+  readfile_scan_part(arg);
+}
+
+// Word-at-a-time helpers for readfile_scan_part(): HAS_ZERO_BYTE() is
+// non-zero when any byte in "w" is zero.
+#define ONES_WORD UINT64_C(0x0101010101010101)
+#define HIGH_BITS_WORD UINT64_C(0x8080808080808080)
+#define HAS_ZERO_BYTE(w) (((w) - ONES_WORD) & ~(w) & HIGH_BITS_WORD)
+
+/// Scan one part of a file for readfile_scan().  Only uses "part", may be
+/// called from any thread.
+static void readfile_scan_part(ReadScanPart *part)
+  FUNC_ATTR_NONNULL_ALL
+{
+  const char_u *const end = part->end;
+  const uint64_t nl_word = NL * ONES_WORD;
+  const uint64_t cr_word = CAR * ONES_WORD;
+  const uint64_t high_mask = part->check_utf8 ? HIGH_BITS_WORD : 0;
+
+  for (const char_u *p = part->start; p < end; p++) {
+    // Skip over eight bytes at a time while there is no NUL, NL, CR or
+    // non-ASCII byte.
+    while (end - p >= 8) {
+      uint64_t w;
+      memcpy(&w, p, sizeof(w));
+      if ((w & high_mask) || HAS_ZERO_BYTE(w) || HAS_ZERO_BYTE(w ^ nl_word)
+          || HAS_ZERO_BYTE(w ^ cr_word)) {
+        break;
+      }
+      p += 8;
+    }
+    if (p >= end) {
+      break;
+    }
+
+    const char_u c = *p;
+    if (c >= 0x80) {
+      if (part->check_utf8) {
+        // A character may continue into the next part, that one then
+        // starts after it.
+        const int todo = (int)MIN(part->text_end - p, MB_MAXBYTES);
+        const int l = utf_ptr2len_len(p, todo);
+        if (l == 1 || l > todo) {
+          part->bad_utf8 = true;
+          return;
+        }
+        p += l - 1;
+      }
+    } else if (c == NL) {
+      if (p > part->text && p[-1] == CAR) {
+        part->crlf++;
+      }
+      kv_push(part->eols, (uint32_t)(p - part->start));
+    } else if (c == CAR) {
+      part->cr++;
+    } else if (c == NUL) {
+      part->has_nul = true;
+      return;
+    }
+  }
+}
+
 #ifdef OPEN_CHR_FILES
 /// Returns true if the file name argument is of the form "/dev/fd/\d\+",
 /// which is the name of files used for process substitution output by
@@ -3175,7 +3826,17 @@ restore_backup:
     fileformat = get_fileformat_force(buf, eap);
     s = buffer;
     len = 0;
-    for (lnum = start; lnum <= end; lnum++) {
+    lnum = start;
+    if (!converted && fileformat == EOL_UNIX && fd >= 0) {
+      // Nothing to convert: write the text straight from the data blocks.
+      if (buf_write_lines(buf, fd, start, end, write_bin,
+                          write_undo_file ? &sha_ctx : NULL,
+                          &nchars, &no_eol) == FAIL) {
+        end = 0;
+      }
+      lnum = end + 1;
+    }
+    for (; lnum <= end; lnum++) {
       // The next while loop is done once for each character written.
       // Keep it fast!
       ptr = ml_get_buf(buf, lnum, false) - 1;
@@ -3807,6 +4468,87 @@ static bool time_differs(long t1, long t2) FUNC_ATTR_CONST
 #endif
 }
 
+/// Write lines "start" to "end" of "buf" to "fd" without copying the text:
+/// pointers into the memline data blocks are gathered and written with one
+/// writev() for many lines.  Only for text that needs no conversion and has
+/// unix line endings.
+///
+/// @param  write_bin  Write the last line without a NL like 'binary' does.
+/// @param  sha_ctx  When not NULL, updated with the text for the undo file.
+/// @param[in,out]  nchars  Incremented with the number of bytes written.
+/// @param[out]  no_eol  Set to true when the last line has no NL.
+///
+/// @return FAIL for a write error or when interrupted, OK otherwise.
+static int buf_write_lines(buf_T *buf, int fd, linenr_T start, linenr_T end,
+                           bool write_bin, context_sha256_T *sha_ctx,
+                           long *nchars, int *no_eol)
+  FUNC_ATTR_NONNULL_ARG(1, 7, 8)
+{
+  static char nl[] = "\n";
+  static char nul[] = "";
+  mllines_T *mll = xmalloc(sizeof(*mll));
+  kvec_t(uv_buf_t) bufs = KV_INITIAL_VALUE;
+  int retval = OK;
+  linenr_T lnum = start;
+
+  while (lnum <= end) {
+    if (ml_get_lines(buf, lnum, end, mll) == 0) {
+      retval = FAIL;
+      break;
+    }
+    kv_size(bufs) = 0;
+    size_t size = 0;
+    for (int i = 0; i < mll->mll_count; i++, lnum++) {
+      char *p = (char *)mll->mll_text[i];
+      size_t len = mll->mll_len[i];
+
+      if (sha_ctx != NULL) {
+        sha256_update(sha_ctx, (char_u *)p, (uint32_t)len + 1);
+      }
+      size += len;
+      // A NL in the buffer is a NUL in the file.
+      char *nlp;
+      while ((nlp = memchr(p, NL, len)) != NULL) {
+        kv_push(bufs, uv_buf_init(p, (unsigned)(nlp - p)));
+        kv_push(bufs, uv_buf_init(nul, 1));
+        len -= (size_t)(nlp - p) + 1;
+        p = nlp + 1;
+      }
+      if (len > 0) {
+        kv_push(bufs, uv_buf_init(p, (unsigned)len));
+      }
+      if (lnum == end
+          && (write_bin || !buf->b_p_fixeol)
+          && (lnum == buf->b_no_eol_lnum
+              || (lnum == buf->b_ml.ml_line_count && !buf->b_p_eol))) {
+        *no_eol = true;
+      } else {
+        kv_push(bufs, uv_buf_init(nl, 1));
+        size++;
+      }
+    }
+
+    ptrdiff_t written = kv_size(bufs) > 0
+        ? os_writev(fd, bufs.items, kv_size(bufs)) : 0;
+    ml_put_lines(buf, mll);
+    if (written != (ptrdiff_t)size) {
+      retval = FAIL;
+      break;
+    }
+    *nchars += (long)size;
+
+    os_breakcheck();
+    if (got_int) {
+      retval = FAIL;
+      break;
+    }
+  }
+
+  kv_destroy(bufs);
+  xfree(mll);
+  return retval;
+}
+
 /*
  * Call write() to write a number of bytes to the file.
  * Handles 'encoding' conversion.
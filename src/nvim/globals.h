@@ -75,7 +75,17 @@
 EXTERN struct nvim_stats_s {
   int64_t fsync;
   int64_t redraw;
-} g_stats INIT(= { 0, 0 });
+  int64_t memfile_hit;      // memfile blocks found in memory
+  int64_t memfile_read;     // memfile blocks read from the swap file
+  int64_t memfile_write;    // memfile blocks written to the swap file
+  int64_t memfile_release;  // memfile blocks released for 'maxmem'
+  int64_t memfile_pack;     // memfile blocks compressed for 'maxmem'
+  int64_t memfile_nopack;   // memfile blocks that didn't compress
+  int64_t rpc_write;        // writes to RPC channels
+} g_stats INIT(= { 0, 0, 0, 0, 0, 0, 0, 0, 0 });
+
+// Collect redraw timing and counters, see nvim__redraw_profile().
+EXTERN bool redraw_prof_enabled INIT(= false);
 
 // Values for "starting".
 #define NO_SCREEN       2       // no screen updating yet
@@ -840,6 +850,10 @@ EXTERN TriState virtual_op INIT(= kNone);
 // Display tick, incremented for each call to update_screen()
 EXTERN disptick_T display_tick INIT(= 0);
 
+// Incremented when options, highlights or syntax items change, to empty the
+// caches of drawn lines of all windows.
+EXTERN int line_cache_gen INIT(= 0);
+
 // Line in which spell checking wasn't highlighted because it touched the
 // cursor position in Insert mode.
 EXTERN linenr_T spell_redraw_lnum INIT(= 0);
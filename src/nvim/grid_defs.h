@@ -4,13 +4,26 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "nvim/func_attr.h"
 #include "nvim/types.h"
 
 #define MAX_MCO  6  // fixed value for 'maxcombine'
 
+// Size of a buffer for the text of a screen cell, including the NUL.
+#define MAX_SCHAR_SIZE 32
+
 // The characters and attributes drawn on grids.
-typedef char_u schar_T[(MAX_MCO+1) * 4 + 1];
+//
+// A cell is a 32-bit value.  Text of up to four bytes (a single character,
+// without composing characters) is stored in the value itself, the bytes in
+// memory order padded with NULs: an ASCII character is the first byte and an
+// empty cell is zero.  Longer text is kept in the glyph table (see
+// schar_from_buf()), then the first byte is 0xFF, which is never part of
+// UTF-8, and the other bytes are the index in the table.  Thus comparing two
+// cells is comparing two integers.
+typedef uint32_t schar_T;
 typedef int sattr_T;
 
 enum {
@@ -29,13 +42,13 @@ enum {
 /// the new state can be compared with the existing state of the grid. This way
 /// we can avoid sending bigger updates than necessary to the Ul layer.
 ///
-/// Screen cells are stored as NUL-terminated UTF-8 strings, and a cell can
+/// Screen cells are stored as schar_T values, the UTF-8 text of a cell can
 /// contain up to MAX_MCO composing characters after the base character.
 /// The composing characters are to be drawn on top of the original character.
-/// The content after the NUL is not defined (so comparison must be done a
-/// single cell at a time). Double-width characters are stored in the left cell,
-/// and the right cell should only contain the empty string. When a part of the
-/// screen is cleared, the cells should be filled with a single whitespace char.
+/// Use schar_get() to get the text of a cell. Double-width characters are
+/// stored in the left cell, and the right cell should only contain the empty
+/// string (zero). When a part of the screen is cleared, the cells should be
+/// filled with a single whitespace char.
 ///
 /// attrs[] contains the highlighting attribute for each cell.
 /// line_offset[n] is the offset from chars[] and attrs[] for the
@@ -111,4 +124,27 @@ struct ScreenGrid {
                            false, 0, 0, NULL, false, true, 0, \
                            0, 0, 0, 0, 0,  false }
 
+static inline schar_T schar_from_ascii(char c)
+  REAL_FATTR_CONST REAL_FATTR_ALWAYS_INLINE;
+
+/// Get the screen cell for an ASCII character.
+static inline schar_T schar_from_ascii(char c)
+{
+  const char p[4] = { c, 0, 0, 0 };
+  schar_T sc;
+  memcpy(&sc, p, sizeof(sc));
+  return sc;
+}
+
+static inline bool schar_is_glyph(schar_T sc)
+  REAL_FATTR_CONST REAL_FATTR_ALWAYS_INLINE;
+
+/// Return true if the text of screen cell "sc" is in the glyph table.
+static inline bool schar_is_glyph(schar_T sc)
+{
+  uint8_t first;
+  memcpy(&first, &sc, 1);
+  return first == 0xFF;
+}
+
 #endif  // NVIM_GRID_DEFS_H
@@ -30,6 +30,20 @@ static Map(int, int) *combine_attr_entries;
 static Map(int, int) *blend_attr_entries;
 static Map(int, int) *blendthrough_attr_entries;
 
+// Cache of hl_blend_attrs() results in front of the maps above, it is called
+// for every blended cell when composing the screen.  A direct-mapped table
+// indexed by a hash of the arguments, an entry is replaced on collision.
+#define BLEND_CACHE_SIZE 1024
+typedef struct {
+  bool used;
+  bool through;      // "*through" argument
+  bool through_ret;  // "*through" result
+  int back_attr;
+  int front_attr;
+  int id;
+} BlendCacheEntry;
+static BlendCacheEntry blend_cache[BLEND_CACHE_SIZE];
+
 /// highlight entries private to a namespace
 static Map(ColorKey, ColorItem) *ns_hl;
 
@@ -288,6 +302,7 @@ void update_window_hl(win_T *wp, bool invalid)
     return;
   }
   wp->w_hl_needs_update = false;
+  int old_attr_normal = wp->w_hl_attr_normal;
 
   // If a floating window is blending it always have a named
   // wp->w_hl_attr_normal group. HL_ATTR(HLF_NFLOAT) is always named.
@@ -340,8 +355,14 @@ void update_window_hl(win_T *wp, bool invalid)
     } else {
       attr = HL_ATTR(hlf);
     }
+    if (wp->w_hl_attrs[hlf] != attr) {
+      old_attr_normal = -1;
+    }
     wp->w_hl_attrs[hlf] = attr;
   }
+  if (wp->w_hl_attr_normal != old_attr_normal) {
+    line_cache_gen++;  // drawn lines use the old highlights
+  }
 
   wp->w_float_config.shadow = false;
   if (wp->w_floating && wp->w_float_config.border) {
@@ -399,6 +420,7 @@ void clear_hl_tables(bool reinit)
     map_clear(int, int)(combine_attr_entries);
     map_clear(int, int)(blend_attr_entries);
     map_clear(int, int)(blendthrough_attr_entries);
+    memset(blend_cache, 0, sizeof(blend_cache));
     memset(highlight_attr_last, -1, sizeof(highlight_attr_last));
     highlight_attr_set_all();
     highlight_changed();
@@ -417,6 +439,7 @@ void hl_invalidate_blends(void)
 {
   map_clear(int, int)(blend_attr_entries);
   map_clear(int, int)(blendthrough_attr_entries);
+  memset(blend_cache, 0, sizeof(blend_cache));
   highlight_changed();
   update_window_hl(curwin, true);
 }
@@ -541,6 +564,28 @@ int hl_blend_attrs(int back_attr, int front_attr, bool *through)
     return -1;
   }
 
+  unsigned hash = ((unsigned)back_attr * 31U + (unsigned)front_attr) * 2U
+                  + (unsigned)*through;
+  BlendCacheEntry *entry = &blend_cache[hash % BLEND_CACHE_SIZE];
+  if (entry->used && entry->back_attr == back_attr
+      && entry->front_attr == front_attr && entry->through == *through) {
+    *through = entry->through_ret;
+    return entry->id;
+  }
+
+  bool through_arg = *through;
+  int id = blend_attrs(back_attr, front_attr, through);
+  if (id > 0 || id == front_attr) {
+    *entry = (BlendCacheEntry){
+      .used = true, .through = through_arg, .through_ret = *through,
+      .back_attr = back_attr, .front_attr = front_attr, .id = id,
+    };
+  }
+  return id;
+}
+
+static int blend_attrs(int back_attr, int front_attr, bool *through)
+{
   HlAttrs fattrs = get_colors_force(front_attr);
   int ratio = fattrs.hl_blend;
   if (ratio <= 0) {
@@ -872,6 +872,10 @@ static void command_line_scan(mparm_T *parmp)
           } else if (STRNICMP(argv[0] + argv_idx, "startuptime", 11) == 0) {
             want_argument = true;
             argv_idx += 11;
+          } else if (STRNICMP(argv[0] + argv_idx, "redrawtime-log",
+                              14) == 0) {
+            want_argument = true;
+            argv_idx += 14;
           } else if (STRNICMP(argv[0] + argv_idx, "clean", 5) == 0) {
             parmp->use_vimrc = "NONE";
             parmp->clean = true;
@@ -1120,6 +1124,11 @@ static void command_line_scan(mparm_T *parmp)
             } else if (strequal(argv[-1], "--listen")) {
               // "--listen {address}"
               parmp->listen_addr = argv[0];
+            } else if (strequal(argv[-1], "--redrawtime-log")) {
+              // "--redrawtime-log {file}" log redraw timing
+              if (redraw_prof_set_log(argv[0])) {
+                redraw_prof_enabled = true;
+              }
             }
             // "--startuptime <file>" already handled
             break;
@@ -2047,6 +2056,8 @@ static void usage(void)
   mch_msg(_("  --headless            Don't start a user interface\n"));
   mch_msg(_("  --listen <address>    Serve RPC API from this address\n"));
   mch_msg(_("  --noplugin            Don't load plugins\n"));
+  mch_msg(_("  --redrawtime-log <file>\n"
+             "                        Write redraw timing messages to <file>\n"));
   mch_msg(_("  --startuptime <file>  Write startup timing messages to <file>\n"));
   mch_msg(_("\nSee \":help startup-options\" for all options.\n"));
 }
@@ -19,6 +19,15 @@
 /// Each block can be in memory and/or in a file. The block stays in memory
 /// as long as it is locked. If it is no longer locked it can be swapped out to
 /// the file. It is only written to the file if it has been changed.
+/// Blocks are swapped out when the memory used for a memfile goes over
+/// 'maxmem', the CLOCK algorithm decides which ones.  Without a file the
+/// blocks are compressed in memory instead (in the LZ4 block format) and
+/// uncompressed again by mf_get().
+///
+/// mf_sync() with MFS_ASYNC copies the dirty blocks and leaves writing them
+/// (and fsync) to a libuv worker thread, so that a slow disk doesn't block
+/// typing.  Everything else that accesses the file first waits for those
+/// writes to finish, see mf_async_wait().
 ///
 /// Under normal operation the file is created when opening the memory file and
 /// deleted when closing the memory file. Only with recovery an existing memory
@@ -45,6 +54,8 @@
 #include <stdbool.h>
 #include <fcntl.h>
 
+#include <uv.h>
+
 #include "nvim/vim.h"
 #include "nvim/ascii.h"
 #include "nvim/memfile.h"
@@ -55,11 +66,38 @@
 #include "nvim/os_unix.h"
 #include "nvim/path.h"
 #include "nvim/assert.h"
+#include "nvim/option_defs.h"
 #include "nvim/os/os.h"
 #include "nvim/os/input.h"
+#include "nvim/main.h"
 
 #define MEMFILE_PAGE_SIZE 4096       /// default page size
 
+// Compression of blocks when there is no swap file, see mf_pack().
+#define MF_PACK_HASH_BITS 12         // size of the match finder hash table
+#define MF_PACK_MINMATCH 4           // shortest match
+#define MF_PACK_LASTLITERALS 5       // the text ends in literals
+#define MF_PACK_MFLIMIT 12           // no match starts this close to the end
+
+/// A copy of a block to be written by the worker.
+typedef struct {
+  off_T offset;
+  unsigned size;
+  char *data;
+} mf_async_write_T;
+
+struct mf_async {
+  uv_work_t req;
+  memfile_T *mfp;                    ///< NULL when no longer waited for
+  int fd;
+  bool flush;                        ///< fsync() after writing
+  kvec_t(mf_async_write_T) writes;
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  bool done;                         ///< protected by "mutex"
+  bool failed;
+};
+
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "memfile.c.generated.h"
@@ -94,11 +132,15 @@ memfile_T *mf_open(char_u *fname, int flags)
   }
 
   mfp->mf_free_first = NULL;         // free list is empty
-  mfp->mf_used_first = NULL;         // used list is empty
-  mfp->mf_used_last = NULL;
+  kv_init(mfp->mf_blocks);           // no used blocks
+  mfp->mf_clock_hand = 0;
+  mfp->mf_mem_pages = 0;
   mfp->mf_dirty = false;
-  mf_hash_init(&mfp->mf_hash);
-  mf_hash_init(&mfp->mf_trans);
+  mfp->mf_async = NULL;
+  mfp->mf_collect = NULL;
+  mfp->mf_async_failed = false;
+  mfp->mf_hash = pmap_new(uint64_t)();
+  mfp->mf_trans = map_new(uint64_t, uint64_t)();
   mfp->mf_page_size = MEMFILE_PAGE_SIZE;
 
   // Try to set the page size equal to device's block size. Speeds up I/O a lot.
@@ -167,6 +209,7 @@ void mf_close(memfile_T *mfp, bool del_file)
   if (mfp == NULL) {                    // safety check
     return;
   }
+  mf_async_wait(mfp);
   if (mfp->mf_fd >= 0 && close(mfp->mf_fd) < 0) {
       EMSG(_(e_swapclose));
   }
@@ -174,16 +217,16 @@ void mf_close(memfile_T *mfp, bool del_file)
     os_remove((char *)mfp->mf_fname);
   }
 
-  // free entries in used list
-  for (bhdr_T *hp = mfp->mf_used_first, *nextp; hp != NULL; hp = nextp) {
-    nextp = hp->bh_next;
-    mf_free_bhdr(hp);
+  // free used blocks
+  for (size_t i = 0; i < kv_size(mfp->mf_blocks); i++) {
+    mf_free_bhdr(kv_A(mfp->mf_blocks, i));
   }
+  kv_destroy(mfp->mf_blocks);
   while (mfp->mf_free_first != NULL) {  // free entries in free list
     xfree(mf_rem_free(mfp));
   }
-  mf_hash_free(&mfp->mf_hash);
-  mf_hash_free_all(&mfp->mf_trans);     // free hashtable and its items
+  pmap_free(uint64_t)(mfp->mf_hash);
+  map_free(uint64_t, uint64_t)(mfp->mf_trans);
   mf_free_fnames(mfp);
   xfree(mfp);
 }
@@ -198,6 +241,7 @@ void mf_close_file(buf_T *buf, bool getlines)
     return;
   }
 
+  mf_async_wait(mfp);
   if (getlines) {
     // get all blocks in memory by accessing all lines (clumsy!)
     for (linenr_T lnum = 1; lnum <= buf->b_ml.ml_line_count; lnum++) {
@@ -261,7 +305,8 @@ bhdr_T *mf_new(memfile_T *mfp, bool negative, unsigned page_count)
       mfp->mf_blocknr_max += page_count;
     }
   }
-  hp->bh_flags = BH_LOCKED | BH_DIRTY;    // new block is always dirty
+  // new block is always dirty
+  hp->bh_flags = BH_LOCKED | BH_DIRTY | BH_REFERENCED;
   mfp->mf_dirty = true;
   hp->bh_page_count = page_count;
   mf_ins_used(mfp, hp);
@@ -271,6 +316,7 @@ bhdr_T *mf_new(memfile_T *mfp, bool negative, unsigned page_count)
   // This also avoids that the passwd file ends up in the swap file!
   (void)memset(hp->bh_data, 0, mfp->mf_page_size * page_count);
 
+  mf_release(mfp);
   return hp;
 }
 
@@ -287,29 +333,34 @@ bhdr_T *mf_get(memfile_T *mfp, blocknr_T nr, unsigned page_count)
 
   // see if it is in the cache
   bhdr_T *hp = mf_find_hash(mfp, nr);
-  if (hp == NULL) {                             // not in the hash list
-    if (nr < 0 || nr >= mfp->mf_infile_count)   // can't be in the file
-      return NULL;
+  if (hp != NULL) {
+    g_stats.memfile_hit++;
+    mf_unpack(mfp, hp);
+    hp->bh_flags |= BH_LOCKED | BH_REFERENCED;
+    return hp;
+  }
 
-    // could check here if the block is in the free list
+  if (nr < 0 || nr >= mfp->mf_infile_count) {  // can't be in the file
+    return NULL;
+  }
 
-    hp = mf_alloc_bhdr(mfp, page_count);
+  // could check here if the block is in the free list
 
-    hp->bh_bnum = nr;
-    hp->bh_flags = 0;
-    hp->bh_page_count = page_count;
-    if (mf_read(mfp, hp) == FAIL) {             // cannot read the block
-      mf_free_bhdr(hp);
-      return NULL;
-    }
-  } else {
-    mf_rem_used(mfp, hp);       // remove from list, insert in front below
-    mf_rem_hash(mfp, hp);
+  hp = mf_alloc_bhdr(mfp, page_count);
+
+  hp->bh_bnum = nr;
+  hp->bh_flags = 0;
+  hp->bh_page_count = page_count;
+  if (mf_read(mfp, hp) == FAIL) {               // cannot read the block
+    mf_free_bhdr(hp);
+    return NULL;
   }
+  g_stats.memfile_read++;
 
-  hp->bh_flags |= BH_LOCKED;
-  mf_ins_used(mfp, hp);         // put in front of used list
-  mf_ins_hash(mfp, hp);         // put in front of hash list
+  hp->bh_flags |= BH_LOCKED | BH_REFERENCED;
+  mf_ins_used(mfp, hp);
+  mf_ins_hash(mfp, hp);
+  mf_release(mfp);
 
   return hp;
 }
@@ -328,6 +379,7 @@ void mf_put(memfile_T *mfp, bhdr_T *hp, bool dirty, bool infile)
   flags &= ~BH_LOCKED;
   if (dirty) {
     flags |= BH_DIRTY;
+    flags &= ~BH_NOPACK;  // the new text may compress
     mfp->mf_dirty = true;
   }
   hp->bh_flags = flags;
@@ -358,11 +410,16 @@ void mf_free(memfile_T *mfp, bhdr_T *hp)
 ///               MFS_FLUSH  Make sure buffers are flushed to disk, so they will
 ///                          survive a system crash.
 ///               MFS_ZERO   Only write block 0.
+///               MFS_ASYNC  Copy the blocks and write them in a worker
+///                          thread.  Does nothing when the previous writes
+///                          are still busy, the memfile stays dirty then.
 ///
 /// @return FAIL  If failure. Possible causes:
 ///               - No file (nothing to do).
 ///               - Write error (probably full disk).
-///         OK    Otherwise.
+///         OK    Otherwise.  With MFS_ASYNC write errors are found later,
+///               the blocks are made dirty again and the next sync is done
+///               without MFS_ASYNC to report the error.
 int mf_sync(memfile_T *mfp, int flags)
 {
   int got_int_save = got_int;
@@ -372,16 +429,29 @@ int mf_sync(memfile_T *mfp, int flags)
     return FAIL;
   }
 
+  if (mfp->mf_async_failed) {
+    mfp->mf_async_failed = false;
+    flags &= ~MFS_ASYNC;
+  }
+  if (flags & MFS_ASYNC) {
+    if (mfp->mf_async != NULL) {
+      return OK;
+    }
+    mfp->mf_collect = xcalloc(1, sizeof(mf_async_T));
+  } else {
+    mf_async_wait(mfp);
+  }
+
   // Only a CTRL-C while writing will break us here, not one typed previously.
   got_int = false;
 
-  // Sync from last to first (may reduce the probability of an inconsistent
-  // file). If a write fails, it is very likely caused by a full filesystem.
+  // If a write fails, it is very likely caused by a full filesystem.
   // Then we only try to write blocks within the existing file. If that also
   // fails then we give up.
   int status = OK;
-  bhdr_T *hp;
-  for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+  size_t i;
+  for (i = 0; i < kv_size(mfp->mf_blocks); i++) {
+    bhdr_T *hp = kv_A(mfp->mf_blocks, i);
     if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
         && (hp->bh_flags & BH_DIRTY)
         && (status == OK || (hp->bh_bnum >= 0
@@ -402,13 +472,17 @@ int mf_sync(memfile_T *mfp, int flags)
       if (got_int)
         break;
     }
+  }
 
-  // If the whole list is flushed, the memfile is not dirty anymore.
+  // If all blocks are flushed, the memfile is not dirty anymore.
   // In case of an error, dirty flag is also set, to avoid trying all the time.
-  if (hp == NULL || status == FAIL)
+  if (i >= kv_size(mfp->mf_blocks) || status == FAIL) {
     mfp->mf_dirty = false;
+  }
 
-  if (flags & MFS_FLUSH) {
+  if (mfp->mf_collect != NULL) {
+    mf_async_start(mfp, flags & MFS_FLUSH);
+  } else if (flags & MFS_FLUSH) {
     if (os_fsync(mfp->mf_fd)) {
       status = FAIL;
     }
@@ -423,7 +497,8 @@ int mf_sync(memfile_T *mfp, int flags)
 /// These are blocks that need to be written to a newly created swapfile.
 void mf_set_dirty(memfile_T *mfp)
 {
-  for (bhdr_T *hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev) {
+  for (size_t i = 0; i < kv_size(mfp->mf_blocks); i++) {
+    bhdr_T *hp = kv_A(mfp->mf_blocks, i);
     if (hp->bh_bnum > 0) {
       hp->bh_flags |= BH_DIRTY;
     }
@@ -431,49 +506,100 @@ void mf_set_dirty(memfile_T *mfp)
   mfp->mf_dirty = true;
 }
 
-/// Insert block in front of memfile's hash list.
+/// Add block to memfile's hash table.
 static void mf_ins_hash(memfile_T *mfp, bhdr_T *hp)
 {
-  mf_hash_add_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
+  pmap_put(uint64_t)(mfp->mf_hash, (uint64_t)hp->bh_bnum, hp);
 }
 
-/// Remove block from memfile's hash list.
+/// Remove block from memfile's hash table.
 static void mf_rem_hash(memfile_T *mfp, bhdr_T *hp)
 {
-  mf_hash_rem_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
+  pmap_del(uint64_t)(mfp->mf_hash, (uint64_t)hp->bh_bnum);
 }
 
-/// Lookup block with number "nr" in memfile's hash list.
-static bhdr_T *mf_find_hash(memfile_T *mfp, blocknr_T nr)
+/// Lookup block with number "nr" in memfile's hash table.
+///
+/// Unlike mf_get() this does not lock the block or read it from the file.
+///
+/// @return  NULL if the block is not in memory.
+bhdr_T *mf_find_hash(memfile_T *mfp, blocknr_T nr)
 {
-  return (bhdr_T *)mf_hash_find(&mfp->mf_hash, nr);
+  return pmap_get(uint64_t)(mfp->mf_hash, (uint64_t)nr);
 }
 
-/// Insert block at the front of memfile's used list.
+/// Add block to memfile's used blocks.
 static void mf_ins_used(memfile_T *mfp, bhdr_T *hp)
 {
-  hp->bh_next = mfp->mf_used_first;
-  mfp->mf_used_first = hp;
-  hp->bh_prev = NULL;
-  if (hp->bh_next == NULL) {    // list was empty, adjust last pointer
-    mfp->mf_used_last = hp;
-  } else {
-    hp->bh_next->bh_prev = hp;
-  }
+  hp->bh_index = kv_size(mfp->mf_blocks);
+  kv_push(mfp->mf_blocks, hp);
+  mfp->mf_mem_pages += hp->bh_page_count;
 }
 
-/// Remove block from memfile's used list.
+/// Remove block from memfile's used blocks.  The last used block takes its
+/// place in mf_blocks.
 static void mf_rem_used(memfile_T *mfp, bhdr_T *hp)
 {
-  if (hp->bh_next == NULL)                 // last block in used list
-    mfp->mf_used_last = hp->bh_prev;
-  else
-    hp->bh_next->bh_prev = hp->bh_prev;
+  bhdr_T *last = kv_pop(mfp->mf_blocks);
+  if (last != hp) {
+    last->bh_index = hp->bh_index;
+    kv_A(mfp->mf_blocks, hp->bh_index) = last;
+  }
+  if (!(hp->bh_flags & BH_PACKED)) {
+    mfp->mf_mem_pages -= hp->bh_page_count;
+  }
+}
 
-  if (hp->bh_prev == NULL)                 // first block in used list
-    mfp->mf_used_first = hp->bh_next;
-  else
-    hp->bh_prev->bh_next = hp->bh_next;
+/// Release blocks until the memory used by memfile "mfp" is below 'maxmem'.
+///
+/// Uses the CLOCK algorithm: the hand goes around mf_blocks, a block that was
+/// used since the hand last passed it gets a second chance.  Locked blocks
+/// and block 0 are never released.  Dirty blocks must be written first, when
+/// there is no swap file the blocks are compressed instead.
+static void mf_release(memfile_T *mfp)
+{
+  if (p_mm <= 0) {
+    return;
+  }
+
+  size_t max_pages = (size_t)p_mm * 1024 / mfp->mf_page_size;
+  // Go around at most twice, the first time may only clear the reference
+  // flags.
+  size_t todo = 2 * kv_size(mfp->mf_blocks);
+  while (mfp->mf_mem_pages > max_pages && todo-- > 0) {
+    if (mfp->mf_clock_hand >= kv_size(mfp->mf_blocks)) {
+      mfp->mf_clock_hand = 0;
+    }
+    bhdr_T *hp = kv_A(mfp->mf_blocks, mfp->mf_clock_hand);
+    if (hp->bh_flags & BH_REFERENCED) {
+      hp->bh_flags &= ~BH_REFERENCED;
+      mfp->mf_clock_hand++;
+    } else if ((hp->bh_flags & (BH_LOCKED | BH_PACKED)) || hp->bh_bnum == 0) {
+      mfp->mf_clock_hand++;
+    } else if (mfp->mf_fd < 0) {
+      // No file to write to, keep the block compressed.  Skip it when it
+      // didn't compress well before and hasn't changed since.
+      if (!(hp->bh_flags & BH_NOPACK)) {
+        mf_pack(mfp, hp);
+      }
+      mfp->mf_clock_hand++;
+    } else {
+      // Keep a block until the worker wrote it, when that fails it is dirty
+      // again and can't be dropped.
+      if (hp->bh_flags & BH_ASYNC) {
+        mf_async_wait(mfp);
+      }
+      if ((hp->bh_flags & BH_DIRTY) && mf_write(mfp, hp) == FAIL) {
+        break;  // most likely the disk is full, try again later
+      }
+      // The last block moves to the position of the hand, it is looked at
+      // next.
+      mf_rem_used(mfp, hp);
+      mf_rem_hash(mfp, hp);
+      mf_free_bhdr(hp);
+      g_stats.memfile_release++;
+    }
+  }
 }
 
 /// Release as many blocks as possible.
@@ -493,18 +619,20 @@ bool mf_release_all(void)
       }
 
       // Flush as many blocks as possible, only if there is a swapfile.
+      // Go backwards, removing a block moves the last one in its place.
       if (mfp->mf_fd >= 0) {
-        for (bhdr_T *hp = mfp->mf_used_last; hp != NULL; ) {
+        for (size_t i = kv_size(mfp->mf_blocks); i > 0; i--) {
+          bhdr_T *hp = kv_A(mfp->mf_blocks, i - 1);
+          if (hp->bh_flags & BH_ASYNC) {
+            mf_async_wait(mfp);  // the block is dirty again if it failed
+          }
           if (!(hp->bh_flags & BH_LOCKED)
               && (!(hp->bh_flags & BH_DIRTY)
                   || mf_write(mfp, hp) != FAIL)) {
             mf_rem_used(mfp, hp);
             mf_rem_hash(mfp, hp);
             mf_free_bhdr(hp);
-            hp = mfp->mf_used_last;    // restart, list was changed
             retval = true;
-          } else {
-            hp = hp->bh_prev;
           }
         }
       }
@@ -513,6 +641,206 @@ bool mf_release_all(void)
   return retval;
 }
 
+/// Compress the data of block "hp" to save memory when there is no swap file
+/// to write it to.  The block is uncompressed again by mf_unpack() when it is
+/// used.  Nothing happens when compressing saves less than a quarter, the
+/// block is then marked BH_NOPACK so that it isn't tried again until it
+/// changes.
+///
+/// @return  true when the block was compressed.
+static bool mf_pack(memfile_T *mfp, bhdr_T *hp)
+{
+  size_t size = (size_t)mfp->mf_page_size * hp->bh_page_count;
+  size_t max_size = size - size / 4;
+  uint8_t *buf = xmalloc(max_size);
+  size_t len = mf_pack_text(hp->bh_data, size, buf, max_size);
+  if (len == 0) {
+    xfree(buf);
+    hp->bh_flags |= BH_NOPACK;
+    g_stats.memfile_nopack++;
+    return false;
+  }
+  xfree(hp->bh_data);
+  hp->bh_data = xrealloc(buf, len);
+  hp->bh_packed_size = len;
+  hp->bh_flags |= BH_PACKED;
+  mfp->mf_mem_pages -= hp->bh_page_count;
+  g_stats.memfile_pack++;
+  return true;
+}
+
+/// Uncompress the data of block "hp" if it was compressed by mf_pack().
+static void mf_unpack(memfile_T *mfp, bhdr_T *hp)
+{
+  if (!(hp->bh_flags & BH_PACKED)) {
+    return;
+  }
+  size_t size = (size_t)mfp->mf_page_size * hp->bh_page_count;
+  void *data = xmalloc(size);
+  if (!mf_unpack_text(hp->bh_data, hp->bh_packed_size, data, size)) {
+    internal_error("mf_unpack()");
+    memset(data, 0, size);
+  }
+  xfree(hp->bh_data);
+  hp->bh_data = data;
+  hp->bh_flags &= ~BH_PACKED;
+  mfp->mf_mem_pages += hp->bh_page_count;
+}
+
+/// Store one sequence of the LZ4 block format at "op": "litlen" literals
+/// from "lit", followed by a match of "matchlen" bytes at "offset" bytes
+/// back.  Only the literals when "offset" is zero, that ends the text.
+///
+/// @return  the end of the sequence, NULL when it doesn't fit before "oend".
+static uint8_t *mf_pack_seq(uint8_t *op, const uint8_t *oend,
+                            const uint8_t *lit, size_t litlen,
+                            size_t offset, size_t matchlen)
+{
+  if ((size_t)(oend - op) < 1 + litlen / 255 + 1 + litlen
+      + 2 + matchlen / 255 + 1) {
+    return NULL;
+  }
+  uint8_t *token = op++;
+  *token = (uint8_t)((litlen < 15 ? litlen : 15) << 4);
+  if (litlen >= 15) {
+    size_t n = litlen - 15;
+    for (; n >= 255; n -= 255) {
+      *op++ = 255;
+    }
+    *op++ = (uint8_t)n;
+  }
+  memcpy(op, lit, litlen);
+  op += litlen;
+  if (offset == 0) {
+    return op;
+  }
+
+  *op++ = (uint8_t)offset;
+  *op++ = (uint8_t)(offset >> 8);
+  size_t n = matchlen - MF_PACK_MINMATCH;
+  *token |= (uint8_t)(n < 15 ? n : 15);
+  if (n >= 15) {
+    for (n -= 15; n >= 255; n -= 255) {
+      *op++ = 255;
+    }
+    *op++ = (uint8_t)n;
+  }
+  return op;
+}
+
+/// Compress "size" bytes from "src" into "dst" in the LZ4 block format.
+/// Uses a small hash table to find earlier occurrences of four bytes, which
+/// is fast and works well for the text and index in a data block.
+///
+/// @return  the compressed size, zero when it doesn't fit in "dst_size".
+static size_t mf_pack_text(const uint8_t *src, size_t size,
+                           uint8_t *dst, size_t dst_size)
+{
+  uint32_t table[1 << MF_PACK_HASH_BITS];
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;  // start of the literals
+  const uint8_t *const iend = src + size;
+  const uint8_t *const mflimit = size > MF_PACK_MFLIMIT
+                                 ? iend - MF_PACK_MFLIMIT : src;
+  uint8_t *op = dst;
+  uint8_t *const oend = dst + dst_size;
+
+  memset(table, 0, sizeof(table));
+  while (ip < mflimit) {
+    uint32_t seq;
+    memcpy(&seq, ip, sizeof(seq));
+    uint32_t h = (seq * 2654435761U) >> (32 - MF_PACK_HASH_BITS);
+    const uint8_t *ref = src + table[h];
+    table[h] = (uint32_t)(ip - src);
+    if (ref >= ip || ip - ref > 0xffff
+        || memcmp(ref, ip, MF_PACK_MINMATCH) != 0) {
+      ip++;
+      continue;
+    }
+
+    size_t matchlen = MF_PACK_MINMATCH;
+    const uint8_t *const matchlimit = iend - MF_PACK_LASTLITERALS;
+    while (ip + matchlen < matchlimit && ref[matchlen] == ip[matchlen]) {
+      matchlen++;
+    }
+    op = mf_pack_seq(op, oend, anchor, (size_t)(ip - anchor),
+                     (size_t)(ip - ref), matchlen);
+    if (op == NULL) {
+      return 0;
+    }
+    ip += matchlen;
+    anchor = ip;
+  }
+  op = mf_pack_seq(op, oend, anchor, (size_t)(iend - anchor), 0, 0);
+  return op == NULL ? 0 : (size_t)(op - dst);
+}
+
+/// Uncompress "size" bytes from "src", produced by mf_pack_text(), into
+/// "dst", which must become exactly "dst_size" bytes.
+///
+/// @return  false when the compressed data is invalid.
+static bool mf_unpack_text(const uint8_t *src, size_t size,
+                           uint8_t *dst, size_t dst_size)
+{
+  const uint8_t *ip = src;
+  const uint8_t *const iend = src + size;
+  uint8_t *op = dst;
+  uint8_t *const oend = dst + dst_size;
+
+  while (ip < iend) {
+    unsigned token = *ip++;
+    size_t len = token >> 4;
+    if (len == 15) {
+      unsigned b;
+      do {
+        if (ip >= iend) {
+          return false;
+        }
+        b = *ip++;
+        len += b;
+      } while (b == 255);
+    }
+    if ((size_t)(iend - ip) < len || (size_t)(oend - op) < len) {
+      return false;
+    }
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+    if (ip == iend) {
+      break;  // the last literals
+    }
+
+    if (iend - ip < 2) {
+      return false;
+    }
+    size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - dst)) {
+      return false;
+    }
+    len = (token & 15) + MF_PACK_MINMATCH;
+    if ((token & 15) == 15) {
+      unsigned b;
+      do {
+        if (ip >= iend) {
+          return false;
+        }
+        b = *ip++;
+        len += b;
+      } while (b == 255);
+    }
+    if ((size_t)(oend - op) < len) {
+      return false;
+    }
+    // The match may overlap with the bytes being written.
+    const uint8_t *ref = op - offset;
+    while (len-- > 0) {
+      *op++ = *ref++;
+    }
+  }
+  return op == oend;
+}
+
 /// Allocate a block header and a block of memory for it.
 static bhdr_T *mf_alloc_bhdr(memfile_T *mfp, unsigned page_count)
 {
@@ -557,6 +885,9 @@ static int mf_read(memfile_T *mfp, bhdr_T *hp)
   if (mfp->mf_fd < 0)       // there is no file, can't read
     return FAIL;
 
+  // The block may still be on its way to the file.
+  mf_async_wait(mfp);
+
   unsigned page_size = mfp->mf_page_size;
   // TODO(elmart): Check (page_size * hp->bh_bnum) within off_T bounds.
   off_T offset = (off_T)(page_size * hp->bh_bnum);
@@ -595,10 +926,18 @@ static int mf_write(memfile_T *mfp, bhdr_T *hp)
   if (mfp->mf_fd < 0)       // there is no file, can't write
     return FAIL;
 
+  if (mfp->mf_collect == NULL) {
+    // Don't let older data from the worker overwrite this block.
+    mf_async_wait(mfp);
+  }
+
   if (hp->bh_bnum < 0)      // must assign file block number
     if (mf_trans_add(mfp, hp) == FAIL)
       return FAIL;
 
+  // A block compressed before the file was opened.
+  mf_unpack(mfp, hp);
+
   page_size = mfp->mf_page_size;
 
   /// We don't want gaps in the file. Write the blocks in front of *hp
@@ -616,17 +955,25 @@ static int mf_write(memfile_T *mfp, bhdr_T *hp)
 
     // TODO(elmart): Check (page_size * nr) within off_T bounds.
     offset = (off_T)(page_size * nr);
-    if (vim_lseek(mfp->mf_fd, offset, SEEK_SET) != offset) {
-      PERROR(_("E296: Seek error in swap file write"));
-      return FAIL;
-    }
-    if (hp2 == NULL)                // freed block, fill with dummy data
+    if (hp2 == NULL) {              // freed block, fill with dummy data
       page_count = 1;
-    else
+    } else {
+      mf_unpack(mfp, hp2);
       page_count = hp2->bh_page_count;
+    }
     size = page_size * page_count;
     void *data = (hp2 == NULL) ? hp->bh_data : hp2->bh_data;
-    if ((unsigned)write_eintr(mfp->mf_fd, data, size) != size) {
+    if (mfp->mf_collect != NULL) {
+      // Written later by the worker, from a copy of the data.
+      kv_push(mfp->mf_collect->writes, ((mf_async_write_T) {
+        .offset = offset,
+        .size = size,
+        .data = xmemdupz(data, size),
+      }));
+    } else if (vim_lseek(mfp->mf_fd, offset, SEEK_SET) != offset) {
+      PERROR(_("E296: Seek error in swap file write"));
+      return FAIL;
+    } else if ((unsigned)write_eintr(mfp->mf_fd, data, size) != size) {
       /// Avoid repeating the error message, this mostly happens when the
       /// disk is full. We give the message again only after a successful
       /// write or when hitting a key. We keep on trying, in case some
@@ -637,8 +984,13 @@ static int mf_write(memfile_T *mfp, bhdr_T *hp)
       return FAIL;
     }
     did_swapwrite_msg = false;
-    if (hp2 != NULL)                               // written a non-dummy block
+    g_stats.memfile_write++;
+    if (hp2 != NULL) {                             // written a non-dummy block
       hp2->bh_flags &= ~BH_DIRTY;
+      if (mfp->mf_collect != NULL) {
+        hp2->bh_flags |= BH_ASYNC;  // until mf_async_finish()
+      }
+    }
     if (nr + (blocknr_T)page_count > mfp->mf_infile_count)  // appended to file
       mfp->mf_infile_count = nr + page_count;
     if (nr == hp->bh_bnum)                         // written the desired block
@@ -647,6 +999,127 @@ static int mf_write(memfile_T *mfp, bhdr_T *hp)
   return OK;
 }
 
+/// Hand the writes collected by mf_sync() to a libuv worker.
+///
+/// @param flush  fsync() the file after writing.
+static void mf_async_start(memfile_T *mfp, bool flush)
+{
+  mf_async_T *job = mfp->mf_collect;
+  mfp->mf_collect = NULL;
+  if (kv_size(job->writes) == 0 && !flush) {
+    kv_destroy(job->writes);
+    xfree(job);
+    return;
+  }
+
+  job->mfp = mfp;
+  job->fd = mfp->mf_fd;
+  job->flush = flush;
+  job->req.data = job;
+  uv_mutex_init(&job->mutex);
+  uv_cond_init(&job->cond);
+  if (uv_queue_work(&main_loop.uv, &job->req, mf_async_work,
+                    mf_async_done) != 0) {
+    // No worker available, write now.
+    mf_async_work(&job->req);
+    mf_async_finish(job);
+    mf_async_free(job);
+    return;
+  }
+  mfp->mf_async = job;
+}
+
+/// Wait until the writes of the worker for "mfp" are done.
+///
+/// Must be called before anything else accesses the swap file.
+void mf_async_wait(memfile_T *mfp)
+{
+  mf_async_T *job = mfp->mf_async;
+  if (job == NULL) {
+    return;
+  }
+  uv_mutex_lock(&job->mutex);
+  while (!job->done) {
+    uv_cond_wait(&job->cond, &job->mutex);
+  }
+  uv_mutex_unlock(&job->mutex);
+  // mf_async_done() frees "job" later.
+  mf_async_finish(job);
+}
+
+/// Runs in the worker thread: write the copied blocks.
+static void mf_async_work(uv_work_t *req)
+{
+  mf_async_T *job = req->data;
+  bool failed = false;
+  for (size_t i = 0; i < kv_size(job->writes) && !failed; i++) {
+    mf_async_write_T *w = &kv_A(job->writes, i);
+    uv_buf_t buf = uv_buf_init(w->data, w->size);
+    uv_fs_t fs_req;
+    int r = uv_fs_write(NULL, &fs_req, job->fd, &buf, 1, (int64_t)w->offset,
+                        NULL);
+    uv_fs_req_cleanup(&fs_req);
+    failed = r != (int)w->size;
+  }
+  if (!failed && job->flush) {
+    uv_fs_t fs_req;
+    failed = uv_fs_fsync(NULL, &fs_req, job->fd, NULL) < 0;
+    uv_fs_req_cleanup(&fs_req);
+  }
+
+  uv_mutex_lock(&job->mutex);
+  job->failed = failed;
+  job->done = true;
+  uv_cond_signal(&job->cond);
+  uv_mutex_unlock(&job->mutex);
+}
+
+/// Runs in the main thread when the worker is done.
+static void mf_async_done(uv_work_t *req, int status)
+{
+  mf_async_T *job = req->data;
+  if (job->mfp != NULL) {
+    mf_async_finish(job);
+  }
+  mf_async_free(job);
+}
+
+/// Detach finished "job" from its memfile.  When writing failed all blocks
+/// are made dirty again, the next mf_sync() writes them without the worker
+/// so that the error is reported.  Blocks written by the job were kept in
+/// memory until now, see mf_release().
+static void mf_async_finish(mf_async_T *job)
+{
+  memfile_T *mfp = job->mfp;
+  job->mfp = NULL;
+  mfp->mf_async = NULL;
+  if (job->flush) {
+    g_stats.fsync++;
+  }
+  for (size_t i = 0; i < kv_size(mfp->mf_blocks); i++) {
+    bhdr_T *hp = kv_A(mfp->mf_blocks, i);
+    hp->bh_flags &= ~BH_ASYNC;
+    if (job->failed && hp->bh_bnum >= 0) {
+      hp->bh_flags |= BH_DIRTY;
+    }
+  }
+  if (job->failed) {
+    mfp->mf_dirty = true;
+    mfp->mf_async_failed = true;
+  }
+}
+
+static void mf_async_free(mf_async_T *job)
+{
+  for (size_t i = 0; i < kv_size(job->writes); i++) {
+    xfree(kv_A(job->writes, i).data);
+  }
+  kv_destroy(job->writes);
+  uv_mutex_destroy(&job->mutex);
+  uv_cond_destroy(&job->cond);
+  xfree(job);
+}
+
 /// Make block number positive and add it to the translation list.
 ///
 /// @return  OK    On success.
@@ -656,8 +1129,6 @@ static int mf_trans_add(memfile_T *mfp, bhdr_T *hp)
   if (hp->bh_bnum >= 0)                     // it's already positive
     return OK;
 
-  mf_blocknr_trans_item_T *np = xmalloc(sizeof(mf_blocknr_trans_item_T));
-
   // Get a new number for the block.
   // If the first item in the free list has sufficient pages, use its number.
   // Otherwise use mf_blocknr_max.
@@ -680,15 +1151,13 @@ static int mf_trans_add(memfile_T *mfp, bhdr_T *hp)
     mfp->mf_blocknr_max += page_count;
   }
 
-  np->nt_old_bnum = hp->bh_bnum;            // adjust number
-  np->nt_new_bnum = new_bnum;
+  // Remember the translation from the old to the new number.
+  map_put(uint64_t, uint64_t)(mfp->mf_trans, (uint64_t)hp->bh_bnum,
+                              (uint64_t)new_bnum);
 
-  mf_rem_hash(mfp, hp);                     // remove from old hash list
+  mf_rem_hash(mfp, hp);                     // remove with old number
   hp->bh_bnum = new_bnum;
-  mf_ins_hash(mfp, hp);                     // insert in new hash list
-
-  // Insert "np" into "mf_trans" hashtable with key "np->nt_old_bnum".
-  mf_hash_add_item(&mfp->mf_trans, (mf_hashitem_T *)np);
+  mf_ins_hash(mfp, hp);                     // insert with new number
 
   return OK;
 }
@@ -699,19 +1168,17 @@ static int mf_trans_add(memfile_T *mfp, bhdr_T *hp)
 ///          The old number           When not found.
 blocknr_T mf_trans_del(memfile_T *mfp, blocknr_T old_nr)
 {
-  mf_blocknr_trans_item_T *np =
-    (mf_blocknr_trans_item_T *)mf_hash_find(&mfp->mf_trans, old_nr);
-
-  if (np == NULL)    // not found
+  uint64_t *new_nr = map_ref(uint64_t, uint64_t)(mfp->mf_trans,
+                                                 (uint64_t)old_nr, false);
+  if (new_nr == NULL) {  // not found
     return old_nr;
+  }
 
   mfp->mf_neg_count--;
-  blocknr_T new_bnum = np->nt_new_bnum;
+  blocknr_T new_bnum = (blocknr_T)(*new_nr);
 
-  // remove entry from the trans list
-  mf_hash_rem_item(&mfp->mf_trans, (mf_hashitem_T *)np);
-
-  xfree(np);
+  // remove entry from the trans table
+  map_del(uint64_t, uint64_t)(mfp->mf_trans, (uint64_t)old_nr);
 
   return new_bnum;
 }
@@ -786,142 +1253,3 @@ static bool mf_do_open(memfile_T *mfp, char_u *fname, int flags)
 
   return true;
 }
-
-//
-// Implementation of mf_hashtab_T.
-//
-
-/// The number of buckets in the hashtable is increased by a factor of
-/// MHT_GROWTH_FACTOR when the average number of items per bucket
-/// exceeds 2 ^ MHT_LOG_LOAD_FACTOR.
-#define MHT_LOG_LOAD_FACTOR 6
-#define MHT_GROWTH_FACTOR   2   // must be a power of two
-
-/// Initialize an empty hash table.
-static void mf_hash_init(mf_hashtab_T *mht)
-{
-  memset(mht, 0, sizeof(mf_hashtab_T));
-  mht->mht_buckets = mht->mht_small_buckets;
-  mht->mht_mask = MHT_INIT_SIZE - 1;
-}
-
-/// Free the array of a hash table. Does not free the items it contains!
-/// The hash table must not be used again without another mf_hash_init() call.
-static void mf_hash_free(mf_hashtab_T *mht)
-{
-  if (mht->mht_buckets != mht->mht_small_buckets) {
-    xfree(mht->mht_buckets);
-  }
-}
-
-/// Free the array of a hash table and all the items it contains.
-static void mf_hash_free_all(mf_hashtab_T *mht)
-{
-  for (size_t idx = 0; idx <= mht->mht_mask; idx++) {
-    mf_hashitem_T *next;
-    for (mf_hashitem_T *mhi = mht->mht_buckets[idx]; mhi != NULL; mhi = next) {
-      next = mhi->mhi_next;
-      xfree(mhi);
-    }
-  }
-
-  mf_hash_free(mht);
-}
-
-/// Find by key.
-///
-/// @return  A pointer to a mf_hashitem_T or NULL if the item was not found.
-static mf_hashitem_T *mf_hash_find(mf_hashtab_T *mht, blocknr_T key)
-{
-  mf_hashitem_T *mhi = mht->mht_buckets[(size_t)key & mht->mht_mask];
-  while (mhi != NULL && mhi->mhi_key != key)
-    mhi = mhi->mhi_next;
-  return mhi;
-}
-
-/// Add item to hashtable. Item must not be NULL.
-static void mf_hash_add_item(mf_hashtab_T *mht, mf_hashitem_T *mhi)
-{
-  size_t idx = (size_t)mhi->mhi_key & mht->mht_mask;
-  mhi->mhi_next = mht->mht_buckets[idx];
-  mhi->mhi_prev = NULL;
-  if (mhi->mhi_next != NULL)
-    mhi->mhi_next->mhi_prev = mhi;
-  mht->mht_buckets[idx] = mhi;
-
-  mht->mht_count++;
-
-  /// Grow hashtable when we have more thank 2^MHT_LOG_LOAD_FACTOR
-  /// items per bucket on average.
-  if ((mht->mht_count >> MHT_LOG_LOAD_FACTOR) > mht->mht_mask) {
-    mf_hash_grow(mht);
-  }
-}
-
-/// Remove item from hashtable. Item must be non NULL and within hashtable.
-static void mf_hash_rem_item(mf_hashtab_T *mht, mf_hashitem_T *mhi)
-{
-  if (mhi->mhi_prev == NULL)
-    mht->mht_buckets[(size_t)mhi->mhi_key & mht->mht_mask] =
-      mhi->mhi_next;
-  else
-    mhi->mhi_prev->mhi_next = mhi->mhi_next;
-
-  if (mhi->mhi_next != NULL)
-    mhi->mhi_next->mhi_prev = mhi->mhi_prev;
-
-  mht->mht_count--;
-
-  // We could shrink the table here, but it typically takes little memory,
-  // so why bother?
-}
-
-/// Increase number of buckets in the hashtable by MHT_GROWTH_FACTOR and
-/// rehash items.
-static void mf_hash_grow(mf_hashtab_T *mht)
-{
-  size_t size = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR * sizeof(void *);
-  mf_hashitem_T **buckets = xcalloc(1, size);
-
-  int shift = 0;
-  while ((mht->mht_mask >> shift) != 0)
-    shift++;
-
-  for (size_t i = 0; i <= mht->mht_mask; i++) {
-    /// Traverse the items in the i-th original bucket and move them into
-    /// MHT_GROWTH_FACTOR new buckets, preserving their relative order
-    /// within each new bucket. Preserving the order is important because
-    /// mf_get() tries to keep most recently used items at the front of
-    /// each bucket.
-    ///
-    /// Here we strongly rely on the fact that hashes are computed modulo
-    /// a power of two.
-
-    mf_hashitem_T *tails[MHT_GROWTH_FACTOR];
-    memset(tails, 0, sizeof(tails));
-
-    for (mf_hashitem_T *mhi = mht->mht_buckets[i];
-         mhi != NULL; mhi = mhi->mhi_next) {
-      size_t j = (mhi->mhi_key >> shift) & (MHT_GROWTH_FACTOR - 1);
-      if (tails[j] == NULL) {
-        buckets[i + (j << shift)] = mhi;
-        tails[j] = mhi;
-        mhi->mhi_prev = NULL;
-      } else {
-        tails[j]->mhi_next = mhi;
-        mhi->mhi_prev = tails[j];
-        tails[j] = mhi;
-      }
-    }
-
-    for (size_t j = 0; j < MHT_GROWTH_FACTOR; j++)
-      if (tails[j] != NULL)
-        tails[j]->mhi_next = NULL;
-  }
-
-  if (mht->mht_buckets != mht->mht_small_buckets)
-    xfree(mht->mht_buckets);
-
-  mht->mht_buckets = buckets;
-  mht->mht_mask = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR - 1;
-}
@@ -39,6 +39,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
 #include <fcntl.h>
@@ -107,9 +108,15 @@ struct pointer_block {
   uint16_t pb_count;            /* number of pointers in this block */
   uint16_t pb_count_max;        /* maximum value for pb_count */
   PTR_EN pb_pointer[1];         /* list of pointers to blocks (actually longer)
-                                 * followed by empty space until end of page */
+                                 * followed by the byte counts, see PB_BYTES()
+                                 * and empty space until end of page */
 };
 
+// Number of bytes in the lines of each branch, including the NUL of each
+// line.  Stored after the last possible entry of pb_pointer[], so that the
+// layout of the entries in the swap file doesn't change.
+#define PB_BYTES(pp) ((long *)&(pp)->pb_pointer[(pp)->pb_count_max])
+
 /*
  * A data block is a leaf in the tree.
  *
@@ -263,7 +270,7 @@ int ml_open(buf_T *buf)
   buf->b_ml.ml_locked = NULL;   // no cached block
   buf->b_ml.ml_line_lnum = 0;   // no cached line
   buf->b_ml.ml_line_offset = 0;
-  buf->b_ml.ml_chunksize = NULL;
+  buf->b_ml.ml_locked_byteadd = 0;
 
   if (cmdmod.noswapfile) {
     buf->b_p_swf = false;
@@ -346,6 +353,7 @@ int ml_open(buf_T *buf)
   pp->pb_pointer[0].pe_page_count = 1;
   pp->pb_pointer[0].pe_old_lnum = 1;
   pp->pb_pointer[0].pe_line_count = 1;      /* line count after insertion */
+  PB_BYTES(pp)[0] = 1;                      // empty line 1
   mf_put(mfp, hp, true, false);
 
   /*
@@ -423,6 +431,7 @@ void ml_setname(buf_T *buf)
     }
     /* need to close the swap file before renaming */
     if (mfp->mf_fd >= 0) {
+      mf_async_wait(mfp);
       close(mfp->mf_fd);
       mfp->mf_fd = -1;
     }
@@ -565,7 +574,6 @@ void ml_close(buf_T *buf, int del_file)
   if (buf->b_ml.ml_line_lnum != 0 && (buf->b_ml.ml_flags & ML_LINE_DIRTY))
     xfree(buf->b_ml.ml_line_ptr);
   xfree(buf->b_ml.ml_stack);
-  XFREE_CLEAR(buf->b_ml.ml_chunksize);
   buf->b_ml.ml_mfp = NULL;
 
   /* Reset the "recovered" flag, give the ATTENTION prompt the next time
@@ -1669,7 +1677,8 @@ static int recov_file_names(char_u **names, char_u *path, int prepend_dot)
  *
  * If 'check_file' is TRUE, check if original file exists and was not changed.
  * If 'check_char' is TRUE, stop syncing when character becomes available, but
- * always sync at least one block.
+ * always sync at least one block.  The blocks are written by a worker thread
+ * then.
  */
 void ml_sync_all(int check_file, int check_char, bool do_fsync)
 {
@@ -1696,7 +1705,9 @@ void ml_sync_all(int check_file, int check_char, bool do_fsync)
       }
     }
     if (buf->b_ml.ml_mfp->mf_dirty) {
-      (void)mf_sync(buf->b_ml.ml_mfp, (check_char ? MFS_STOP : 0)
+      // When typing, let a worker do the writing, a slow disk must not
+      // delay the next character.
+      (void)mf_sync(buf->b_ml.ml_mfp, (check_char ? MFS_STOP | MFS_ASYNC : 0)
                     | (do_fsync && bufIsChanged(buf) ? MFS_FLUSH : 0));
       if (check_char && os_char_avail()) {      // character available now
         break;
@@ -1898,10 +1909,82 @@ int ml_line_alloced(void)
   return curbuf->b_ml.ml_flags & ML_LINE_DIRTY;
 }
 
+/// Get the text of lines "lnum" to "end" of "buf" without copying it.
+///
+/// The pointers in "mll" point into the data blocks, which stay locked in
+/// memory until ml_put_lines() is called, thus unlike ml_get() they remain
+/// valid for more than one line.  Stops early when MLL_MAX_LINES lines or
+/// MLL_MAX_BLOCKS blocks are collected, the caller should loop until "end".
+/// The buffer must not be changed until ml_put_lines() is called.
+///
+/// @return number of lines in "mll", zero on failure.
+int ml_get_lines(buf_T *buf, linenr_T lnum, linenr_T end, mllines_T *mll)
+  FUNC_ATTR_NONNULL_ALL
+{
+  memfile_T *mfp = buf->b_ml.ml_mfp;
+
+  mll->mll_count = 0;
+  mll->mll_nblocks = 0;
+  if (mfp == NULL || lnum < 1 || end > buf->b_ml.ml_line_count) {
+    return 0;
+  }
+
+  // Put a changed line back into its block, the text must be in the blocks.
+  ml_flush_line(buf);
+
+  while (lnum <= end
+         && mll->mll_count < MLL_MAX_LINES
+         && mll->mll_nblocks < MLL_MAX_BLOCKS) {
+    bhdr_T *hp = ml_find_line(buf, lnum, ML_FIND);
+    if (hp == NULL) {
+      break;
+    }
+    linenr_T low = buf->b_ml.ml_locked_low;
+    linenr_T high = MIN(buf->b_ml.ml_locked_high, end);
+
+    // Release the block as ml_locked, this updates the counts in the
+    // pointer blocks and may change the block number.  Then lock it again,
+    // it is still in the cache.
+    (void)ml_find_line(buf, (linenr_T)0, ML_FLUSH);
+    hp = mf_get(mfp, hp->bh_bnum, hp->bh_page_count);
+    if (hp == NULL) {
+      break;
+    }
+    mll->mll_blocks[mll->mll_nblocks++] = hp;
+
+    DATA_BL *dp = hp->bh_data;
+    for (; lnum <= high && mll->mll_count < MLL_MAX_LINES; lnum++) {
+      int idx = lnum - low;
+      unsigned start = dp->db_index[idx] & DB_INDEX_MASK;
+      unsigned next = idx == 0 ? dp->db_txt_end
+                               : dp->db_index[idx - 1] & DB_INDEX_MASK;
+      mll->mll_text[mll->mll_count] = (char_u *)dp + start;
+      mll->mll_len[mll->mll_count] = next - start - 1;
+      mll->mll_count++;
+    }
+  }
+
+  return mll->mll_count;
+}
+
+/// Unlock the blocks locked by ml_get_lines().  The pointers in "mll" are
+/// invalid after this.
+void ml_put_lines(buf_T *buf, mllines_T *mll)
+  FUNC_ATTR_NONNULL_ALL
+{
+  for (int i = 0; i < mll->mll_nblocks; i++) {
+    mf_put(buf->b_ml.ml_mfp, mll->mll_blocks[i], false, false);
+  }
+  mll->mll_nblocks = 0;
+  mll->mll_count = 0;
+}
+
 /*
  * Append a line after lnum (may be 0 to insert a line in front of the file).
  * "line" does not need to be allocated, but can't be another line in a
  * buffer, unlocking may make it invalid.
+ * When "len" is given "line" does not need to be NUL terminated, the NUL is
+ * added when the text is copied into the data block.
  *
  *   newfile: TRUE when starting to edit a new file, meaning that pe_old_lnum
  *		will be set for recovery
@@ -1947,6 +2030,80 @@ int ml_append_buf(
   return ml_append_int(buf, lnum, line, len, newfile, FALSE);
 }
 
+/// Append "count" lines after "lnum" in the current buffer.
+///
+/// Like calling ml_append() for each line, but a line that fits at the end
+/// of the data block holding the previous line is copied into it directly,
+/// without looking up the block again.  Only when the block is full a line
+/// goes through ml_append_int(), which splits the block.
+///
+/// @param lnum  append after this line (can be 0)
+/// @param lines  text of the new lines
+/// @param lens  length of each line including the NUL, like the "len"
+///              argument of ml_append(), or NULL when all lines are NUL
+///              terminated
+/// @param count  number of lines in "lines"
+/// @param newfile  see ml_append()
+///
+/// @return FAIL for failure, the lines before the failing one have been
+///         appended.  OK otherwise.
+int ml_append_lines(linenr_T lnum, char_u **lines, const colnr_T *lens,
+                    linenr_T count, bool newfile)
+  FUNC_ATTR_NONNULL_ARG(2)
+{
+  buf_T *buf = curbuf;
+
+  // When starting up, we might still need to create the memfile
+  if (buf->b_ml.ml_mfp == NULL && open_buffer(false, NULL, 0) == FAIL) {
+    return FAIL;
+  }
+
+  if (buf->b_ml.ml_line_lnum != 0) {
+    ml_flush_line(buf);
+  }
+
+  for (linenr_T i = 0; i < count; i++, lnum++) {
+    colnr_T len = lens != NULL ? lens[i] : (colnr_T)STRLEN(lines[i]) + 1;
+    bhdr_T *hp = buf->b_ml.ml_locked;
+
+    // Appending after the last line of the locked block and there is room:
+    // add the line at the end of the block.  The line and byte counts in
+    // the pointer blocks are updated later through ml_locked_lineadd and
+    // ml_locked_byteadd, like ml_find_line() does for ML_INSERT.
+    if (hp != NULL
+        && buf->b_ml.ml_locked_low <= lnum
+        && buf->b_ml.ml_locked_high == lnum
+        && (int)((DATA_BL *)hp->bh_data)->db_free >= len + (int)INDEX_SIZE) {
+      DATA_BL *dp = hp->bh_data;
+      int db_idx = lnum - buf->b_ml.ml_locked_low + 1;
+
+      if (lowest_marked && lowest_marked > lnum) {
+        lowest_marked = lnum + 1;
+      }
+      dp->db_txt_start -= len;
+      dp->db_free -= len + INDEX_SIZE;
+      dp->db_line_count++;
+      dp->db_index[db_idx] = dp->db_txt_start;
+      memmove((char *)dp + dp->db_txt_start, lines[i], (size_t)len - 1);
+      *((char_u *)dp + dp->db_txt_start + len - 1) = NUL;
+
+      buf->b_ml.ml_locked_high++;
+      buf->b_ml.ml_locked_lineadd++;
+      buf->b_ml.ml_locked_byteadd += len;
+      buf->b_ml.ml_line_count++;
+      buf->b_ml.ml_flags &= ~ML_EMPTY;
+      buf->b_ml.ml_flags |= ML_LOCKED_DIRTY;
+      if (!newfile) {
+        buf->b_ml.ml_flags |= ML_LOCKED_POS;
+      }
+    } else if (ml_append_int(buf, lnum, lines[i], len, newfile, false)
+               == FAIL) {
+      return FAIL;
+    }
+  }
+  return OK;
+}
+
 static int ml_append_int(
     buf_T *buf,
     linenr_T lnum,                  // append after this line (can be 0)
@@ -2066,9 +2223,11 @@ static int ml_append_int(
     /*
      * copy the text into the block
      */
-    memmove((char *)dp + dp->db_index[db_idx + 1], line, (size_t)len);
+    memmove((char *)dp + dp->db_index[db_idx + 1], line, (size_t)len - 1);
+    *((char_u *)dp + dp->db_index[db_idx + 1] + len - 1) = NUL;
     if (mark)
       dp->db_index[db_idx + 1] |= DB_MARKED;
+    buf->b_ml.ml_locked_byteadd += len;
 
     /*
      * Mark the block dirty.
@@ -2084,9 +2243,13 @@ static int ml_append_int(
      * If this pointer block also is full, we go up another block, and so on, up
      * to the root if necessary.
      * The line counts in the pointer blocks have already been adjusted by
-     * ml_find_line().
+     * ml_find_line().  The byte counts are set from the contents of the two
+     * data blocks, the difference with the old count is added to the blocks
+     * higher up.
      */
     long line_count_left, line_count_right;
+    long bytes_left, bytes_right;
+    long byteadd;
     int page_count_left, page_count_right;
     bhdr_T      *hp_left;
     bhdr_T      *hp_right;
@@ -2165,7 +2328,8 @@ static int ml_append_int(
         dp_right->db_index[0] |= DB_MARKED;
 
       memmove((char *)dp_right + dp_right->db_txt_start,
-          line, (size_t)len);
+          line, (size_t)len - 1);
+      *((char_u *)dp_right + dp_right->db_txt_start + len - 1) = NUL;
       ++line_count_right;
     }
     /*
@@ -2203,7 +2367,8 @@ static int ml_append_int(
       if (mark)
         dp_left->db_index[line_count_left] |= DB_MARKED;
       memmove((char *)dp_left + dp_left->db_txt_start,
-          line, (size_t)len);
+          line, (size_t)len - 1);
+      *((char_u *)dp_left + dp_left->db_txt_start + len - 1) = NUL;
       ++line_count_left;
     }
 
@@ -2219,6 +2384,8 @@ static int ml_append_int(
     }
     dp_left->db_line_count = line_count_left;
     dp_right->db_line_count = line_count_right;
+    bytes_left = (long)(dp_left->db_txt_end - dp_left->db_txt_start);
+    bytes_right = (long)(dp_right->db_txt_end - dp_right->db_txt_start);
 
     /*
      * release the two data blocks
@@ -2234,11 +2401,12 @@ static int ml_append_int(
 
     /*
      * flush the old data block
-     * set ml_locked_lineadd to 0, because the updating of the
-     * pointer blocks is done below
+     * set ml_locked_lineadd and ml_locked_byteadd to 0, because the
+     * updating of the pointer blocks is done below
      */
     lineadd = buf->b_ml.ml_locked_lineadd;
     buf->b_ml.ml_locked_lineadd = 0;
+    buf->b_ml.ml_locked_byteadd = 0;
     (void)ml_find_line(buf, (linenr_T)0, ML_FLUSH);  // flush data block
 
     /*
@@ -2262,11 +2430,17 @@ static int ml_append_int(
        */
       /* block not full, add one entry */
       if (pp->pb_count < pp->pb_count_max) {
-        if (pb_idx + 1 < (int)pp->pb_count)
+        if (pb_idx + 1 < (int)pp->pb_count) {
           memmove(&pp->pb_pointer[pb_idx + 2],
               &pp->pb_pointer[pb_idx + 1],
               (size_t)(pp->pb_count - pb_idx - 1) * sizeof(PTR_EN));
+          memmove(&PB_BYTES(pp)[pb_idx + 2], &PB_BYTES(pp)[pb_idx + 1],
+                  (size_t)(pp->pb_count - pb_idx - 1) * sizeof(long));
+        }
         ++pp->pb_count;
+        byteadd = bytes_left + bytes_right - PB_BYTES(pp)[pb_idx];
+        PB_BYTES(pp)[pb_idx] = bytes_left;
+        PB_BYTES(pp)[pb_idx + 1] = bytes_right;
         pp->pb_pointer[pb_idx].pe_line_count = line_count_left;
         pp->pb_pointer[pb_idx].pe_bnum = bnum_left;
         pp->pb_pointer[pb_idx].pe_page_count = page_count_left;
@@ -2291,6 +2465,12 @@ static int ml_append_int(
             lineadd;
           ++(buf->b_ml.ml_stack_top);
         }
+        if (byteadd) {
+          // fix byte count for rest of blocks in the stack
+          --(buf->b_ml.ml_stack_top);
+          ml_byteadd(buf, byteadd);
+          ++(buf->b_ml.ml_stack_top);
+        }
 
         /*
          * We are finished, break the loop here.
@@ -2324,6 +2504,10 @@ static int ml_append_int(
           pp->pb_pointer[0].pe_line_count = buf->b_ml.ml_line_count;
           pp->pb_pointer[0].pe_old_lnum = 1;
           pp->pb_pointer[0].pe_page_count = 1;
+          PB_BYTES(pp)[0] = 0;
+          for (i = 0; i < (int)pp_new->pb_count; i++) {
+            PB_BYTES(pp)[0] += PB_BYTES(pp_new)[i];
+          }
           mf_put(mfp, hp, true, false);             /* release block 1 */
           hp = hp_new;                          /* new block is to be split */
           pp = pp_new;
@@ -2340,11 +2524,14 @@ static int ml_append_int(
           memmove(&pp_new->pb_pointer[0],
               &pp->pb_pointer[pb_idx + 1],
               (size_t)(total_moved) * sizeof(PTR_EN));
+          memmove(&PB_BYTES(pp_new)[0], &PB_BYTES(pp)[pb_idx + 1],
+                  (size_t)total_moved * sizeof(long));
           pp_new->pb_count = total_moved;
           pp->pb_count -= total_moved - 1;
           pp->pb_pointer[pb_idx + 1].pe_bnum = bnum_right;
           pp->pb_pointer[pb_idx + 1].pe_line_count = line_count_right;
           pp->pb_pointer[pb_idx + 1].pe_page_count = page_count_right;
+          PB_BYTES(pp)[pb_idx + 1] = bytes_right;
           if (lnum_right)
             pp->pb_pointer[pb_idx + 1].pe_old_lnum = lnum_right;
         } else {
@@ -2353,24 +2540,32 @@ static int ml_append_int(
           pp_new->pb_pointer[0].pe_line_count = line_count_right;
           pp_new->pb_pointer[0].pe_page_count = page_count_right;
           pp_new->pb_pointer[0].pe_old_lnum = lnum_right;
+          PB_BYTES(pp_new)[0] = bytes_right;
         }
         pp->pb_pointer[pb_idx].pe_bnum = bnum_left;
         pp->pb_pointer[pb_idx].pe_line_count = line_count_left;
         pp->pb_pointer[pb_idx].pe_page_count = page_count_left;
+        PB_BYTES(pp)[pb_idx] = bytes_left;
         if (lnum_left)
           pp->pb_pointer[pb_idx].pe_old_lnum = lnum_left;
         lnum_left = 0;
         lnum_right = 0;
 
         /*
-         * recompute line counts
+         * recompute line and byte counts
          */
         line_count_right = 0;
-        for (i = 0; i < (int)pp_new->pb_count; ++i)
+        bytes_right = 0;
+        for (i = 0; i < (int)pp_new->pb_count; ++i) {
           line_count_right += pp_new->pb_pointer[i].pe_line_count;
+          bytes_right += PB_BYTES(pp_new)[i];
+        }
         line_count_left = 0;
-        for (i = 0; i < (int)pp->pb_count; ++i)
+        bytes_left = 0;
+        for (i = 0; i < (int)pp->pb_count; ++i) {
           line_count_left += pp->pb_pointer[i].pe_line_count;
+          bytes_left += PB_BYTES(pp)[i];
+        }
 
         bnum_left = hp->bh_bnum;
         bnum_right = hp_new->bh_bnum;
@@ -2390,8 +2585,6 @@ static int ml_append_int(
     }
   }
 
-  /* The line was inserted below 'lnum' */
-  ml_updatechunk(buf, lnum + 1, (long)len, ML_CHNK_ADDLINE);
   return OK;
 }
 
@@ -2560,6 +2753,7 @@ static int ml_delete_int(buf_T *buf, linenr_T lnum, bool message)
   if (count == 1) {
     mf_free(mfp, hp);           /* free the data block */
     buf->b_ml.ml_locked = NULL;
+    buf->b_ml.ml_locked_byteadd = 0;
 
     for (stack_idx = buf->b_ml.ml_stack_top - 1; stack_idx >= 0;
          --stack_idx) {
@@ -2578,9 +2772,14 @@ static int ml_delete_int(buf_T *buf, linenr_T lnum, bool message)
       if (count == 0)               /* the pointer block becomes empty! */
         mf_free(mfp, hp);
       else {
-        if (count != idx)               /* move entries after the deleted one */
+        // The blocks higher up still count the bytes of the removed branch.
+        long byteadd = -PB_BYTES(pp)[idx];
+        if (count != idx) {             // move entries after the deleted one
           memmove(&pp->pb_pointer[idx], &pp->pb_pointer[idx + 1],
               (size_t)(count - idx) * sizeof(PTR_EN));
+          memmove(&PB_BYTES(pp)[idx], &PB_BYTES(pp)[idx + 1],
+                  (size_t)(count - idx) * sizeof(long));
+        }
         mf_put(mfp, hp, true, false);
 
         buf->b_ml.ml_stack_top = stack_idx;             /* truncate stack */
@@ -2590,6 +2789,7 @@ static int ml_delete_int(buf_T *buf, linenr_T lnum, bool message)
           buf->b_ml.ml_stack[buf->b_ml.ml_stack_top].ip_high +=
             buf->b_ml.ml_locked_lineadd;
         }
+        ml_byteadd(buf, byteadd);
         ++(buf->b_ml.ml_stack_top);
 
         break;
@@ -2614,6 +2814,7 @@ static int ml_delete_int(buf_T *buf, linenr_T lnum, bool message)
     dp->db_free += line_size + INDEX_SIZE;
     dp->db_txt_start += line_size;
     --(dp->db_line_count);
+    buf->b_ml.ml_locked_byteadd -= line_size;
 
     /*
      * mark the block dirty and make sure it is in the file (for recovery)
@@ -2621,7 +2822,6 @@ static int ml_delete_int(buf_T *buf, linenr_T lnum, bool message)
     buf->b_ml.ml_flags |= (ML_LOCKED_DIRTY | ML_LOCKED_POS);
   }
 
-  ml_updatechunk(buf, lnum, line_size, ML_CHNK_DELLINE);
   return OK;
 }
 
@@ -2817,8 +3017,7 @@ static void ml_flush_line(buf_T *buf)
         /* copy new line into the data block */
         memmove(old_line - extra, new_line, (size_t)new_len);
         buf->b_ml.ml_flags |= (ML_LOCKED_DIRTY | ML_LOCKED_POS);
-        /* The else case is already covered by the insert and delete */
-        ml_updatechunk(buf, lnum, (long)extra, ML_CHNK_UPDLINE);
+        buf->b_ml.ml_locked_byteadd += extra;
       } else {
         // Cannot do it in one data block: Delete and append.
         // Append first, because ml_delete_int() cannot delete the
@@ -2865,7 +3064,10 @@ static bhdr_T *ml_new_ptr(memfile_T *mfp)
   PTR_BL *pp = hp->bh_data;
   pp->pb_id = PTR_ID;
   pp->pb_count = 0;
-  pp->pb_count_max = (mfp->mf_page_size - sizeof(PTR_BL)) / sizeof(PTR_EN) + 1;
+  // Room for the entries and their byte counts, see PB_BYTES().
+  pp->pb_count_max = (uint16_t)((mfp->mf_page_size
+                                 - offsetof(PTR_BL, pb_pointer))
+                                / (sizeof(PTR_EN) + sizeof(long)));
 
   return hp;
 }
@@ -2882,6 +3084,9 @@ static bhdr_T *ml_new_ptr(memfile_T *mfp)
  * the stack is updated to reflect the last line in the block AFTER the
  * insert or delete, also if the pointer block has not been updated yet. But
  * if ml_locked != NULL ml_locked_lineadd must be added to ip_high.
+ * The byte counts in the pointer blocks are not changed here, the caller adds
+ * the size of the inserted or deleted line to ml_locked_byteadd.
+ * ml_locked_offset is set to the number of bytes before ml_locked_low.
  *
  * return: NULL for failure, pointer to block header otherwise
  */
@@ -2896,6 +3101,7 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
   blocknr_T bnum, bnum2;
   int dirty;
   linenr_T low, high;
+  long offset;
   int top;
   int page_count;
   int idx;
@@ -2934,6 +3140,10 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
      */
     if (buf->b_ml.ml_locked_lineadd != 0)
       ml_lineadd(buf, buf->b_ml.ml_locked_lineadd);
+    if (buf->b_ml.ml_locked_byteadd != 0) {
+      ml_byteadd(buf, buf->b_ml.ml_locked_byteadd);
+      buf->b_ml.ml_locked_byteadd = 0;
+    }
   }
 
   if (action == ML_FLUSH)           /* nothing else to do */
@@ -2943,6 +3153,7 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
   page_count = 1;
   low = 1;
   high = buf->b_ml.ml_line_count;
+  offset = 0;
 
   if (action == ML_FIND) {      /* first try stack entries */
     for (top = buf->b_ml.ml_stack_top - 1; top >= 0; --top) {
@@ -2951,6 +3162,7 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
         bnum = ip->ip_bnum;
         low = ip->ip_low;
         high = ip->ip_high;
+        offset = ip->ip_offset;
         buf->b_ml.ml_stack_top = top;           /* truncate stack at prev entry */
         break;
       }
@@ -2981,6 +3193,8 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
       buf->b_ml.ml_locked_low = low;
       buf->b_ml.ml_locked_high = high;
       buf->b_ml.ml_locked_lineadd = 0;
+      buf->b_ml.ml_locked_byteadd = 0;
+      buf->b_ml.ml_locked_offset = offset;
       buf->b_ml.ml_flags &= ~(ML_LOCKED_DIRTY | ML_LOCKED_POS);
       return hp;
     }
@@ -2996,6 +3210,7 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
     ip->ip_bnum = bnum;
     ip->ip_low = low;
     ip->ip_high = high;
+    ip->ip_offset = offset;
     ip->ip_index = -1;                  /* index not known yet */
 
     dirty = FALSE;
@@ -3023,6 +3238,7 @@ static bhdr_T *ml_find_line(buf_T *buf, linenr_T lnum, int action)
 
         break;
       }
+      offset += PB_BYTES(pp)[idx];
     }
     if (idx >= (int)pp->pb_count) {         // past the end: something wrong!
       if (lnum > buf->b_ml.ml_line_count) {
@@ -3116,6 +3332,31 @@ static void ml_lineadd(buf_T *buf, int count)
   }
 }
 
+/// Update the byte counts in the pointer blocks on the stack for text that
+/// was inserted or deleted in the block below them.
+///
+/// @param count  number of bytes added, negative if bytes were deleted
+static void ml_byteadd(buf_T *buf, long count)
+{
+  memfile_T *mfp = buf->b_ml.ml_mfp;
+
+  for (int idx = buf->b_ml.ml_stack_top - 1; idx >= 0; idx--) {
+    infoptr_T *ip = &(buf->b_ml.ml_stack[idx]);
+    bhdr_T *hp = mf_get(mfp, ip->ip_bnum, 1);
+    if (hp == NULL) {
+      break;
+    }
+    PTR_BL *pp = hp->bh_data;  // must be pointer block
+    if (pp->pb_id != PTR_ID) {
+      mf_put(mfp, hp, false, false);
+      IEMSG(_("E317: pointer block id wrong 2"));
+      break;
+    }
+    PB_BYTES(pp)[ip->ip_index] += count;
+    mf_put(mfp, hp, true, false);
+  }
+}
+
 #if defined(HAVE_READLINK)
 /*
  * Resolve a symlink in the last component of a file name.
@@ -3770,222 +4011,23 @@ void ml_setflags(buf_T *buf)
 
   if (!buf->b_ml.ml_mfp)
     return;
-  for (hp = buf->b_ml.ml_mfp->mf_used_last; hp != NULL; hp = hp->bh_prev) {
-    if (hp->bh_bnum == 0) {
-      b0p = hp->bh_data;
-      b0p->b0_dirty = buf->b_changed ? B0_DIRTY : 0;
-      b0p->b0_flags = (b0p->b0_flags & ~B0_FF_MASK)
-                      | (get_fileformat(buf) + 1);
-      add_b0_fenc(b0p, buf);
-      hp->bh_flags |= BH_DIRTY;
-      mf_sync(buf->b_ml.ml_mfp, MFS_ZERO);
-      break;
-    }
-  }
-}
-
-#define MLCS_MAXL 800   /* max no of lines in chunk */
-#define MLCS_MINL 400   /* should be half of MLCS_MAXL */
-
-/*
- * Keep information for finding byte offset of a line, updtype may be one of:
- * ML_CHNK_ADDLINE: Add len to parent chunk, possibly splitting it
- *	   Careful: ML_CHNK_ADDLINE may cause ml_find_line() to be called.
- * ML_CHNK_DELLINE: Subtract len from parent chunk, possibly deleting it
- * ML_CHNK_UPDLINE: Add len to parent chunk, as a signed entity.
- */
-static void ml_updatechunk(buf_T *buf, linenr_T line, long len, int updtype)
-{
-  static buf_T        *ml_upd_lastbuf = NULL;
-  static linenr_T ml_upd_lastline;
-  static linenr_T ml_upd_lastcurline;
-  static int ml_upd_lastcurix;
-
-  linenr_T curline = ml_upd_lastcurline;
-  int curix = ml_upd_lastcurix;
-  long size;
-  chunksize_T         *curchnk;
-  int rest;
-  bhdr_T              *hp;
-  DATA_BL             *dp;
-
-  if (buf->b_ml.ml_usedchunks == -1 || len == 0)
-    return;
-  if (buf->b_ml.ml_chunksize == NULL) {
-    buf->b_ml.ml_chunksize = xmalloc(sizeof(chunksize_T) * 100);
-    buf->b_ml.ml_numchunks = 100;
-    buf->b_ml.ml_usedchunks = 1;
-    buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
-    buf->b_ml.ml_chunksize[0].mlcs_totalsize = 1;
-  }
-
-  if (updtype == ML_CHNK_UPDLINE && buf->b_ml.ml_line_count == 1) {
-    /*
-     * First line in empty buffer from ml_flush_line() -- reset
-     */
-    buf->b_ml.ml_usedchunks = 1;
-    buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
-    buf->b_ml.ml_chunksize[0].mlcs_totalsize =
-      (long)STRLEN(buf->b_ml.ml_line_ptr) + 1;
-    return;
-  }
-
-  /*
-   * Find chunk that our line belongs to, curline will be at start of the
-   * chunk.
-   */
-  if (buf != ml_upd_lastbuf || line != ml_upd_lastline + 1
-      || updtype != ML_CHNK_ADDLINE) {
-    for (curline = 1, curix = 0;
-         curix < buf->b_ml.ml_usedchunks - 1
-                 && line >= curline +
-                             buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-         curix++) {
-      curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-    }
-  } else if (curix < buf->b_ml.ml_usedchunks - 1
-             && line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines) {
-    // Adjust cached curix & curline
-    curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-    curix++;
-  }
-  curchnk = buf->b_ml.ml_chunksize + curix;
-
-  if (updtype == ML_CHNK_DELLINE)
-    len = -len;
-  curchnk->mlcs_totalsize += len;
-  if (updtype == ML_CHNK_ADDLINE) {
-    curchnk->mlcs_numlines++;
-
-    /* May resize here so we don't have to do it in both cases below */
-    if (buf->b_ml.ml_usedchunks + 1 >= buf->b_ml.ml_numchunks) {
-      buf->b_ml.ml_numchunks = buf->b_ml.ml_numchunks * 3 / 2;
-      buf->b_ml.ml_chunksize = xrealloc(
-          buf->b_ml.ml_chunksize,
-          sizeof(chunksize_T) * buf->b_ml.ml_numchunks);
-    }
-
-    if (buf->b_ml.ml_chunksize[curix].mlcs_numlines >= MLCS_MAXL) {
-      int count;                    /* number of entries in block */
-      int idx;
-      int text_end;
-      int linecnt;
-
-      memmove(buf->b_ml.ml_chunksize + curix + 1,
-          buf->b_ml.ml_chunksize + curix,
-          (buf->b_ml.ml_usedchunks - curix) *
-          sizeof(chunksize_T));
-      /* Compute length of first half of lines in the split chunk */
-      size = 0;
-      linecnt = 0;
-      while (curline < buf->b_ml.ml_line_count
-             && linecnt < MLCS_MINL) {
-        if ((hp = ml_find_line(buf, curline, ML_FIND)) == NULL) {
-          buf->b_ml.ml_usedchunks = -1;
-          return;
-        }
-        dp = hp->bh_data;
-        count = (long)(buf->b_ml.ml_locked_high) -
-                (long)(buf->b_ml.ml_locked_low) + 1;
-        idx = curline - buf->b_ml.ml_locked_low;
-        curline = buf->b_ml.ml_locked_high + 1;
-        if (idx == 0)        /* first line in block, text at the end */
-          text_end = dp->db_txt_end;
-        else
-          text_end = ((dp->db_index[idx - 1]) & DB_INDEX_MASK);
-        /* Compute index of last line to use in this MEMLINE */
-        rest = count - idx;
-        if (linecnt + rest > MLCS_MINL) {
-          idx += MLCS_MINL - linecnt - 1;
-          linecnt = MLCS_MINL;
-        } else {
-          idx = count - 1;
-          linecnt += rest;
-        }
-        size += text_end - ((dp->db_index[idx]) & DB_INDEX_MASK);
-      }
-      buf->b_ml.ml_chunksize[curix].mlcs_numlines = linecnt;
-      buf->b_ml.ml_chunksize[curix + 1].mlcs_numlines -= linecnt;
-      buf->b_ml.ml_chunksize[curix].mlcs_totalsize = size;
-      buf->b_ml.ml_chunksize[curix + 1].mlcs_totalsize -= size;
-      buf->b_ml.ml_usedchunks++;
-      ml_upd_lastbuf = NULL;         /* Force recalc of curix & curline */
-      return;
-    } else if (buf->b_ml.ml_chunksize[curix].mlcs_numlines >= MLCS_MINL
-               && curix == buf->b_ml.ml_usedchunks - 1
-               && buf->b_ml.ml_line_count - line <= 1) {
-      /*
-       * We are in the last chunk and it is cheap to crate a new one
-       * after this. Do it now to avoid the loop above later on
-       */
-      curchnk = buf->b_ml.ml_chunksize + curix + 1;
-      buf->b_ml.ml_usedchunks++;
-      if (line == buf->b_ml.ml_line_count) {
-        curchnk->mlcs_numlines = 0;
-        curchnk->mlcs_totalsize = 0;
-      } else {
-        /*
-         * Line is just prior to last, move count for last
-         * This is the common case  when loading a new file
-         */
-        hp = ml_find_line(buf, buf->b_ml.ml_line_count, ML_FIND);
-        if (hp == NULL) {
-          buf->b_ml.ml_usedchunks = -1;
-          return;
-        }
-        dp = hp->bh_data;
-        if (dp->db_line_count == 1)
-          rest = dp->db_txt_end - dp->db_txt_start;
-        else
-          rest =
-            ((dp->db_index[dp->db_line_count - 2]) & DB_INDEX_MASK)
-            - dp->db_txt_start;
-        curchnk->mlcs_totalsize = rest;
-        curchnk->mlcs_numlines = 1;
-        curchnk[-1].mlcs_totalsize -= rest;
-        curchnk[-1].mlcs_numlines -= 1;
-      }
-    }
-  } else if (updtype == ML_CHNK_DELLINE) {
-    curchnk->mlcs_numlines--;
-    ml_upd_lastbuf = NULL;       /* Force recalc of curix & curline */
-    if (curix < (buf->b_ml.ml_usedchunks - 1)
-        && (curchnk->mlcs_numlines + curchnk[1].mlcs_numlines)
-        <= MLCS_MINL) {
-      curix++;
-      curchnk = buf->b_ml.ml_chunksize + curix;
-    } else if (curix == 0 && curchnk->mlcs_numlines <= 0) {
-      buf->b_ml.ml_usedchunks--;
-      memmove(buf->b_ml.ml_chunksize, buf->b_ml.ml_chunksize + 1,
-          buf->b_ml.ml_usedchunks * sizeof(chunksize_T));
-      return;
-    } else if (curix == 0 || (curchnk->mlcs_numlines > 10
-                              && (curchnk->mlcs_numlines +
-                                  curchnk[-1].mlcs_numlines)
-                              > MLCS_MINL)) {
-      return;
-    }
-
-    /* Collapse chunks */
-    curchnk[-1].mlcs_numlines += curchnk->mlcs_numlines;
-    curchnk[-1].mlcs_totalsize += curchnk->mlcs_totalsize;
-    buf->b_ml.ml_usedchunks--;
-    if (curix < buf->b_ml.ml_usedchunks) {
-      memmove(buf->b_ml.ml_chunksize + curix,
-          buf->b_ml.ml_chunksize + curix + 1,
-          (buf->b_ml.ml_usedchunks - curix) *
-          sizeof(chunksize_T));
-    }
-    return;
+  hp = mf_find_hash(buf->b_ml.ml_mfp, 0);
+  if (hp != NULL) {
+    b0p = hp->bh_data;
+    b0p->b0_dirty = buf->b_changed ? B0_DIRTY : 0;
+    b0p->b0_flags = (b0p->b0_flags & ~B0_FF_MASK)
+                    | (get_fileformat(buf) + 1);
+    add_b0_fenc(b0p, buf);
+    hp->bh_flags |= BH_DIRTY;
+    mf_sync(buf->b_ml.ml_mfp, MFS_ZERO);
   }
-  ml_upd_lastbuf = buf;
-  ml_upd_lastline = line;
-  ml_upd_lastcurline = curline;
-  ml_upd_lastcurix = curix;
 }
 
 /// Find offset for line or line with offset.
 ///
+/// The byte counts in the pointer blocks are used, only one path down the
+/// tree is visited.
+///
 /// @param buf buffer to use
 /// @param lnum if > 0, find offset of lnum, return offset
 ///             if == 0, return line with offset *offp
@@ -3996,19 +4038,7 @@ static void ml_updatechunk(buf_T *buf, linenr_T line, long len, int updtype)
 /// @return -1 if information is not available
 long ml_find_line_or_offset(buf_T *buf, linenr_T lnum, long *offp, bool no_ff)
 {
-  linenr_T curline;
-  int curix;
-  long size;
-  bhdr_T      *hp;
-  DATA_BL     *dp;
-  int count;                    /* number of entries in block */
-  int idx;
-  int start_idx;
-  int text_end;
-  long offset;
-  int len;
   int ffdos = !no_ff && (get_fileformat(buf) == EOL_DOS);
-  int extra = 0;
 
   // take care of cached line first. Only needed if the cached line is before
   // the requested line. Additionally cache the value for the cached line.
@@ -4027,98 +4057,45 @@ long ml_find_line_or_offset(buf_T *buf, linenr_T lnum, long *offp, bool no_ff)
     return buf->b_ml.ml_line_offset;
   }
 
-  if (buf->b_ml.ml_usedchunks == -1
-      || buf->b_ml.ml_chunksize == NULL
-      || lnum < 0)
+  if (buf->b_ml.ml_mfp == NULL || lnum < 0) {
     return -1;
-
-  if (offp == NULL)
-    offset = 0;
-  else
-    offset = *offp;
-  if (lnum == 0 && offset <= 0)
-    return 1;       /* Not a "find offset" and offset 0 _must_ be in line 1 */
-  /*
-   * Find the last chunk before the one containing our line. Last chunk is
-   * special because it will never qualify
-   */
-  curline = 1;
-  curix = size = 0;
-  while (curix < buf->b_ml.ml_usedchunks - 1
-         && ((lnum != 0
-              && lnum >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines)
-             || (offset != 0
-                 && offset > size +
-                 buf->b_ml.ml_chunksize[curix].mlcs_totalsize
-                 + ffdos * buf->b_ml.ml_chunksize[curix].mlcs_numlines))) {
-    curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-    size += buf->b_ml.ml_chunksize[curix].mlcs_totalsize;
-    if (offset && ffdos)
-      size += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-    curix++;
   }
 
-  while ((lnum != 0 && curline < lnum) || (offset != 0 && size < offset)) {
-    if (curline > buf->b_ml.ml_line_count
-        || (hp = ml_find_line(buf, curline, ML_FIND)) == NULL)
-      return -1;
-    dp = hp->bh_data;
-    count = (long)(buf->b_ml.ml_locked_high) -
-            (long)(buf->b_ml.ml_locked_low) + 1;
-    start_idx = idx = curline - buf->b_ml.ml_locked_low;
-    if (idx == 0)    /* first line in block, text at the end */
-      text_end = dp->db_txt_end;
-    else
-      text_end = ((dp->db_index[idx - 1]) & DB_INDEX_MASK);
-    /* Compute index of last line to use in this MEMLINE */
-    if (lnum != 0) {
-      if (curline + (count - idx) >= lnum)
-        idx += lnum - curline - 1;
-      else
-        idx = count - 1;
-    } else {
-      extra = 0;
-      while (offset >= size
-             + text_end - (int)((dp->db_index[idx]) & DB_INDEX_MASK)
-             + ffdos) {
-        if (ffdos)
-          size++;
-        if (idx == count - 1) {
-          extra = 1;
-          break;
-        }
-        idx++;
-      }
-    }
-    len = text_end - ((dp->db_index[idx]) & DB_INDEX_MASK);
-    size += len;
-    if (offset != 0 && size >= offset) {
-      if (size + ffdos == offset)
-        *offp = 0;
-      else if (idx == start_idx)
-        *offp = offset - size + len;
-      else
-        *offp = offset - size + len
-                - (text_end - ((dp->db_index[idx - 1]) & DB_INDEX_MASK));
-      curline += idx - start_idx + extra;
-      if (curline > buf->b_ml.ml_line_count)
-        return -1;              /* exactly one byte beyond the end */
-      return curline;
+  if (lnum == 0) {
+    long offset = offp == NULL ? 0 : *offp;
+    if (offset <= 0) {
+      return 1;     // Not a "find offset" and offset 0 _must_ be in line 1
     }
-    curline = buf->b_ml.ml_locked_high + 1;
+    return ml_find_offset(buf, offset, ffdos, offp);
   }
 
-  if (lnum != 0) {
-    /* Count extra CR characters. */
-    if (ffdos)
-      size += lnum - 1;
+  if (lnum > buf->b_ml.ml_line_count + 1) {
+    return -1;
+  }
 
-    /* Don't count the last line break if 'noeol' and ('bin' or
-     * 'nofixeol'). */
-    if ((!buf->b_p_fixeol || buf->b_p_bin) && !buf->b_p_eol
-        && lnum > buf->b_ml.ml_line_count) {
-      size -= ffdos + 1;
-    }
+  // Find the block with the line before "lnum", it may be just after the
+  // last line.  ml_find_line() gives the number of bytes in the blocks
+  // before it.
+  bhdr_T *hp = ml_find_line(buf, MIN(lnum, buf->b_ml.ml_line_count), ML_FIND);
+  if (hp == NULL) {
+    return -1;
+  }
+  DATA_BL *dp = hp->bh_data;
+  int idx = (int)(lnum - buf->b_ml.ml_locked_low);
+  long size = buf->b_ml.ml_locked_offset;
+  if (idx > 0) {
+    size += (long)(dp->db_txt_end - (dp->db_index[idx - 1] & DB_INDEX_MASK));
+  }
+
+  // Count extra CR characters.
+  if (ffdos) {
+    size += lnum - 1;
+  }
+
+  // Don't count the last line break if 'noeol' and ('bin' or 'nofixeol').
+  if ((!buf->b_p_fixeol || buf->b_p_bin) && !buf->b_p_eol
+      && lnum > buf->b_ml.ml_line_count) {
+    size -= ffdos + 1;
   }
 
   if (can_cache && size > 0) {
@@ -4128,6 +4105,86 @@ long ml_find_line_or_offset(buf_T *buf, linenr_T lnum, long *offp, bool no_ff)
   return size;
 }
 
+/// Find the line with byte "offset" in "buf", going down the tree with the
+/// byte counts in the pointer blocks.
+///
+/// @param ffdos  count one extra byte for each line, for the CR
+/// @param[out] colp  the offset of the byte in the line
+///
+/// @return the line number, -1 if "offset" is beyond the end.
+static linenr_T ml_find_offset(buf_T *buf, long offset, int ffdos, long *colp)
+{
+  memfile_T *mfp = buf->b_ml.ml_mfp;
+  blocknr_T bnum = 1;               // start at the root of the tree
+  int page_count = 1;
+  linenr_T low = 1;
+  long size = 0;                    // number of bytes before line "low"
+
+  // Add the lines and bytes inserted in the locked block to the pointer
+  // blocks.
+  (void)ml_find_line(buf, (linenr_T)0, ML_FLUSH);
+
+  for (;;) {
+    bhdr_T *hp = mf_get(mfp, bnum, (unsigned)page_count);
+    if (hp == NULL) {
+      return -1;
+    }
+
+    DATA_BL *dp = hp->bh_data;
+    if (dp->db_id == DATA_ID) {
+      int text_end = (int)dp->db_txt_end;
+      for (int idx = 0; idx < (int)dp->db_line_count; idx++) {
+        int start = (int)(dp->db_index[idx] & DB_INDEX_MASK);
+        long len = text_end - start + ffdos;
+        if (offset < size + len) {
+          mf_put(mfp, hp, false, false);
+          *colp = offset - size;
+          return low + idx;
+        }
+        size += len;
+        text_end = start;
+      }
+      mf_put(mfp, hp, false, false);
+      return -1;                    // beyond the end
+    }
+
+    PTR_BL *pp = (PTR_BL *)dp;      // must be pointer block
+    if (pp->pb_id != PTR_ID) {
+      mf_put(mfp, hp, false, false);
+      IEMSG(_("E317: pointer block id wrong"));
+      return -1;
+    }
+    int idx;
+    for (idx = 0; idx < (int)pp->pb_count; idx++) {
+      linenr_T t = pp->pb_pointer[idx].pe_line_count;
+      long bytes = PB_BYTES(pp)[idx] + ffdos * t;
+      if (offset < size + bytes) {
+        break;
+      }
+      size += bytes;
+      low += t;
+    }
+    if (idx >= (int)pp->pb_count) {
+      mf_put(mfp, hp, false, false);
+      return -1;                    // beyond the end
+    }
+
+    bool dirty = false;
+    bnum = pp->pb_pointer[idx].pe_bnum;
+    page_count = pp->pb_pointer[idx].pe_page_count;
+    // a negative block number may have been changed
+    if (bnum < 0) {
+      blocknr_T bnum2 = mf_trans_del(mfp, bnum);
+      if (bnum != bnum2) {
+        bnum = bnum2;
+        pp->pb_pointer[idx].pe_bnum = bnum;
+        dirty = true;
+      }
+    }
+    mf_put(mfp, hp, dirty, false);
+  }
+}
+
 /// Goto byte in buffer with offset 'cnt'.
 void goto_byte(long cnt)
 {
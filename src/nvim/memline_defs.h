@@ -13,18 +13,9 @@ typedef struct info_pointer {
   linenr_T ip_low;              // lowest lnum in this block
   linenr_T ip_high;             // highest lnum in this block
   int ip_index;                 // index for block with current lnum
+  long ip_offset;               // number of bytes in the lines before ip_low
 } infoptr_T;    // block/index pair
 
-typedef struct ml_chunksize {
-  int mlcs_numlines;
-  long mlcs_totalsize;
-} chunksize_T;
-
-// Flags when calling ml_updatechunk()
-#define ML_CHNK_ADDLINE 1
-#define ML_CHNK_DELLINE 2
-#define ML_CHNK_UPDLINE 3
-
 /// memline structure: the contents of a buffer.
 /// Essentially a tree with a branch factor of 128.
 /// Lines are stored at leaf nodes.
@@ -32,8 +23,8 @@ typedef struct ml_chunksize {
 ///   pointer_block: internal nodes
 ///   data_block: leaf nodes
 ///
-/// Memline also has "chunks" of 800 lines that are separate from the 128-tree
-/// structure, primarily used to speed up line2byte() and byte2line().
+/// Pointer blocks also keep the number of bytes in each branch, used by
+/// line2byte() and byte2line() to find an offset while going down the tree.
 ///
 /// Motivation: If you have a file that is 10000 lines long, and you insert
 ///             a line at linenr 1000, you don't want to move 9000 lines in
@@ -64,9 +55,21 @@ typedef struct memline {
   linenr_T ml_locked_low;       // first line in ml_locked
   linenr_T ml_locked_high;      // last line in ml_locked
   int ml_locked_lineadd;        // number of lines inserted in ml_locked
-  chunksize_T *ml_chunksize;
-  int ml_numchunks;
-  int ml_usedchunks;
+  long ml_locked_byteadd;       // number of bytes inserted in ml_locked
+  long ml_locked_offset;        // number of bytes before ml_locked_low
 } memline_T;
 
+#define MLL_MAX_LINES   4096    // max number of lines in mllines_T
+#define MLL_MAX_BLOCKS  64      // max number of blocks locked by mllines_T
+
+/// Text of lines referenced in place in the memline data blocks, filled by
+/// ml_get_lines() and released with ml_put_lines().
+typedef struct {
+  int mll_count;                        // number of lines in mll_text[]
+  char_u *mll_text[MLL_MAX_LINES];      // text of each line, NUL terminated
+  size_t mll_len[MLL_MAX_LINES];        // length of each line, without NUL
+  int mll_nblocks;                      // number of blocks in mll_blocks[]
+  bhdr_T *mll_blocks[MLL_MAX_BLOCKS];   // data blocks locked in memory
+} mllines_T;
+
 #endif // NVIM_MEMLINE_DEFS_H
@@ -493,6 +493,82 @@ bool striequal(const char *a, const char *b)
   return (a == NULL && b == NULL) || (a && b && STRICMP(a, b) == 0);
 }
 
+struct consumed_blk {
+  struct consumed_blk *prev;
+};
+
+#define ARENA_ALIGN MAX(sizeof(void *), sizeof(double))
+
+static void arena_alloc_block(Arena *arena)
+{
+  struct consumed_blk *blk = xmalloc(ARENA_BLOCK_SIZE);
+  blk->prev = (struct consumed_blk *)arena->cur_blk;
+  arena->cur_blk = (char *)blk;
+  arena->pos = sizeof(struct consumed_blk);
+  arena->size = ARENA_BLOCK_SIZE;
+}
+
+/// Allocates "size" bytes from "arena".
+///
+/// @param align  align the memory for any type, not needed for strings
+void *arena_alloc(Arena *arena, size_t size, bool align)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_NONNULL_RET
+{
+  if (align) {
+    arena->pos = (arena->pos + (ARENA_ALIGN - 1)) & ~(ARENA_ALIGN - 1);
+  }
+  if (arena->cur_blk == NULL || arena->pos + size > arena->size) {
+    if (size > (ARENA_BLOCK_SIZE - sizeof(struct consumed_blk)) / 2) {
+      // Big allocation: give it a block of its own behind the current one,
+      // so that the rest of the current block is still used.
+      if (arena->cur_blk == NULL) {
+        arena_alloc_block(arena);
+      }
+      struct consumed_blk *cur = (struct consumed_blk *)arena->cur_blk;
+      struct consumed_blk *blk = xmalloc(sizeof(struct consumed_blk) + size);
+      blk->prev = cur->prev;
+      cur->prev = blk;
+      return (char *)blk + sizeof(struct consumed_blk);
+    }
+    arena_alloc_block(arena);
+  }
+  char *mem = arena->cur_blk + arena->pos;
+  arena->pos += size;
+  return mem;
+}
+
+/// Copies "size" bytes of "buf" into "arena" and adds a NUL.
+char *arena_memdupz(Arena *arena, const char *buf, size_t size)
+  FUNC_ATTR_NONNULL_ARG(1) FUNC_ATTR_NONNULL_RET
+{
+  char *mem = arena_alloc(arena, size + 1, false);
+  if (size) {
+    memcpy(mem, buf, size);
+  }
+  mem[size] = NUL;
+  return mem;
+}
+
+/// Takes the memory of "arena", to be freed with arena_mem_free().  "arena"
+/// is empty afterwards.
+ArenaMem arena_finish(Arena *arena)
+  FUNC_ATTR_NONNULL_ALL
+{
+  ArenaMem mem = (ArenaMem)arena->cur_blk;
+  *arena = (Arena)ARENA_EMPTY;
+  return mem;
+}
+
+/// Frees all memory allocated from an arena.
+void arena_mem_free(ArenaMem mem)
+{
+  while (mem) {
+    struct consumed_blk *prev = mem->prev;
+    xfree(mem);
+    mem = prev;
+  }
+}
+
 /*
  * Avoid repeating the error message many times (they take 1 second each).
  * Did_outofmem_msg is reset when a character is read.
@@ -32,6 +32,20 @@ extern MemCalloc mem_calloc;
 extern MemRealloc mem_realloc;
 #endif
 
+/// Bump allocator for data that is freed all at once, like the decoded
+/// arguments of an RPC request.  Memory is taken from blocks of
+/// ARENA_BLOCK_SIZE bytes, bigger allocations get a block of their own.
+typedef struct consumed_blk *ArenaMem;
+
+typedef struct {
+  char *cur_blk;  ///< block in use, NULL before the first allocation
+  size_t pos;     ///< next free byte in cur_blk
+  size_t size;    ///< size of cur_blk
+} Arena;
+
+#define ARENA_EMPTY { .cur_blk = NULL, .pos = 0, .size = 0 }
+#define ARENA_BLOCK_SIZE 4096
+
 #ifdef EXITFREE
 /// Indicates that free_all_mem function was or is running
 extern bool entered_free_all_mem;
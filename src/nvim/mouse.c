@@ -737,8 +737,8 @@ int mouse_check_fold(void)
     // Remember the character under the mouse, might be one of foldclose or
     // foldopen fillchars in the fold column.
     if (gp->chars != NULL) {
-      mouse_char = utf_ptr2char(gp->chars[gp->line_offset[row]
-                                          + (unsigned)col]);
+      mouse_char = schar_get_first_codepoint(gp->chars[gp->line_offset[row]
+                                                       + (unsigned)col]);
     }
 
     // Check for position outside of the fold column.
@@ -19,6 +19,7 @@
 #include "nvim/event/wstream.h"
 #include "nvim/event/socket.h"
 #include "nvim/msgpack_rpc/helpers.h"
+#include "nvim/msgpack_rpc/shm.h"
 #include "nvim/vim.h"
 #include "nvim/main.h"
 #include "nvim/ascii.h"
@@ -38,9 +39,77 @@
 #define log_server_msg(...)
 #endif
 
+/// Chunks of at least this many bytes are decoded on the decoder thread, so
+/// that converting a big request (nvim_buf_set_lines() with many lines) does
+/// not block the main loop.  Smaller chunks, like typed keys, are decoded
+/// right away to avoid the latency of a thread switch.
+#define RPC_DECODE_THREAD_MIN (16 * 1024)
+
+/// Messages written to a channel are kept until the end of the loop iteration
+/// and then written together, unless they add up to this many bytes.
+#define RPC_OUT_BATCH_MAX (64 * 1024)
+
+typedef enum {
+  kRpcMessageRequest,     ///< request or notification to schedule
+  kRpcMessageResponse,    ///< response to a call from Nvim
+  kRpcMessageInvalid,     ///< malformed message, closes the channel
+  kRpcMessageError,       ///< unknown method or bad arguments
+  kRpcMessageParseError,  ///< msgpack parse error
+  kRpcMessageNoMem,       ///< msgpack ran out of memory
+} RpcMessageKind;
+
+/// A message decoded from msgpack, ready to be handled on the main thread.
+typedef struct {
+  RpcMessageKind kind;
+  MessageType type;
+  uint32_t request_id;
+  MsgpackRpcRequestHandler handler;  ///< kRpcMessageRequest
+  Array args;                        ///< kRpcMessageRequest
+  ArenaMem args_mem;                 ///< memory of "args"
+  msgpack_zone *args_zone;           ///< strings of "args" point into it
+  bool errored;                      ///< kRpcMessageResponse
+  Object result;                     ///< kRpcMessageResponse
+  Error error;                       ///< kRpcMessageInvalid and Error
+} RpcMessage;
+
+typedef kvec_t(RpcMessage) RpcMessages;
+
+/// Data read from a channel, queued for the decoder thread.  Holds a
+/// reference to the channel until the decoded messages have been handled.
+typedef struct RpcDecodeJob RpcDecodeJob;
+struct RpcDecodeJob {
+  Channel *channel;
+  char *data;
+  size_t size;
+  bool eof;
+  RpcMessages msgs;
+  RpcDecodeJob *next;
+};
+
 static PMap(cstr_t) *event_strings = NULL;
 static msgpack_sbuffer out_buffer;
 
+// The decoder thread, shared by all channels.  Jobs are handled in order, so
+// messages of a channel are never reordered.
+static uv_thread_t decoder_thread;
+static uv_mutex_t decoder_mutex;
+static uv_cond_t decoder_cond;
+static RpcDecodeJob *decoder_head = NULL;
+static RpcDecodeJob *decoder_tail = NULL;
+static bool decoder_started = false;
+static bool decoder_stop = false;
+
+// Channels with pending writes.  Responses and notifications produced in one
+// loop iteration are written with a single writev() per channel, just before
+// the loop polls for I/O again.
+static kvec_t(Channel *) out_channels = KV_INITIAL_VALUE;
+static uv_prepare_t out_prepare;
+static bool out_batching = false;
+
+// Sent on the stream of a channel that uses shared memory, to wake up the
+// client.
+static char shm_doorbell_byte[1] = { 0 };
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "msgpack_rpc/channel.c.generated.h"
 #endif
@@ -50,6 +119,41 @@ void rpc_init(void)
   ch_before_blocking_events = multiqueue_new_child(main_loop.events);
   event_strings = pmap_new(cstr_t)();
   msgpack_sbuffer_init(&out_buffer);
+  uv_mutex_init(&decoder_mutex);
+  uv_cond_init(&decoder_cond);
+  uv_prepare_init(&main_loop.uv, &out_prepare);
+  out_batching = true;
+}
+
+/// Writes pending messages, stops the decoder thread and drops the data it
+/// did not decode yet.
+void rpc_teardown(void)
+{
+  if (out_batching) {
+    out_flush();
+    out_batching = false;
+    uv_close((uv_handle_t *)&out_prepare, NULL);
+  }
+
+  if (!decoder_started) {
+    return;
+  }
+  uv_mutex_lock(&decoder_mutex);
+  decoder_stop = true;
+  uv_cond_signal(&decoder_cond);
+  uv_mutex_unlock(&decoder_mutex);
+  uv_thread_join(&decoder_thread);
+  decoder_started = false;
+
+  while (decoder_head) {
+    RpcDecodeJob *job = decoder_head;
+    decoder_head = job->next;
+    job->channel->rpc.decode_pending--;
+    channel_decref(job->channel);
+    xfree(job->data);
+    xfree(job);
+  }
+  decoder_tail = NULL;
 }
 
 
@@ -62,6 +166,12 @@ void rpc_start(Channel *channel)
   rpc->unpacker = msgpack_unpacker_new(MSGPACK_UNPACKER_INIT_BUFFER_SIZE);
   rpc->subscribed_events = pmap_new(cstr_t)();
   rpc->next_request_id = 1;
+  rpc->decode_pending = 0;
+  kv_init(rpc->out_pending);
+  rpc->out_size = 0;
+  rpc->out_off = 0;
+  rpc->shm = NULL;
+  rpc->shm_active = false;
   rpc->info = (Dictionary)ARRAY_DICT_INIT;
   kv_init(rpc->call_stack);
 
@@ -111,6 +221,30 @@ bool rpc_send_event(uint64_t id, const char *name, Array args)
   return true;
 }
 
+/// Sends a message that the caller already encoded in "sbuffer", like the
+/// "redraw" events of a remote UI.  "sbuffer" is cleared, so that it can be
+/// reused for the next message.
+///
+/// @param id Channel id
+/// @param sbuffer A complete msgpack-rpc message
+/// @return True if the message was sent successfully, false otherwise.
+bool rpc_send_encoded(uint64_t id, msgpack_sbuffer *sbuffer)
+{
+  Channel *channel = find_rpc_channel(id);
+  if (!channel) {
+    msgpack_sbuffer_clear(sbuffer);
+    return false;
+  }
+
+  log_server_msg(id, sbuffer);
+  WBuffer *buffer = wstream_new_buffer(xmemdup(sbuffer->data, sbuffer->size),
+                                       sbuffer->size,
+                                       1,
+                                       xfree);
+  msgpack_sbuffer_clear(sbuffer);
+  return channel_write(channel, buffer);
+}
+
 /// Sends a method call to a channel
 ///
 /// @param id The channel id
@@ -214,22 +348,60 @@ static void receive_msgpack(Stream *stream, RBuffer *rbuf, size_t c,
   Channel *channel = data;
   channel_incref(channel);
 
+  size_t count = rbuffer_size(rbuf);
+  if (channel->rpc.shm_active && !eof) {
+    // Data on the stream only wakes us up, the messages are in shared memory.
+    if (count > 0) {
+      rbuffer_consumed(rbuf, count);
+    }
+    // The client may have made room for what did not fit before.
+    if (!rpc_flush(channel)) {
+      write_failed(channel);
+      goto end;
+    }
+    count = rpc_shm_readable(channel->rpc.shm);
+    if (count == 0) {
+      goto end;
+    }
+  }
+  // Once data went to the decoder thread, everything after it must follow,
+  // the thread owns the unpacker until it is done.
+  if (channel->rpc.decode_pending > 0
+      || (count >= RPC_DECODE_THREAD_MIN && decoder_start())) {
+    RpcDecodeJob *job = xcalloc(1, sizeof(*job));
+    job->channel = channel;
+    job->eof = eof;
+    if (!eof) {
+      job->size = count;
+      job->data = xmalloc(count);
+      read_input(channel, rbuf, job->data, count);
+    }
+    channel_incref(channel);  // released by decoded_event()
+    channel->rpc.decode_pending++;
+    uv_mutex_lock(&decoder_mutex);
+    if (decoder_tail) {
+      decoder_tail->next = job;
+    } else {
+      decoder_head = job;
+    }
+    decoder_tail = job;
+    uv_cond_signal(&decoder_cond);
+    uv_mutex_unlock(&decoder_mutex);
+    goto end;
+  }
+
   if (eof) {
-    channel_close(channel->id, kChannelPartRpc, NULL);
-    char buf[256];
-    snprintf(buf, sizeof(buf), "ch %" PRIu64 " was closed by the client",
-             channel->id);
-    call_set_error(channel, buf, INFO_LOG_LEVEL);
+    receive_eof(channel);
     goto end;
   }
 
-  size_t count = rbuffer_size(rbuf);
   DLOG("ch %" PRIu64 ": parsing %zu bytes from msgpack Stream: %p",
        channel->id, count, (void *)stream);
 
   // Feed the unpacker with data
   msgpack_unpacker_reserve_buffer(channel->rpc.unpacker, count);
-  rbuffer_read(rbuf, msgpack_unpacker_buffer(channel->rpc.unpacker), count);
+  read_input(channel, rbuf, msgpack_unpacker_buffer(channel->rpc.unpacker),
+             count);
   msgpack_unpacker_buffer_consumed(channel->rpc.unpacker, count);
 
   parse_msgpack(channel);
@@ -238,110 +410,261 @@ end:
   channel_decref(channel);
 }
 
+/// Reads "count" bytes of input, from shared memory if the channel uses it.
+static void read_input(Channel *channel, RBuffer *rbuf, char *dst,
+                       size_t count)
+{
+  RpcState *rpc = &channel->rpc;
+  if (!rpc->shm_active) {
+    rbuffer_read(rbuf, dst, count);
+    return;
+  }
+  rpc_shm_read(rpc->shm, dst, count);
+  if (rpc_shm_take_waiting(rpc->shm)) {
+    shm_doorbell(channel);
+  }
+}
+
+static void receive_eof(Channel *channel)
+{
+  channel_close(channel->id, kChannelPartRpc, NULL);
+  char buf[256];
+  snprintf(buf, sizeof(buf), "ch %" PRIu64 " was closed by the client",
+           channel->id);
+  call_set_error(channel, buf, INFO_LOG_LEVEL);
+}
+
+/// Starts the decoder thread if it is not running yet.
+///
+/// @return false if the thread could not be started
+static bool decoder_start(void)
+{
+  if (!decoder_started) {
+    decoder_stop = false;
+    decoder_started = uv_thread_create(&decoder_thread, decoder_thread_run,
+                                       NULL) == 0;
+  }
+  return decoder_started;
+}
+
+static void decoder_thread_run(void *arg)
+{
+  uv_mutex_lock(&decoder_mutex);
+  while (true) {
+    while (!decoder_head && !decoder_stop) {
+      uv_cond_wait(&decoder_cond, &decoder_mutex);
+    }
+    if (decoder_stop) {
+      break;
+    }
+    RpcDecodeJob *job = decoder_head;
+    decoder_head = job->next;
+    if (!decoder_head) {
+      decoder_tail = NULL;
+    }
+    uv_mutex_unlock(&decoder_mutex);
+
+    if (!job->eof) {
+      msgpack_unpacker *unpacker = job->channel->rpc.unpacker;
+      msgpack_unpacker_reserve_buffer(unpacker, job->size);
+      memcpy(msgpack_unpacker_buffer(unpacker), job->data, job->size);
+      msgpack_unpacker_buffer_consumed(unpacker, job->size);
+      XFREE_CLEAR(job->data);
+      decode_msgpack(job->channel->id, unpacker, &job->msgs);
+    }
+    loop_schedule_fast(&main_loop, event_create(decoded_event, 1, job));
+
+    uv_mutex_lock(&decoder_mutex);
+  }
+  uv_mutex_unlock(&decoder_mutex);
+}
+
+/// Handles the messages decoded by the decoder thread.
+static void decoded_event(void **argv)
+{
+  RpcDecodeJob *job = argv[0];
+  Channel *channel = job->channel;
+  channel->rpc.decode_pending--;
+  if (job->eof) {
+    receive_eof(channel);
+  } else {
+    handle_messages(channel, &job->msgs);
+  }
+  kv_destroy(job->msgs);
+  channel_decref(channel);
+  xfree(job);
+}
+
 static void parse_msgpack(Channel *channel)
+{
+  RpcMessages msgs = KV_INITIAL_VALUE;
+  decode_msgpack(channel->id, channel->rpc.unpacker, &msgs);
+  handle_messages(channel, &msgs);
+  kv_destroy(msgs);
+}
+
+/// Decodes the complete messages buffered in "unpacker" and converts them to
+/// API objects.  Does not touch editor state, runs on the decoder thread for
+/// big chunks.
+static void decode_msgpack(uint64_t channel_id, msgpack_unpacker *unpacker,
+                           RpcMessages *msgs)
 {
   msgpack_unpacked unpacked;
   msgpack_unpacked_init(&unpacked);
   msgpack_unpack_return result;
 
   // Deserialize everything we can.
-  while ((result = msgpack_unpacker_next(channel->rpc.unpacker, &unpacked)) ==
+  while ((result = msgpack_unpacker_next(unpacker, &unpacked)) ==
          MSGPACK_UNPACK_SUCCESS) {
     bool is_response = is_rpc_response(&unpacked.data);
-    log_client_msg(channel->id, !is_response, unpacked.data);
+    log_client_msg(channel_id, !is_response, unpacked.data);
 
+    RpcMessage msg = { .error = ERROR_INIT, .args = ARRAY_DICT_INIT };
     if (is_response) {
-      if (is_valid_rpc_response(&unpacked.data, channel)) {
-        complete_call(&unpacked.data, channel);
-      } else {
-        char buf[256];
-        snprintf(buf, sizeof(buf),
-                 "ch %" PRIu64 " returned a response with an unknown request "
-                 "id. Ensure the client is properly synchronized",
-                 channel->id);
-        call_set_error(channel, buf, ERROR_LOG_LEVEL);
-      }
-      msgpack_unpacked_destroy(&unpacked);
+      msgpack_object *obj = &unpacked.data;
+      msg.kind = kRpcMessageResponse;
+      msg.request_id = (uint32_t)obj->via.array.ptr[1].via.u64;
+      msg.errored = obj->via.array.ptr[2].type != MSGPACK_OBJECT_NIL;
+      msgpack_rpc_to_object(&obj->via.array.ptr[msg.errored ? 2 : 3],
+                            &msg.result);
     } else {
-      handle_request(channel, &unpacked.data);
+      decode_request(unpacker, &unpacked, &msg);
     }
+    kv_push(*msgs, msg);
   }
+  msgpack_unpacked_destroy(&unpacked);
 
   if (result == MSGPACK_UNPACK_NOMEM_ERROR) {
-    mch_errmsg(e_outofmem);
-    mch_errmsg("\n");
-    channel_decref(channel);
-    preserve_exit();
-  }
-
-  if (result == MSGPACK_UNPACK_PARSE_ERROR) {
-    // See src/msgpack/unpack_template.h in msgpack source tree for
-    // causes for this error(search for 'goto _failed')
-    //
-    // A not so uncommon cause for this might be deserializing objects with
-    // a high nesting level: msgpack will break when its internal parse stack
-    // size exceeds MSGPACK_EMBED_STACK_SIZE (defined as 32 by default)
-    send_error(channel, kMessageTypeRequest, 0,
-               "Invalid msgpack payload. "
-               "This error can also happen when deserializing "
-               "an object with high level of nesting");
+    kv_push(*msgs, ((RpcMessage){ .kind = kRpcMessageNoMem }));
+  } else if (result == MSGPACK_UNPACK_PARSE_ERROR) {
+    kv_push(*msgs, ((RpcMessage){ .kind = kRpcMessageParseError }));
   }
 }
 
-/// Handles requests and notifications received on the channel.
-static void handle_request(Channel *channel, msgpack_object *request)
+/// Validates a request or notification and converts its arguments.
+///
+/// String arguments are not copied, they point into the unpacker buffer.
+/// The request keeps the zone of the message, which keeps the buffer.
+static void decode_request(const msgpack_unpacker *unpacker,
+                           msgpack_unpacked *unpacked, RpcMessage *msg)
   FUNC_ATTR_NONNULL_ALL
 {
-  uint32_t request_id;
-  Error error = ERROR_INIT;
-  MessageType type = msgpack_rpc_validate(&request_id, request, &error);
-
-  if (ERROR_SET(&error)) {
-    // Validation failed, send response with error
-    if (channel_write(channel,
-                      serialize_response(channel->id,
-                                         type,
-                                         request_id,
-                                         &error,
-                                         NIL,
-                                         &out_buffer))) {
-      char buf[256];
-      snprintf(buf, sizeof(buf),
-               "ch %" PRIu64 " sent an invalid message, closed.",
-               channel->id);
-      call_set_error(channel, buf, ERROR_LOG_LEVEL);
-    }
-    api_clear_error(&error);
+  msgpack_object *request = &unpacked->data;
+  msg->type = msgpack_rpc_validate(&msg->request_id, request, &msg->error);
+  if (ERROR_SET(&msg->error)) {
+    msg->kind = kRpcMessageInvalid;
     return;
   }
-  assert(type == kMessageTypeRequest || type == kMessageTypeNotification);
+  assert(msg->type == kMessageTypeRequest
+         || msg->type == kMessageTypeNotification);
 
-  MsgpackRpcRequestHandler handler;
   msgpack_object *method = msgpack_rpc_method(request);
-  handler = msgpack_rpc_get_handler_for(method->via.bin.ptr,
-                                        method->via.bin.size,
-                                        &error);
+  msg->handler = msgpack_rpc_get_handler_for(method->via.bin.ptr,
+                                             method->via.bin.size,
+                                             &msg->error);
+  if (!ERROR_SET(&msg->error) && msg->type != kMessageTypeRequest
+      && msg->handler.fn == handle_nvim__shm_attach) {
+    // The channel switches after the response, a notification has none.
+    api_set_error(&msg->error, kErrorTypeValidation,
+                  "nvim__shm_attach must be called as a request");
+  }
 
-  // check method arguments
-  Array args = ARRAY_DICT_INIT;
-  if (!ERROR_SET(&error)
-      && !msgpack_rpc_to_array(msgpack_rpc_args(request), &args)) {
-    api_set_error(&error, kErrorTypeException, "Invalid method arguments");
+  // check method arguments, allocated together and freed at once when the
+  // request is done
+  if (!ERROR_SET(&msg->error)) {
+    Arena arena = ARENA_EMPTY;
+    if (!msgpack_rpc_to_array(msgpack_rpc_args(request), &msg->args,
+                              &arena, unpacker)) {
+      api_set_error(&msg->error, kErrorTypeException,
+                    "Invalid method arguments");
+    }
+    msg->args_mem = arena_finish(&arena);
+    msg->args_zone = msgpack_unpacked_release_zone(unpacked);
   }
+  msg->kind = ERROR_SET(&msg->error) ? kRpcMessageError : kRpcMessageRequest;
+  DLOG("RPC: decoded %.*s", method->via.bin.size, method->via.bin.ptr);
+}
 
-  if (ERROR_SET(&error)) {
-    send_error(channel, type, request_id, error.msg);
-    api_clear_error(&error);
-    api_free_array(args);
-    return;
+static void handle_messages(Channel *channel, RpcMessages *msgs)
+{
+  for (size_t i = 0; i < kv_size(*msgs); i++) {
+    RpcMessage *msg = &kv_A(*msgs, i);
+    switch (msg->kind) {
+      case kRpcMessageRequest:
+        handle_request(channel, msg);
+        break;
+      case kRpcMessageResponse:
+        if (is_valid_rpc_response(msg->request_id, channel)) {
+          complete_call(channel, msg);
+        } else {
+          api_free_object(msg->result);
+          char buf[256];
+          snprintf(buf, sizeof(buf),
+                   "ch %" PRIu64 " returned a response with an unknown "
+                   "request id. Ensure the client is properly synchronized",
+                   channel->id);
+          call_set_error(channel, buf, ERROR_LOG_LEVEL);
+        }
+        break;
+      case kRpcMessageInvalid:
+        // Validation failed, send response with error
+        if (channel_write(channel,
+                          serialize_response(channel->id,
+                                             msg->type,
+                                             msg->request_id,
+                                             &msg->error,
+                                             NIL,
+                                             &out_buffer))) {
+          char buf[256];
+          snprintf(buf, sizeof(buf),
+                   "ch %" PRIu64 " sent an invalid message, closed.",
+                   channel->id);
+          call_set_error(channel, buf, ERROR_LOG_LEVEL);
+        }
+        api_clear_error(&msg->error);
+        break;
+      case kRpcMessageError:
+        send_error(channel, msg->type, msg->request_id, msg->error.msg);
+        api_clear_error(&msg->error);
+        arena_mem_free(msg->args_mem);
+        msgpack_zone_free(msg->args_zone);
+        break;
+      case kRpcMessageNoMem:
+        mch_errmsg(e_outofmem);
+        mch_errmsg("\n");
+        channel_decref(channel);
+        preserve_exit();
+        break;
+      case kRpcMessageParseError:
+        // See src/msgpack/unpack_template.h in msgpack source tree for
+        // causes for this error(search for 'goto _failed')
+        //
+        // A not so uncommon cause for this might be deserializing objects
+        // with a high nesting level: msgpack will break when its internal
+        // parse stack size exceeds MSGPACK_EMBED_STACK_SIZE (defined as 32
+        // by default)
+        send_error(channel, kMessageTypeRequest, 0,
+                   "Invalid msgpack payload. "
+                   "This error can also happen when deserializing "
+                   "an object with high level of nesting");
+        break;
+    }
   }
+}
 
+/// Schedules a decoded request or notification.
+static void handle_request(Channel *channel, RpcMessage *msg)
+  FUNC_ATTR_NONNULL_ALL
+{
+  MsgpackRpcRequestHandler handler = msg->handler;
   RequestEvent *evdata = xmalloc(sizeof(RequestEvent));
-  evdata->type = type;
+  evdata->type = msg->type;
   evdata->channel = channel;
   evdata->handler = handler;
-  evdata->args = args;
-  evdata->request_id = request_id;
+  evdata->args = msg->args;
+  evdata->args_mem = msg->args_mem;
+  evdata->args_zone = msg->args_zone;
+  evdata->request_id = msg->request_id;
   channel_incref(channel);
   if (handler.fast) {
     bool is_get_mode = handler.fn == handle_nvim_get_mode;
@@ -362,7 +685,6 @@ static void handle_request(Channel *channel, msgpack_object *request)
       multiqueue_put_event(resize_events, ev);
     } else {
       multiqueue_put(channel->events, request_event, 1, evdata);
-      DLOG("RPC: scheduled %.*s", method->via.bin.size, method->via.bin.ptr);
     }
   }
 }
@@ -395,9 +717,19 @@ static void request_event(void **argv)
   } else {
     api_free_object(result);
   }
+  if (channel->rpc.shm && !channel->rpc.shm_active) {
+    // This was nvim__shm_attach(), its response is the last message written
+    // to the stream.
+    if (!rpc_flush(channel)) {
+      write_failed(channel);
+    }
+    channel->rpc.shm_active = true;
+  }
 
 free_ret:
-  api_free_array(e->args);
+  // Handlers do not take ownership of "args".
+  arena_mem_free(e->args_mem);
+  msgpack_zone_free(e->args_zone);
   channel_decref(channel);
   xfree(e);
   api_clear_error(&error);
@@ -416,26 +748,160 @@ static bool channel_write(Channel *channel, WBuffer *buffer)
     channel_incref(channel);
     CREATE_EVENT(channel->events, internal_read_event, 2, channel, buffer);
     success = true;
+  } else if (out_batching) {
+    RpcState *rpc = &channel->rpc;
+    if (kv_size(rpc->out_pending) == 0) {
+      channel_incref(channel);
+      kv_push(out_channels, channel);
+      uv_prepare_start(&out_prepare, out_prepare_cb);
+    }
+    kv_push(rpc->out_pending, buffer);
+    rpc->out_size += buffer->size;
+    success = rpc->out_size < RPC_OUT_BATCH_MAX || rpc_flush(channel);
   } else {
     Stream *in = channel_instream(channel);
+    g_stats.rpc_write++;
     success = wstream_write(in, buffer);
   }
 
-
   if (!success) {
-    // If the write failed for any reason, close the channel
-    char buf[256];
-    snprintf(buf,
-             sizeof(buf),
-             "ch %" PRIu64 ": stream write failed. "
-             "RPC canceled; closing channel",
-             channel->id);
-    call_set_error(channel, buf, ERROR_LOG_LEVEL);
+    write_failed(channel);
   }
 
   return success;
 }
 
+/// Writes the pending messages of a channel.
+///
+/// @return false if the write failed
+static bool rpc_flush(Channel *channel)
+{
+  RpcState *rpc = &channel->rpc;
+  size_t count = kv_size(rpc->out_pending);
+  if (count == 0) {
+    return true;
+  }
+
+  Stream *in = channel_instream(channel);
+  if (in->closed) {
+    for (size_t i = 0; i < count; i++) {
+      wstream_release_wbuffer(kv_A(rpc->out_pending, i));
+    }
+    kv_size(rpc->out_pending) = 0;
+    rpc->out_size = 0;
+    rpc->out_off = 0;
+    return false;
+  }
+  if (rpc->shm_active) {
+    return shm_flush(channel);
+  }
+
+  kv_size(rpc->out_pending) = 0;
+  rpc->out_size = 0;
+  g_stats.rpc_write++;
+  return wstream_write_many(in, rpc->out_pending.items, count);
+}
+
+/// Writes pending messages to shared memory.  What does not fit stays
+/// pending until the client made room and wakes us up.
+///
+/// @return false if the client does not keep up or the stream failed
+static bool shm_flush(Channel *channel)
+{
+  RpcState *rpc = &channel->rpc;
+  size_t done = 0;
+  size_t written = 0;
+  while (done < kv_size(rpc->out_pending)) {
+    WBuffer *buffer = kv_A(rpc->out_pending, done);
+    size_t count = rpc_shm_write(rpc->shm, buffer->data + rpc->out_off,
+                                 buffer->size - rpc->out_off);
+    written += count;
+    rpc->out_off += count;
+    if (rpc->out_off < buffer->size) {
+      break;
+    }
+    rpc->out_off = 0;
+    wstream_release_wbuffer(buffer);
+    done++;
+  }
+
+  if (done > 0) {
+    kv_size(rpc->out_pending) -= done;
+    memmove(rpc->out_pending.items, rpc->out_pending.items + done,
+            kv_size(rpc->out_pending) * sizeof(WBuffer *));
+  }
+  rpc->out_size -= written;
+  if (rpc->out_size > channel_instream(channel)->maxmem) {
+    return false;
+  }
+  return written == 0 || shm_doorbell(channel);
+}
+
+static bool shm_doorbell(Channel *channel)
+{
+  return wstream_write(channel_instream(channel),
+                       wstream_new_buffer(shm_doorbell_byte, 1, 1, NULL));
+}
+
+/// Sets up shared memory for a channel, used after the response to the
+/// current request was written.
+///
+/// @return Map with keys "path" and "size"
+Dictionary rpc_shm_attach(uint64_t id, Integer size, Error *err)
+{
+  Dictionary rv = ARRAY_DICT_INIT;
+  Channel *channel = find_rpc_channel(id);
+  if (!channel || channel->streamtype == kChannelStreamInternal) {
+    api_set_error(err, kErrorTypeException,
+                  "Shared memory needs a socket, stdio or job channel");
+    return rv;
+  }
+  if (channel->rpc.shm) {
+    api_set_error(err, kErrorTypeException,
+                  "Shared memory is already attached");
+    return rv;
+  }
+
+  RpcShm *shm = rpc_shm_new(size, err);
+  if (shm == NULL) {
+    return rv;
+  }
+  channel->rpc.shm = shm;
+  PUT(rv, "path", STRING_OBJ(cstr_to_string(rpc_shm_path(shm))));
+  PUT(rv, "size", INTEGER_OBJ((Integer)rpc_shm_size(shm)));
+  return rv;
+}
+
+static void out_flush(void)
+{
+  // A failed write closes the channel, which may write to another one.
+  while (kv_size(out_channels)) {
+    Channel *channel = kv_pop(out_channels);
+    if (!channel->rpc.closed && !rpc_flush(channel)) {
+      write_failed(channel);
+    }
+    channel_decref(channel);
+  }
+}
+
+static void out_prepare_cb(uv_prepare_t *handle)
+{
+  out_flush();
+  uv_prepare_stop(handle);
+}
+
+static void write_failed(Channel *channel)
+{
+  // If the write failed for any reason, close the channel
+  char buf[256];
+  snprintf(buf,
+           sizeof(buf),
+           "ch %" PRIu64 ": stream write failed. "
+           "RPC canceled; closing channel",
+           channel->id);
+  call_set_error(channel, buf, ERROR_LOG_LEVEL);
+}
+
 static void internal_read_event(void **argv)
 {
   Channel *channel = argv[0];
@@ -557,6 +1023,8 @@ void rpc_close(Channel *channel)
     return;
   }
 
+  // Write the responses that are still pending before the stream closes.
+  rpc_flush(channel);
   channel->rpc.closed = true;
   channel_decref(channel);
 
@@ -585,6 +1053,11 @@ void rpc_free(Channel *channel)
 
   pmap_free(cstr_t)(channel->rpc.subscribed_events);
   kv_destroy(channel->rpc.call_stack);
+  for (size_t i = 0; i < kv_size(channel->rpc.out_pending); i++) {
+    wstream_release_wbuffer(kv_A(channel->rpc.out_pending, i));
+  }
+  kv_destroy(channel->rpc.out_pending);
+  rpc_shm_free(channel->rpc.shm);
   api_free_dictionary(channel->rpc.info);
 }
 
@@ -597,9 +1070,8 @@ static bool is_rpc_response(msgpack_object *obj)
       && obj->via.array.ptr[1].type == MSGPACK_OBJECT_POSITIVE_INTEGER;
 }
 
-static bool is_valid_rpc_response(msgpack_object *obj, Channel *channel)
+static bool is_valid_rpc_response(uint32_t response_id, Channel *channel)
 {
-  uint32_t response_id = (uint32_t)obj->via.array.ptr[1].via.u64;
   if (kv_size(channel->rpc.call_stack) == 0) {
     return false;
   }
@@ -609,17 +1081,12 @@ static bool is_valid_rpc_response(msgpack_object *obj, Channel *channel)
   return response_id == frame->request_id;
 }
 
-static void complete_call(msgpack_object *obj, Channel *channel)
+static void complete_call(Channel *channel, RpcMessage *msg)
 {
   ChannelCallFrame *frame = kv_last(channel->rpc.call_stack);
   frame->returned = true;
-  frame->errored = obj->via.array.ptr[2].type != MSGPACK_OBJECT_NIL;
-
-  if (frame->errored) {
-    msgpack_rpc_to_object(&obj->via.array.ptr[2], &frame->result);
-  } else {
-    msgpack_rpc_to_object(&obj->via.array.ptr[3], &frame->result);
-  }
+  frame->errored = msg->errored;
+  frame->result = msg->result;
 }
 
 static void call_set_error(Channel *channel, char *msg, int loglevel)
@@ -8,6 +8,7 @@
 #include "nvim/api/private/defs.h"
 #include "nvim/event/socket.h"
 #include "nvim/event/process.h"
+#include "nvim/msgpack_rpc/shm.h"
 #include "nvim/vim.h"
 
 typedef struct Channel Channel;
@@ -23,6 +24,8 @@ typedef struct {
   Channel *channel;
   MsgpackRpcRequestHandler handler;
   Array args;
+  ArenaMem args_mem;  // memory of "args"
+  msgpack_zone *args_zone;  // strings of "args" point into it
   uint32_t request_id;
 } RequestEvent;
 
@@ -30,6 +33,12 @@ typedef struct {
   PMap(cstr_t) *subscribed_events;
   bool closed;
   msgpack_unpacker *unpacker;
+  size_t decode_pending;  // chunks queued for the decoder thread
+  kvec_t(WBuffer *) out_pending;  // messages not written yet
+  size_t out_size;  // total size of "out_pending"
+  size_t out_off;  // bytes of the first pending message already written
+  RpcShm *shm;  // shared memory set up by nvim__shm_attach()
+  bool shm_active;  // messages go through "shm"
   uint32_t next_request_id;
   kvec_t(ChannelCallFrame *) call_stack;
   Dictionary info;
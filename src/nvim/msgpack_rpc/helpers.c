@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include <msgpack.h>
 
@@ -19,7 +20,6 @@
 # include "msgpack_rpc/helpers.c.generated.h"
 #endif
 
-static msgpack_zone zone;
 static msgpack_sbuffer sbuffer;
 
 #define HANDLE_TYPE_CONVERSION_IMPL(t, lt) \
@@ -32,12 +32,17 @@ static msgpack_sbuffer sbuffer;
       return false; \
     } \
     \
+    /* Use a zone of our own, requests can be decoded on the RPC decoder */ \
+    /* thread. */ \
+    msgpack_zone zone; \
+    msgpack_zone_init(&zone, 64); \
     msgpack_object data; \
     msgpack_unpack_return ret = msgpack_unpack(obj->via.ext.ptr, \
                                                obj->via.ext.size, \
                                                NULL, \
                                                &zone, \
                                                &data); \
+    msgpack_zone_destroy(&zone); \
     \
     if (ret != MSGPACK_UNPACK_SUCCESS) { \
       return false; \
@@ -61,7 +66,6 @@ static msgpack_sbuffer sbuffer;
 
 void msgpack_rpc_helpers_init(void)
 {
-  msgpack_zone_init(&zone, 0xfff);
   msgpack_sbuffer_init(&sbuffer);
 }
 
@@ -84,6 +88,55 @@ typedef struct {
 /// @return true in case of success, false otherwise.
 bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
   FUNC_ATTR_NONNULL_ALL
+{
+  return msgpack_rpc_to_object_arena(obj, arg, NULL, NULL);
+}
+
+static void *mp_calloc(Arena *arena, size_t count, size_t size)
+{
+  if (!arena) {
+    return xcalloc(count, size);
+  }
+  void *mem = arena_alloc(arena, count * size, true);
+  memset(mem, 0, count * size);
+  return mem;
+}
+
+/// Gets the text of a msgpack string as a NUL terminated C string.
+///
+/// @param unpacker  when not NULL, the unpacker that just returned the
+///                  message.  A string in its buffer that ends before the end
+///                  of the message is not copied: the byte after it is the
+///                  header of the next element, which was already parsed, so
+///                  it can be overwritten with a NUL.
+static char *mp_string(Arena *arena, const msgpack_unpacker *unpacker,
+                       const char *data, size_t len)
+{
+  if (unpacker != NULL && data != NULL
+      && (uintptr_t)data >= (uintptr_t)unpacker->buffer
+      && ((uintptr_t)data + len
+          < (uintptr_t)unpacker->buffer + unpacker->off)) {
+    char *str = (char *)data;
+    str[len] = NUL;
+    return str;
+  }
+  if (data == NULL) {
+    data = "";
+  }
+  return arena ? arena_memdupz(arena, data, len) : xmemdupz(data, len);
+}
+
+/// Converts "obj" to an API object.
+///
+/// @param arena  when not NULL, allocate the object from "arena", it must not
+///               be freed with api_free_object() then
+/// @param unpacker  when not NULL, strings may point into the buffer of the
+///                  unpacker that just returned "obj", see mp_string().  The
+///                  zone of the message must be kept while "arg" is used.
+static bool msgpack_rpc_to_object_arena(const msgpack_object *const obj,
+                                        Object *const arg, Arena *arena,
+                                        const msgpack_unpacker *unpacker)
+  FUNC_ATTR_NONNULL_ARG(1, 2)
 {
   bool ret = true;
   kvec_t(MPToAPIObjectStackItem) stack = KV_INITIAL_VALUE;
@@ -138,9 +191,10 @@ bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
       case type: { \
         dest = conv(((String) { \
           .size = obj->via.attr.size, \
-          .data = (obj->via.attr.ptr == NULL || obj->via.attr.size == 0 \
-                   ? xmemdupz("", 0) \
-                   : xmemdupz(obj->via.attr.ptr, obj->via.attr.size)), \
+          .data = (obj->via.attr.size == 0 \
+                   ? mp_string(arena, NULL, "", 0) \
+                   : mp_string(arena, unpacker, obj->via.attr.ptr, \
+                               obj->via.attr.size)), \
         })); \
         break; \
       }
@@ -166,7 +220,8 @@ bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
             .size = size,
             .capacity = size,
             .items = (size > 0
-                      ? xcalloc(size, sizeof(*cur.aobj->data.array.items))
+                      ? mp_calloc(arena, size,
+                                  sizeof(*cur.aobj->data.array.items))
                       : NULL),
           }));
           cur.container = true;
@@ -221,7 +276,8 @@ bool msgpack_rpc_to_object(const msgpack_object *const obj, Object *const arg)
             .size = size,
             .capacity = size,
             .items = (size > 0
-                      ? xcalloc(size, sizeof(*cur.aobj->data.dictionary.items))
+                      ? mp_calloc(arena, size,
+                                  sizeof(*cur.aobj->data.dictionary.items))
                       : NULL),
           }));
           cur.container = true;
@@ -283,18 +339,28 @@ static bool msgpack_rpc_to_string(const msgpack_object *const obj,
   return false;
 }
 
-bool msgpack_rpc_to_array(const msgpack_object *const obj, Array *const arg)
-  FUNC_ATTR_NONNULL_ALL
+/// Converts "obj" to an API array.
+///
+/// @param arena  when not NULL, allocate the array from "arena", it must not
+///               be freed with api_free_array() then
+/// @param unpacker  when not NULL, the unpacker that just returned "obj".
+///                  Strings are not copied but point into its buffer when
+///                  possible, the zone of the message must be kept while
+///                  "arg" is used.
+bool msgpack_rpc_to_array(const msgpack_object *const obj, Array *const arg,
+                          Arena *arena, const msgpack_unpacker *unpacker)
+  FUNC_ATTR_NONNULL_ARG(1, 2)
 {
   if (obj->type != MSGPACK_OBJECT_ARRAY) {
     return false;
   }
 
   arg->size = obj->via.array.size;
-  arg->items = xcalloc(obj->via.array.size, sizeof(Object));
+  arg->items = mp_calloc(arena, obj->via.array.size, sizeof(Object));
 
   for (uint32_t i = 0; i < obj->via.array.size; i++) {
-    if (!msgpack_rpc_to_object(obj->via.array.ptr + i, &arg->items[i])) {
+    if (!msgpack_rpc_to_object_arena(obj->via.array.ptr + i, &arg->items[i],
+                                     arena, unpacker)) {
       return false;
     }
   }
@@ -8,6 +8,7 @@
 
 #include "nvim/event/wstream.h"
 #include "nvim/api/private/defs.h"
+#include "nvim/memory.h"
 
 /// Value by which objects represented as EXT type are shifted
 ///
@@ -0,0 +1,260 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check
+// it. PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+
+// Shared memory transport for RPC clients on the same machine, see
+// |nvim__shm_attach()|.
+//
+// The segment is a file in the private temp directory that both processes
+// map.  It starts with a header page, followed by the ring that carries
+// messages from the client and the ring that carries messages to it:
+//
+//   offset 0       uint32 magic "NVSM", uint32 version, uint32 ring size
+//   offset 64      uint32 head, tail, waiting of the client ring
+//   offset 128     uint32 head, tail, waiting of the server ring
+//   offset 4096    client ring data, then server ring data
+//
+// All integers are in the native byte order.  "head" and "tail" count the
+// bytes written to and read from a ring, modulo 2^32; only the writer changes
+// "head" and only the reader changes "tail".  The ring size is a power of two.
+//
+// The socket the client attached from stays open, but only carries single
+// bytes that wake up the other side: each side sends one after it wrote to
+// its ring.  A writer that finds its ring full sets "waiting" and checks
+// again, the reader clears it and sends a byte once it made room.  Both
+// sides store, then load the other index or flag: these accesses must be
+// sequentially consistent, acquire/release allows both to miss the other's
+// store and wait forever.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "auto/config.h"
+
+#include "nvim/msgpack_rpc/shm.h"
+#include "nvim/api/private/helpers.h"
+#include "nvim/assert.h"
+#include "nvim/fileio.h"
+#include "nvim/memory.h"
+#include "nvim/os/os.h"
+#include "nvim/vim.h"
+
+#define SHM_MAGIC 0x4d53564eU  // "NVSM"
+#define SHM_VERSION 1
+#define SHM_HEADER_SIZE 4096
+#define SHM_RING_MIN (64 * 1024)
+#define SHM_RING_MAX (64 * 1024 * 1024)
+
+// Accesses to the header fields shared with the client.
+#ifdef __ATOMIC_RELAXED
+# define SHM_LOAD(p, order) __atomic_load_n((p), __ATOMIC_##order)
+# define SHM_STORE(p, v, order) __atomic_store_n((p), (v), __ATOMIC_##order)
+# define SHM_XCHG(p, v, order) __atomic_exchange_n((p), (v), __ATOMIC_##order)
+#else
+// MSVC: interlocked operations are full barriers on every target.
+# include <intrin.h>
+# define SHM_LOAD(p, order) \
+  ((uint32_t)_InterlockedCompareExchange((volatile long *)(p), 0, 0))
+# define SHM_STORE(p, v, order) \
+  ((void)_InterlockedExchange((volatile long *)(p), (long)(v)))
+# define SHM_XCHG(p, v, order) \
+  ((uint32_t)_InterlockedExchange((volatile long *)(p), (long)(v)))
+#endif
+
+typedef struct {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t waiting;
+} ShmRing;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  char pad1_[64 - 3 * sizeof(uint32_t)];
+  ShmRing in;   // client to server
+  char pad2_[64 - sizeof(ShmRing)];
+  ShmRing out;  // server to client
+} ShmHeader;
+
+STATIC_ASSERT(offsetof(ShmHeader, in) == 64, "client ring at offset 64");
+STATIC_ASSERT(offsetof(ShmHeader, out) == 128, "server ring at offset 128");
+
+struct rpc_shm {
+  char *path;
+  char *mem;
+  size_t mapsize;
+  uint32_t size;  // size of each ring
+  ShmHeader *hdr;
+  char *in;
+  char *out;
+};
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "msgpack_rpc/shm.c.generated.h"
+#endif
+
+/// Creates a shared memory segment with two rings.
+///
+/// @param size  Minimal size of each ring, rounded up to a power of two.
+/// @param[out] err  Error details, if any
+/// @return NULL on failure
+RpcShm *rpc_shm_new(Integer size, Error *err)
+  FUNC_ATTR_NONNULL_ALL
+{
+#ifndef HAVE_SYS_MMAN_H
+  api_set_error(err, kErrorTypeException,
+                "Shared memory is not supported on this system");
+  return NULL;
+#else
+  if (size < 0 || size > SHM_RING_MAX) {
+    api_set_error(err, kErrorTypeValidation, "Invalid size: %" PRId64, size);
+    return NULL;
+  }
+  uint32_t ringsize = SHM_RING_MIN;
+  while (ringsize < (uint32_t)size) {
+    ringsize <<= 1;
+  }
+
+  char *path = (char *)vim_tempname();
+  if (path == NULL) {
+    api_set_error(err, kErrorTypeException, "Failed to get a temp file name");
+    return NULL;
+  }
+
+  size_t mapsize = SHM_HEADER_SIZE + 2 * (size_t)ringsize;
+  char *mem = NULL;
+  int fd = os_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  int r = fd;
+  if (fd >= 0) {
+    // The file is filled with zeros, that is an empty header.
+    r = os_ftruncate(fd, mapsize);
+    if (r == 0) {
+      mem = os_mmap_shared(fd, mapsize);
+    }
+    os_close(fd);
+  }
+  if (mem == NULL) {
+    api_set_error(err, kErrorTypeException,
+                  "Failed to create shared memory %s: %s", path,
+                  r < 0 ? os_strerror(r) : "mmap failed");
+    if (fd >= 0) {
+      os_remove(path);
+    }
+    xfree(path);
+    return NULL;
+  }
+
+  RpcShm *shm = xmalloc(sizeof(*shm));
+  shm->path = path;
+  shm->mem = mem;
+  shm->mapsize = mapsize;
+  shm->size = ringsize;
+  shm->hdr = (ShmHeader *)mem;
+  shm->in = mem + SHM_HEADER_SIZE;
+  shm->out = shm->in + ringsize;
+  shm->hdr->version = SHM_VERSION;
+  shm->hdr->size = ringsize;
+  SHM_STORE(&shm->hdr->magic, SHM_MAGIC, RELEASE);
+  return shm;
+#endif
+}
+
+/// Unmaps and deletes the segment.
+void rpc_shm_free(RpcShm *shm)
+{
+  if (shm == NULL) {
+    return;
+  }
+  os_munmap(shm->mem, shm->mapsize);
+  os_remove(shm->path);
+  xfree(shm->path);
+  xfree(shm);
+}
+
+/// Path of the file the client maps.
+const char *rpc_shm_path(const RpcShm *shm)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_PURE
+{
+  return shm->path;
+}
+
+/// Size of each ring.
+size_t rpc_shm_size(const RpcShm *shm)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_PURE
+{
+  return shm->size;
+}
+
+/// Number of bytes in the client ring.
+size_t rpc_shm_readable(const RpcShm *shm)
+  FUNC_ATTR_NONNULL_ALL
+{
+  const ShmRing *ring = &shm->hdr->in;
+  uint32_t used = SHM_LOAD(&ring->head, ACQUIRE) - ring->tail;
+  // Never trust the client with the bounds.
+  return MIN(used, shm->size);
+}
+
+/// Reads from the client ring.
+///
+/// @param count  Number of bytes to read, at most rpc_shm_readable().
+void rpc_shm_read(RpcShm *shm, char *dst, size_t count)
+  FUNC_ATTR_NONNULL_ALL
+{
+  ShmRing *ring = &shm->hdr->in;
+  uint32_t tail = ring->tail;
+  uint32_t off = tail & (shm->size - 1);
+  size_t first = MIN(count, shm->size - off);
+  memcpy(dst, shm->in + off, first);
+  memcpy(dst + first, shm->in, count - first);
+  SHM_STORE(&ring->tail, tail + (uint32_t)count, SEQ_CST);
+}
+
+/// Checks whether the client waits for room in its ring, and clears the flag.
+///
+/// @return true if the client must be woken up
+bool rpc_shm_take_waiting(RpcShm *shm)
+  FUNC_ATTR_NONNULL_ALL
+{
+  return SHM_XCHG(&shm->hdr->in.waiting, 0, SEQ_CST) != 0;
+}
+
+/// Writes to the server ring as much as fits.  When the ring is full, asks
+/// the client to wake up Nvim when it made room.
+///
+/// @return number of bytes written, less than "size" if the ring is full
+size_t rpc_shm_write(RpcShm *shm, const char *data, size_t size)
+  FUNC_ATTR_NONNULL_ALL
+{
+  ShmRing *ring = &shm->hdr->out;
+  uint32_t head = ring->head;
+  size_t written = 0;
+  bool asked = false;
+
+  while (written < size) {
+    uint32_t used = head - SHM_LOAD(&ring->tail, SEQ_CST);
+    size_t count = MIN(size - written, shm->size - MIN(used, shm->size));
+    if (count == 0) {
+      if (asked) {
+        break;
+      }
+      // The client may have made room before it saw the flag, check again.
+      SHM_STORE(&ring->waiting, 1, SEQ_CST);
+      asked = true;
+      continue;
+    }
+    uint32_t off = head & (shm->size - 1);
+    size_t first = MIN(count, shm->size - off);
+    memcpy(shm->out + off, data + written, first);
+    memcpy(shm->out, data + written + first, count - first);
+    head += (uint32_t)count;
+    written += count;
+    SHM_STORE(&ring->head, head, RELEASE);
+  }
+  return written;
+}
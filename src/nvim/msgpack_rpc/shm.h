@@ -0,0 +1,14 @@
+#ifndef NVIM_MSGPACK_RPC_SHM_H
+#define NVIM_MSGPACK_RPC_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nvim/api/private/defs.h"
+
+typedef struct rpc_shm RpcShm;
+
+#ifdef INCLUDE_GENERATED_DECLARATIONS
+# include "msgpack_rpc/shm.h.generated.h"
+#endif
+#endif  // NVIM_MSGPACK_RPC_SHM_H
@@ -1370,8 +1370,11 @@ static int normal_check(VimState *state)
     }
 
     normal_check_folds(s);
-    normal_redraw(s);
-    do_redraw = false;
+    // With 'maxfps' a redraw for events may wait for the next frame.
+    if (!redraw_defer(&s->state, s->c != K_EVENT)) {
+      normal_redraw(s);
+      do_redraw = false;
+    }
 
     // Now that we have drawn the first screen all the startup stuff
     // has been done, close any file for startup messages.
@@ -4175,6 +4175,10 @@ static char *set_num_option(int opt_idx, char_u *varp, long value,
     }
   } else if (pp == &p_mco) {
     value = MAX_MCO;
+  } else if (pp == &p_mfps) {
+    if (value < 0) {
+      errmsg = e_positive;
+    }
   } else if (pp == &p_titlelen) {
     if (value < 0) {
       errmsg = e_positive;
@@ -4541,6 +4545,9 @@ static void check_redraw(uint32_t flags)
   bool doclear = (flags & P_RCLR) == P_RCLR;
   bool all = ((flags & P_RALL) == P_RALL || doclear);
 
+  // The option may change how lines are drawn.
+  line_cache_gen++;
+
   if ((flags & P_RSTAT) || all) {  // mark all status lines dirty
     status_redraw_all();
   }
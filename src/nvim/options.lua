@@ -1680,6 +1680,14 @@ return {
       varname='p_mco',
       defaults={if_true={vi=6}}
     },
+    {
+      full_name='maxfps', abbreviation='mfps',
+      short_desc=N_("maximum redraws per second for events"),
+      type='number', scope={'global'},
+      vi_def=true,
+      varname='p_mfps',
+      defaults={if_true={vi=0}}
+    },
     {
       full_name='maxfuncdepth', abbreviation='mfd',
       short_desc=N_("maximum recursive depth for user functions"),
@@ -1696,6 +1704,14 @@ return {
       varname='p_mmd',
       defaults={if_true={vi=1000}}
     },
+    {
+      full_name='maxmem', abbreviation='mm',
+      short_desc=N_("maximum memory (in Kbyte) used for one buffer"),
+      type='number', scope={'global'},
+      vi_def=true,
+      varname='p_mm',
+      defaults={if_true={vi=0}}
+    },
     {
       full_name='maxmempattern', abbreviation='mmp',
       short_desc=N_("maximum memory (in Kbyte) used for pattern search"),
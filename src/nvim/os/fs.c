@@ -15,6 +15,12 @@
 # include <sys/uio.h>
 #endif
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+# include <setjmp.h>
+# include <signal.h>
+#endif
+
 #include <uv.h>
 
 #include "nvim/os/os.h"
@@ -54,6 +60,22 @@ uv_call_start: {} \
 static const int kLibuvSuccess = 0;
 static uv_loop_t fs_loop;
 
+#ifdef HAVE_SYS_MMAN_H
+// For os_mmap_call(): the jump buffer of a thread while it reads a mapping,
+// NULL otherwise.  The SIGBUS handler is installed on the first mapping.
+static uv_key_t mmap_jmp_key;
+static uv_once_t mmap_once = UV_ONCE_INIT;
+static bool mmap_guard_ok = false;
+static struct sigaction mmap_old_sigbus;
+#endif
+
+/// Arguments for mmap_copy().
+typedef struct {
+  char *dst;
+  const char *src;
+  size_t len;
+} MmapCopy;
+
 
 // Initialize the fs module
 void fs_init(void)
@@ -702,6 +724,25 @@ ptrdiff_t os_write(const int fd, const char *const buf, const size_t size,
   return (ptrdiff_t)written_bytes;
 }
 
+/// Write to a file from multiple buffers at once
+///
+/// Wrapper for uv_fs_write() with several buffers, which uses writev() where
+/// possible and keeps writing until all data is written.
+///
+/// @param[in]  fd  File descriptor to write to.
+/// @param[in,out]  bufs  Data to write. Note: may be changed, it is incorrect
+///                       to use it after os_writev().
+/// @param[in]  nbufs  Number of buffers in bufs.
+///
+/// @return Number of bytes written or libuv error code (< 0).
+ptrdiff_t os_writev(const int fd, uv_buf_t *const bufs, const size_t nbufs)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_WARN_UNUSED_RESULT
+{
+  int r;
+  RUN_UV_FS_FUNC(r, uv_fs_write, fd, bufs, (unsigned)nbufs, -1, NULL);
+  return (ptrdiff_t)r;
+}
+
 /// Copies a file from `path` to `new_path`.
 ///
 /// @see http://docs.libuv.org/en/v1.x/fs.html#c.uv_fs_copyfile
@@ -730,6 +771,16 @@ int os_fsync(int fd)
   return r;
 }
 
+/// Sets the size of an open file.
+///
+/// @return 0 on success, or libuv error code on failure.
+int os_ftruncate(int fd, uint64_t size)
+{
+  int r;
+  RUN_UV_FS_FUNC(r, uv_fs_ftruncate, fd, (int64_t)size, NULL);
+  return r;
+}
+
 /// Get stat information for a file.
 ///
 /// @return libuv return code, or -errno
@@ -1055,6 +1106,145 @@ bool os_fileinfo_fd(int file_descriptor, FileInfo *file_info)
   return ok;
 }
 
+/// Map the first `size` bytes of an open file read-only into memory
+///
+/// The mapping is private and stays valid after `fd` is closed.  Only use
+/// this for regular files.  Accessing the mapping past the end of a file
+/// that was truncated in the meantime raises SIGBUS: only read it with
+/// os_mmap_call() or os_mmap_copy(), which fail instead.
+///
+/// @param fd  File descriptor opened for reading.
+/// @param size  Number of bytes to map, must be > 0.
+/// @return Start of the mapping or NULL when mapping is not possible, the
+///         caller should then read() the file instead.
+const char *os_mmap_read(int fd, size_t size)
+  FUNC_ATTR_WARN_UNUSED_RESULT
+{
+#ifdef HAVE_SYS_MMAN_H
+  uv_once(&mmap_once, mmap_guard_init);
+  if (!mmap_guard_ok) {
+    return NULL;
+  }
+  void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {
+    return NULL;
+  }
+# ifdef POSIX_MADV_SEQUENTIAL
+  // Mostly read front to back, let the kernel read ahead aggressively.
+  (void)posix_madvise(addr, size, POSIX_MADV_SEQUENTIAL);
+# endif
+  return addr;
+#else
+  (void)fd;
+  (void)size;
+  return NULL;
+#endif
+}
+
+#ifdef HAVE_SYS_MMAN_H
+static void mmap_guard_init(void)
+{
+  if (uv_key_create(&mmap_jmp_key) != 0) {
+    return;
+  }
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = mmap_sigbus_handler;
+  sigemptyset(&sa.sa_mask);
+  mmap_guard_ok = sigaction(SIGBUS, &sa, &mmap_old_sigbus) == 0;
+}
+
+static void mmap_sigbus_handler(int signum)
+{
+  (void)signum;
+  sigjmp_buf *env = uv_key_get(&mmap_jmp_key);
+  if (env == NULL) {
+    // Not reading a mapping.  Restore the old action, it applies when the
+    // faulting instruction runs again.
+    sigaction(SIGBUS, &mmap_old_sigbus, NULL);
+    return;
+  }
+  siglongjmp(*env, 1);
+}
+#endif
+
+/// Call `fn` to read a mapping made by os_mmap_read().  When the file was
+/// truncated and `fn` reads past its new end, `fn` is abandoned at that
+/// access and false is returned.  `fn` must not read the mapping while in the
+/// middle of changing anything else, e.g. from inside an allocation.
+///
+/// Can be called from any thread.
+///
+/// @return false when reading the mapping failed.
+bool os_mmap_call(void (*fn)(void *), void *arg)
+  FUNC_ATTR_NONNULL_ARG(1)
+{
+#ifdef HAVE_SYS_MMAN_H
+  sigjmp_buf env;
+  if (sigsetjmp(env, 1) != 0) {
+    uv_key_set(&mmap_jmp_key, NULL);
+    return false;
+  }
+  uv_key_set(&mmap_jmp_key, &env);
+  fn(arg);
+  uv_key_set(&mmap_jmp_key, NULL);
+#else
+  fn(arg);
+#endif
+  return true;
+}
+
+static void mmap_copy(void *arg)
+{
+  MmapCopy *copy = arg;
+  memcpy(copy->dst, copy->src, copy->len);
+}
+
+/// Copy `len` bytes from a mapping made by os_mmap_read(), see
+/// os_mmap_call().
+///
+/// @return false when the file was truncated.
+bool os_mmap_copy(char *dst, const char *src, size_t len)
+  FUNC_ATTR_NONNULL_ALL FUNC_ATTR_WARN_UNUSED_RESULT
+{
+  MmapCopy copy = { .dst = dst, .src = src, .len = len };
+  return os_mmap_call(mmap_copy, &copy);
+}
+
+/// Map the first `size` bytes of an open file read-write and shared, writes
+/// are seen by other processes that map the same file.
+///
+/// @param fd  File descriptor opened for reading and writing.
+/// @param size  Number of bytes to map, must be > 0.
+/// @return Start of the mapping or NULL when mapping is not possible.
+char *os_mmap_shared(int fd, size_t size)
+  FUNC_ATTR_WARN_UNUSED_RESULT
+{
+#ifdef HAVE_SYS_MMAN_H
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  return addr == MAP_FAILED ? NULL : addr;
+#else
+  (void)fd;
+  (void)size;
+  return NULL;
+#endif
+}
+
+/// Unmap memory mapped with os_mmap_read() or os_mmap_shared()
+///
+/// @param addr  Value returned by os_mmap_read() or os_mmap_shared().
+/// @param size  Size passed when mapping.
+void os_munmap(const char *addr, size_t size)
+  FUNC_ATTR_NONNULL_ALL
+{
+#ifdef HAVE_SYS_MMAN_H
+  (void)munmap((void *)addr, size);
+#else
+  (void)addr;
+  (void)size;
+#endif
+}
+
 /// Compare the inodes of two FileInfos
 ///
 /// @return `true` if the two FileInfos represent the same file.
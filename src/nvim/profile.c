@@ -4,15 +4,22 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#include <string.h>
 
 #include "nvim/assert.h"
 #include "nvim/profile.h"
 #include "nvim/os/time.h"
 #include "nvim/func_attr.h"
 #include "nvim/os/os_defs.h"
+#include "nvim/os/os.h"
 
 #include "nvim/globals.h"  // for the global `time_fd` (startuptime)
 
+#ifndef __ATOMIC_RELAXED
+// MSVC: interlocked operations for the counters that the TUI thread updates.
+# include <intrin.h>
+#endif
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "profile.c.generated.h"
 #endif
@@ -290,3 +297,189 @@ void time_msg(const char *mesg, const proftime_T *start)
   g_prev_time = now;
   fprintf(time_fd, ": %s\n", mesg);
 }
+
+static RedrawProfStats redraw_stats;
+static int64_t frame_count_start[kRedrawCountCount];
+static proftime_T frame_start_time = 0;
+static FILE *redraw_log_fd = NULL;
+
+static const char *const redraw_phase_names[kRedrawPhaseCount] = {
+  [kRedrawPhaseScreen] = "screen",
+  [kRedrawPhaseWindow] = "window",
+  [kRedrawPhaseLine] = "line",
+  [kRedrawPhaseDecor] = "decor",
+  [kRedrawPhaseSyntax] = "syntax",
+  [kRedrawPhaseCompose] = "compose",
+  [kRedrawPhaseFlush] = "flush",
+  [kRedrawPhaseFrame] = "frame",
+};
+
+static const char *const redraw_counter_names[kRedrawCountCount] = {
+  [kRedrawCountLines] = "lines",
+  [kRedrawCountCells] = "cells",
+  [kRedrawCountBytes] = "bytes",
+};
+
+/// Gets the name of a redraw phase, as used by nvim__redraw_profile().
+const char *redraw_prof_phase_name(RedrawPhase phase)
+  FUNC_ATTR_NONNULL_RET FUNC_ATTR_PURE
+{
+  return redraw_phase_names[phase];
+}
+
+/// Gets the name of a redraw counter, as used by nvim__redraw_profile().
+const char *redraw_prof_counter_name(RedrawCounter counter)
+  FUNC_ATTR_NONNULL_RET FUNC_ATTR_PURE
+{
+  return redraw_counter_names[counter];
+}
+
+/// Gets the collected redraw statistics.
+const RedrawProfStats *redraw_prof_stats(void)
+  FUNC_ATTR_NONNULL_RET FUNC_ATTR_PURE
+{
+  return &redraw_stats;
+}
+
+/// Clears the collected redraw statistics.
+void redraw_prof_reset(void)
+{
+  memset(&redraw_stats, 0, sizeof(redraw_stats));
+  memset(frame_count_start, 0, sizeof(frame_count_start));
+  frame_start_time = 0;
+}
+
+/// Sets the file where a line is appended for every redrawn frame.
+///
+/// @param fname  file name, NULL to stop logging
+/// @return false if the file could not be opened
+bool redraw_prof_set_log(const char *fname)
+{
+  if (redraw_log_fd != NULL) {
+    fclose(redraw_log_fd);
+    redraw_log_fd = NULL;
+  }
+  if (fname == NULL) {
+    return true;
+  }
+  redraw_log_fd = os_fopen(fname, "a");
+  if (redraw_log_fd == NULL) {
+    return false;
+  }
+  fprintf(redraw_log_fd, "\n\ntimes in msec, counts per frame\n");
+  fprintf(redraw_log_fd, "   frame");
+  for (int i = 0; i < kRedrawPhaseFrame; i++) {
+    fprintf(redraw_log_fd, " %8s", redraw_phase_names[i]);
+  }
+  for (int i = 0; i < kRedrawCountCount; i++) {
+    fprintf(redraw_log_fd, " %8s", redraw_counter_names[i]);
+  }
+  fprintf(redraw_log_fd, "\n");
+  fflush(redraw_log_fd);
+  return true;
+}
+
+/// Adds the time elapsed since `start` to a redraw phase.
+///
+/// Use REDRAW_PROF_END() instead, which checks if the profiler is enabled.
+void redraw_prof_add(RedrawPhase phase, proftime_T start)
+{
+  proftime_T tm = profile_end(start);
+  RedrawPhaseStats *stats = &redraw_stats.phase[phase];
+  stats->frame += tm;
+  stats->count++;
+}
+
+/// Increments a redraw counter.  Thread-safe, bytes are counted by the TUI
+/// thread.
+void redraw_prof_count(RedrawCounter counter, int64_t n)
+{
+#ifdef __ATOMIC_RELAXED
+  __atomic_fetch_add(&redraw_stats.count[counter], n, __ATOMIC_RELAXED);
+#else
+  (void)_InterlockedExchangeAdd64((volatile __int64 *)
+                                  &redraw_stats.count[counter], (__int64)n);
+#endif
+}
+
+/// Gets a redraw counter, see redraw_prof_count().
+int64_t redraw_prof_get_count(RedrawCounter counter)
+{
+#ifdef __ATOMIC_RELAXED
+  return __atomic_load_n(&redraw_stats.count[counter], __ATOMIC_RELAXED);
+#else
+  return (int64_t)_InterlockedCompareExchange64(
+      (volatile __int64 *)&redraw_stats.count[counter], 0, 0);
+#endif
+}
+
+/// Starts a frame, called when update_screen() starts drawing.
+///
+/// A frame lasts until the following ui_flush(), nested update_screen()
+/// calls in between are part of the same frame.
+void redraw_prof_frame_start(void)
+{
+  if (!redraw_prof_enabled || frame_start_time != 0) {
+    return;
+  }
+  frame_start_time = profile_start();
+  for (int i = 0; i < kRedrawPhaseCount; i++) {
+    redraw_stats.phase[i].frame = 0;
+  }
+  for (int i = 0; i < kRedrawCountCount; i++) {
+    frame_count_start[i] = redraw_prof_get_count(i);
+  }
+}
+
+static int redraw_hist_bucket(proftime_T tm)
+  FUNC_ATTR_CONST
+{
+  uint64_t usec = tm / 1000;
+  int bucket = 0;
+  while (usec > 1 && bucket < REDRAW_HIST_SIZE - 1) {
+    usec >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/// Ends a frame, called when ui_flush() is done.  Updates the histograms and
+/// writes the frame to the log file.
+void redraw_prof_frame_end(void)
+{
+  if (!redraw_prof_enabled) {
+    frame_start_time = 0;
+    return;
+  }
+  if (frame_start_time == 0) {
+    return;
+  }
+  RedrawPhaseStats *frame = &redraw_stats.phase[kRedrawPhaseFrame];
+  frame->frame = profile_end(frame_start_time);
+  frame->count++;
+  frame_start_time = 0;
+  redraw_stats.frames++;
+
+  for (int i = 0; i < kRedrawPhaseCount; i++) {
+    RedrawPhaseStats *stats = &redraw_stats.phase[i];
+    stats->total += stats->frame;
+    if (stats->frame > stats->max) {
+      stats->max = stats->frame;
+    }
+    stats->hist[redraw_hist_bucket(stats->frame)]++;
+  }
+
+  if (redraw_log_fd != NULL) {
+    fprintf(redraw_log_fd, "%8.3lf", (double)frame->frame / 1.0E6);
+    for (int i = 0; i < kRedrawPhaseFrame; i++) {
+      fprintf(redraw_log_fd, " %8.3lf",
+              (double)redraw_stats.phase[i].frame / 1.0E6);
+    }
+    for (int i = 0; i < kRedrawCountCount; i++) {
+      fprintf(redraw_log_fd, " %8" PRId64,
+              redraw_prof_get_count(i) - frame_count_start[i]);
+    }
+    fprintf(redraw_log_fd, "\n");
+    fflush(redraw_log_fd);
+  }
+}
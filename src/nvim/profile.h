@@ -10,6 +10,61 @@ typedef uint64_t proftime_T;
     if (time_fd != NULL) time_msg(s, NULL); \
   } while (0)
 
+/// Phases of a redraw timed by the redraw profiler.  Phases nest: the time
+/// of win_line() is also counted for win_update() and update_screen().
+typedef enum {
+  kRedrawPhaseScreen,   ///< update_screen()
+  kRedrawPhaseWindow,   ///< win_update()
+  kRedrawPhaseLine,     ///< win_line()
+  kRedrawPhaseDecor,    ///< decor_redraw_line(), _col() and _eol()
+  kRedrawPhaseSyntax,   ///< get_syntax_attr()
+  kRedrawPhaseCompose,  ///< compositor, compose_line()
+  kRedrawPhaseFlush,    ///< ui_flush()
+  kRedrawPhaseFrame,    ///< whole frame, update_screen() until ui_flush()
+} RedrawPhase;
+#define kRedrawPhaseCount (kRedrawPhaseFrame + 1)
+
+/// Counters of the redraw profiler.
+typedef enum {
+  kRedrawCountLines,  ///< buffer lines drawn by win_line()
+  kRedrawCountCells,  ///< grid cells sent to the UIs
+  kRedrawCountBytes,  ///< bytes written to the terminal and UI channels
+} RedrawCounter;
+#define kRedrawCountCount (kRedrawCountBytes + 1)
+
+/// Number of histogram buckets.  Bucket i counts frames where the phase took
+/// [2^i, 2^(i+1)) microseconds, the last one everything above.
+#define REDRAW_HIST_SIZE 17
+
+typedef struct {
+  proftime_T total;   ///< time over all frames
+  proftime_T max;     ///< longest frame
+  proftime_T frame;   ///< time in the current frame
+  int64_t count;      ///< number of times the phase was entered
+  int64_t hist[REDRAW_HIST_SIZE];  ///< frames by time spent in the phase
+} RedrawPhaseStats;
+
+typedef struct {
+  int64_t frames;
+  RedrawPhaseStats phase[kRedrawPhaseCount];
+  int64_t count[kRedrawCountCount];  ///< read with redraw_prof_get_count()
+} RedrawProfStats;
+
+/// Starts timing a redraw phase, cheap when the profiler is off.
+#define REDRAW_PROF_START() (redraw_prof_enabled ? profile_start() : 0)
+
+#define REDRAW_PROF_END(phase, start) do { \
+    if (redraw_prof_enabled && (start) != 0) { \
+      redraw_prof_add((phase), (start)); \
+    } \
+  } while (0)
+
+#define REDRAW_PROF_COUNT(counter, n) do { \
+    if (redraw_prof_enabled) { \
+      redraw_prof_count((counter), (int64_t)(n)); \
+    } \
+  } while (0)
+
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "profile.h.generated.h"
 #endif
@@ -86,6 +86,7 @@
 #include "nvim/getchar.h"
 #include "nvim/highlight.h"
 #include "nvim/main.h"
+#include "nvim/map.h"
 #include "nvim/mark.h"
 #include "nvim/extmark.h"
 #include "nvim/decoration.h"
@@ -102,6 +103,7 @@
 #include "nvim/os_unix.h"
 #include "nvim/path.h"
 #include "nvim/popupmnu.h"
+#include "nvim/profile.h"
 #include "nvim/quickfix.h"
 #include "nvim/regexp.h"
 #include "nvim/search.h"
@@ -134,6 +136,16 @@ static size_t linebuf_size = 0;
 static schar_T *linebuf_char = NULL;
 static sattr_T *linebuf_attr = NULL;
 
+// The glyph table, the text of screen cells that does not fit in a schar_T.
+// Entries are only added, never changed or removed, thus the UI thread of
+// the TUI can read them.  They are allocated in chunks, GLYPH_MAX entries at
+// most, beyond that only the base character of a cell is shown.
+#define GLYPH_CHUNK_SIZE 1024
+#define GLYPH_MAX (256 * GLYPH_CHUNK_SIZE)
+static char *glyph_chunks[GLYPH_MAX / GLYPH_CHUNK_SIZE];
+static uint32_t glyph_count = 0;
+static PMap(cstr_t) *glyph_map = NULL;  // text -> index + 1
+
 static match_T search_hl;       /* used for 'hlsearch' highlight matching */
 
 StlClickDefinition *tab_page_click_defs = NULL;
@@ -159,6 +171,20 @@ static bool msg_grid_invalid = false;
 
 static bool resizing = false;
 
+#define LINE_CACHE_SIZE 128     // lines in the cache of drawn lines
+#define LINE_CACHE_MAX_ROWS 4   // screen rows of the longest cached line
+
+// Entry of the cache of drawn lines that win_line() is filling, NULL when
+// it is not caching.  "line_cache_complete" is set when win_line() drew the
+// end of the line.
+static linecache_T *line_cache_fill = NULL;
+static bool line_cache_complete = false;
+
+// For 'maxfps': when the last frame was drawn, and the state whose redraw
+// waits for the next frame, if any.
+static uint64_t last_frame_time = 0;
+static const VimState *frame_deferred = NULL;
+
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "screen.c.generated.h"
@@ -306,6 +332,50 @@ redrawWinline(
   }
 }
 
+/// Nanoseconds until the next frame may be drawn, zero if it may be drawn now.
+static uint64_t frame_wait_ns(void)
+{
+  if (p_mfps <= 0) {
+    return 0;
+  }
+  uint64_t frame_ns = 1000000000 / (uint64_t)p_mfps;
+  uint64_t elapsed = os_hrtime() - last_frame_time;
+  return elapsed < frame_ns ? frame_ns - elapsed : 0;
+}
+
+/// Check whether a redraw must wait for the next frame, because of
+/// 'maxfps'.  Redraws caused by events are delayed until at least
+/// 1/'maxfps' second after the previous frame.  Meanwhile redraw_later()
+/// requests are collected and drawn together, see redraw_wait_ms().
+///
+/// @param s  the state whose check() redraws
+/// @param typed  the redraw follows typed input, which is never delayed
+///
+/// @return true when the caller must not redraw now
+bool redraw_defer(const VimState *s, bool typed)
+  FUNC_ATTR_NONNULL_ALL
+{
+  frame_deferred = !typed && frame_wait_ns() > 0 ? s : NULL;
+  return frame_deferred != NULL;
+}
+
+/// Milliseconds that state "s" waits for input before drawing the frame that
+/// redraw_defer() postponed, -1 if it has no redraw waiting.  Another state,
+/// like Insert mode entered by an event meanwhile, does not wait for it.
+int redraw_wait_ms(const VimState *s)
+  FUNC_ATTR_NONNULL_ALL
+{
+  if (frame_deferred != s) {
+    return -1;
+  }
+  uint64_t wait_ns = frame_wait_ns();
+  if (wait_ns == 0) {
+    // Due now: check() must draw it or defer it again.
+    frame_deferred = NULL;
+  }
+  return (int)((wait_ns + 999999) / 1000000);
+}
+
 /*
  * update all windows that are editing the current buffer
  */
@@ -363,6 +433,11 @@ int update_screen(int type)
     return FAIL;
   }
   updating_screen = 1;
+  last_frame_time = os_hrtime();
+  frame_deferred = NULL;
+  g_stats.redraw++;
+  redraw_prof_frame_start();
+  proftime_T prof_start = REDRAW_PROF_START();
 
   display_tick++;           // let syntax code know we're in a next round of
                             // display updating
@@ -458,6 +533,7 @@ int update_screen(int type)
   if (type == CLEAR) {          // first clear screen
     screenclear();              // will reset clear_cmdline
     cmdline_screen_cleared();   // clear external cmdline state
+    line_cache_gen++;           // ":redraw!" draws all lines again
     type = NOT_VALID;
     // must_redraw may be set indirectly, avoid another redraw later
     must_redraw = 0;
@@ -576,6 +652,9 @@ int update_screen(int type)
   /*
    * Go from top to bottom through the windows, redrawing the ones that need
    * it.
+   * This must be done one window at a time on the main thread: win_line()
+   * uses the global syntax and 'hlsearch' state, the memline block cache
+   * and decoration providers that run Lua code.
    */
   did_one = FALSE;
   search_hl.rm.regprog = NULL;
@@ -599,7 +678,9 @@ int update_screen(int type)
         did_one = TRUE;
         start_search_hl();
       }
+      proftime_T prof_win_start = REDRAW_PROF_START();
       win_update(wp, &providers);
+      REDRAW_PROF_END(kRedrawPhaseWindow, prof_win_start);
     }
 
     /* redraw status line after the window to minimize cursor movement */
@@ -653,6 +734,7 @@ int update_screen(int type)
 
   // either cmdline is cleared, not drawn or mode is last drawn
   cmdline_was_last_drawn = false;
+  REDRAW_PROF_END(kRedrawPhaseScreen, prof_start);
   return OK;
 }
 
@@ -1324,6 +1406,7 @@ static void win_update(win_T *wp, Providers *providers)
 
   win_check_ns_hl(wp);
 
+  bool use_line_cache = line_cache_prepare(wp, kv_size(line_providers) > 0);
 
   for (;; ) {
     /* stop updating when reached the end of the window (check for _past_
@@ -1535,10 +1618,27 @@ static void win_update(win_T *wp, Providers *providers)
             && syntax_present(wp))
           syntax_end_parsing(syntax_last_parsed + 1);
 
-        // Display one line
-        row = win_line(wp, lnum, srow,
-                       foldinfo.fi_lines ? srow : wp->w_grid.Rows,
-                       mod_top == 0, false, foldinfo, &line_providers);
+        // Display one line.  Take it from the cache of drawn lines when
+        // possible.  The cursor line is always drawn, for 'cursorline' and
+        // 'concealcursor'.
+        bool cache_line = use_line_cache && foldinfo.fi_lines == 0
+                          && lnum != wp->w_cursor.lnum
+                          && !(lnum == wp->w_topline && wp->w_skipcol > 0);
+        row = cache_line ? line_cache_draw(wp, lnum, srow) : -1;
+        if (row < 0) {
+          if (cache_line) {
+            line_cache_begin(wp, lnum);
+          }
+          proftime_T prof_start = REDRAW_PROF_START();
+          row = win_line(wp, lnum, srow,
+                         foldinfo.fi_lines ? srow : wp->w_grid.Rows,
+                         mod_top == 0, false, foldinfo, &line_providers);
+          REDRAW_PROF_END(kRedrawPhaseLine, prof_start);
+          REDRAW_PROF_COUNT(kRedrawCountLines, 1);
+          if (cache_line) {
+            line_cache_end(row - srow);
+          }
+        }
 
         wp->w_lines[idx].wl_folded = foldinfo.fi_lines != 0;
         wp->w_lines[idx].wl_lastlnum = lnum;
@@ -1574,8 +1674,11 @@ static void win_update(win_T *wp, Providers *providers)
         // 'relativenumber' set: The text doesn't need to be drawn, but
         // the number column nearly always does.
         foldinfo_T info = fold_info(wp, lnum);
+        proftime_T prof_start = REDRAW_PROF_START();
         (void)win_line(wp, lnum, srow, wp->w_grid.Rows, true, true,
                        info, &line_providers);
+        REDRAW_PROF_END(kRedrawPhaseLine, prof_start);
+        REDRAW_PROF_COUNT(kRedrawCountLines, 1);
       }
 
       // This line does not need to be drawn, advance to the next one.
@@ -1871,7 +1974,7 @@ static int line_putchar(LineState *s, schar_T *dest, int maxcells, bool rl)
   }
   u8c = utfc_ptr2char(p, u8cc);
   if (*p < 0x80 && u8cc[0] == 0) {
-    schar_from_ascii(dest[0], *p);
+    dest[0] = schar_from_ascii((char)(*p));
     s->prev_c = u8c;
   } else {
     if (p_arshape && !p_tbidi && arabic_char(u8c)) {
@@ -1898,10 +2001,10 @@ static int line_putchar(LineState *s, schar_T *dest, int maxcells, bool rl)
     } else {
       s->prev_c = u8c;
     }
-    schar_from_cc(dest[0], u8c, u8cc);
+    dest[0] = schar_from_cc(u8c, u8cc);
   }
   if (cells > 1) {
-    dest[1][0] = 0;
+    dest[1] = 0;
   }
   s->p += c_len;
   return cells;
@@ -1978,6 +2081,162 @@ fill_foldcolumn(
   return MAX(char_counter + (fdc-i), (size_t)fdc);
 }
 
+/// Check whether lines of window "wp" can be drawn from its cache of drawn
+/// lines, and added to it.  Not when drawing a line depends on more than its
+/// text, the options and the highlights, e.g. on the cursor position,
+/// matches, signs or decorations.  Empties the cache when it is outdated.
+///
+/// @param has_providers  decoration providers are active for the window
+static bool line_cache_prepare(win_T *wp, bool has_providers)
+{
+  buf_T *buf = wp->w_buffer;
+
+  if (has_providers
+      || buf->terminal
+      || bt_quickfix(buf)
+      || wp->w_p_rl
+      || wp->w_p_cuc
+      || wp->w_p_rnu
+      || wp->w_p_spell
+      || wp->w_p_diff
+      || wp->w_match_head != NULL
+      || search_hl.rm.regprog != NULL
+      || highlight_match
+      || VIsual_active
+      || dollar_vcol >= 0
+      || cmdwin_type != 0
+      || ns_hl_active != 0
+      || buf->b_signlist != NULL
+      || (buf->b_extmark_index != NULL && map_size(buf->b_extmark_index) > 0)
+      || win_fdccol_count(wp) > 0) {
+    return false;
+  }
+
+  linecache_key_T key;
+  memset(&key, 0, sizeof(key));
+  key.lck_buf = buf->handle;
+  key.lck_changedtick = buf_get_changedtick(buf);
+  key.lck_gen = line_cache_gen;
+  key.lck_width = wp->w_grid.Columns;
+  key.lck_columns = ui_has(kUIMultigrid) ? 0 : Columns;
+  key.lck_leftcol = wp->w_leftcol;
+  key.lck_nrwidth = wp->w_nrwidth;
+
+  if (wp->w_line_cache == NULL) {
+    wp->w_line_cache = xcalloc(LINE_CACHE_SIZE, sizeof(linecache_T));
+  } else if (memcmp(&key, &wp->w_line_cache_key, sizeof(key)) != 0) {
+    for (int i = 0; i < LINE_CACHE_SIZE; i++) {
+      wp->w_line_cache[i].lc_lnum = 0;
+    }
+  }
+  wp->w_line_cache_key = key;
+  return true;
+}
+
+/// Draw line "lnum" of window "wp" at screen row "row" from the cache of
+/// drawn lines.
+///
+/// @return  the row below the line, or -1 when the line is not cached.
+static int line_cache_draw(win_T *wp, linenr_T lnum, int row)
+{
+  linecache_T *lc = &wp->w_line_cache[lnum % LINE_CACHE_SIZE];
+  if (lc->lc_lnum != lnum || row + lc->lc_nrows > wp->w_grid.Rows) {
+    return -1;
+  }
+
+  for (int i = 0; i < lc->lc_nrows; i++) {
+    linecache_row_T *r = &lc->lc_rows[i];
+    memcpy(linebuf_char, lc->lc_chars + r->lcr_off,
+           (size_t)r->lcr_endcol * sizeof(schar_T));
+    memcpy(linebuf_attr, lc->lc_attrs + r->lcr_off,
+           (size_t)r->lcr_endcol * sizeof(sattr_T));
+    grid_put_linebuf(&wp->w_grid, row + i, 0, r->lcr_endcol,
+                     r->lcr_clear_width, false, wp, wp->w_hl_attr_normal,
+                     r->lcr_wrap);
+    if (r->lcr_wrap) {
+      grid_mark_line_wrap(&wp->w_grid, row + i);
+    }
+  }
+  return row + lc->lc_nrows;
+}
+
+/// Let win_line() add line "lnum" of window "wp" to the cache of drawn
+/// lines.  Must be followed by line_cache_end().
+static void line_cache_begin(win_T *wp, linenr_T lnum)
+{
+  linecache_T *lc = &wp->w_line_cache[lnum % LINE_CACHE_SIZE];
+  lc->lc_lnum = lnum;
+  lc->lc_nrows = 0;
+  lc->lc_ncells = 0;
+  line_cache_fill = lc;
+  line_cache_complete = false;
+}
+
+/// Finish adding a line to the cache, drawn by win_line() in "nrows" rows.
+/// The line is dropped when it was not drawn completely.
+static void line_cache_end(int nrows)
+{
+  if (line_cache_fill != NULL
+      && (!line_cache_complete || line_cache_fill->lc_nrows != nrows)) {
+    line_cache_fill->lc_lnum = 0;
+  }
+  line_cache_fill = NULL;
+}
+
+/// Add the row in linebuf_char[] and linebuf_attr[], that win_line() is
+/// about to put on "grid", to the cache entry being filled.
+static void line_cache_add_row(ScreenGrid *grid, int endcol, bool wrap)
+{
+  linecache_T *lc = line_cache_fill;
+  endcol = MIN(endcol, grid->Columns);
+
+  if (lc->lc_nrows == LINE_CACHE_MAX_ROWS) {
+    // Too long to keep.
+    lc->lc_lnum = 0;
+    line_cache_fill = NULL;
+    return;
+  }
+  if (lc->lc_nrows == lc->lc_rowsize) {
+    lc->lc_rowsize = LINE_CACHE_MAX_ROWS;
+    lc->lc_rows = xrealloc(lc->lc_rows,
+                           (size_t)lc->lc_rowsize * sizeof(*lc->lc_rows));
+  }
+  if (lc->lc_ncells + endcol > lc->lc_cellsize) {
+    lc->lc_cellsize = MAX(lc->lc_cellsize * 2, lc->lc_ncells + endcol);
+    lc->lc_chars = xrealloc(lc->lc_chars,
+                            (size_t)lc->lc_cellsize * sizeof(schar_T));
+    lc->lc_attrs = xrealloc(lc->lc_attrs,
+                            (size_t)lc->lc_cellsize * sizeof(sattr_T));
+  }
+
+  lc->lc_rows[lc->lc_nrows++] = (linecache_row_T){
+    .lcr_off = lc->lc_ncells,
+    .lcr_endcol = endcol,
+    .lcr_clear_width = grid->Columns,
+    .lcr_wrap = wrap,
+  };
+  memcpy(lc->lc_chars + lc->lc_ncells, linebuf_char,
+         (size_t)endcol * sizeof(schar_T));
+  memcpy(lc->lc_attrs + lc->lc_ncells, linebuf_attr,
+         (size_t)endcol * sizeof(sattr_T));
+  lc->lc_ncells += endcol;
+}
+
+/// Free the cache of drawn lines of window "wp".
+void line_cache_free(win_T *wp)
+{
+  if (wp->w_line_cache == NULL) {
+    return;
+  }
+  for (int i = 0; i < LINE_CACHE_SIZE; i++) {
+    linecache_T *lc = &wp->w_line_cache[i];
+    xfree(lc->lc_rows);
+    xfree(lc->lc_chars);
+    xfree(lc->lc_attrs);
+  }
+  XFREE_CLEAR(wp->w_line_cache);
+}
+
 /// Display line "lnum" of window 'wp' on the screen.
 /// wp->w_virtcol needs to be valid.
 ///
@@ -2170,8 +2429,10 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
       }
     }
 
+    proftime_T prof_decor_start = REDRAW_PROF_START();
     has_decor = decor_redraw_line(wp->w_buffer, lnum-1,
                                   &decor_state);
+    REDRAW_PROF_END(kRedrawPhaseDecor, prof_decor_start);
 
     for (size_t k = 0; k < kv_size(*providers); k++) {
       DecorProvider *p = kv_A(*providers, k);
@@ -3336,8 +3597,10 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
           save_did_emsg = did_emsg;
           did_emsg = FALSE;
 
+          proftime_T prof_syn_start = REDRAW_PROF_START();
           syntax_attr = get_syntax_attr((colnr_T)v - 1,
                                         has_spell ? &can_spell : NULL, false);
+          REDRAW_PROF_END(kRedrawPhaseSyntax, prof_syn_start);
 
           if (did_emsg) {
             wp->w_s->b_syn_error = TRUE;
@@ -3449,8 +3712,10 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
         if (has_decor && v > 0) {
           bool selected = (area_active || (area_highlighting && noinvcur
                                            && (colnr_T)vcol == wp->w_virtcol));
+          proftime_T prof_col_start = REDRAW_PROF_START();
           int extmark_attr = decor_redraw_col(wp->w_buffer, (colnr_T)v-1, off,
                                               selected, &decor_state);
+          REDRAW_PROF_END(kRedrawPhaseDecor, prof_col_start);
           if (extmark_attr != 0) {
             if (!attr_pri) {
               char_attr = hl_combine_attr(char_attr, extmark_attr);
@@ -3891,7 +4156,7 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
           col += n;
         } else {
           // Add a blank character to highlight.
-          schar_from_ascii(linebuf_char[off], ' ');
+          linebuf_char[off] = schar_from_ascii(' ');
         }
         if (area_attr == 0 && !has_fold) {
           // Use attributes from match with highest priority among
@@ -3958,8 +4223,10 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
                                              .hl_id = hl_err }));
         do_virttext = true;
       } else if (has_decor) {
+        proftime_T prof_eol_start = REDRAW_PROF_START();
         virt_text = decor_redraw_eol(wp->w_buffer, &decor_state, &line_attr,
                                      &has_aligned);
+        REDRAW_PROF_END(kRedrawPhaseDecor, prof_eol_start);
         if (kv_size(virt_text)) {
           do_virttext = true;
         }
@@ -4037,7 +4304,7 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
           delay_virttext = false;
 
           if (cells == -1) {
-            schar_from_ascii(linebuf_char[off], ' ');
+            linebuf_char[off] = schar_from_ascii(' ');
             cells = 1;
           }
           col += cells * col_stride;
@@ -4080,7 +4347,7 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
         // logical line
         int n = wp->w_p_rl ? -1 : 1;
         while (col >= 0 && col < grid->Columns) {
-          schar_from_ascii(linebuf_char[off], ' ');
+          linebuf_char[off] = schar_from_ascii(' ');
           linebuf_attr[off] = vcol >= TERM_ATTRS_MAX ? 0 : term_attrs[vcol];
           off += n;
           vcol += n;
@@ -4089,6 +4356,10 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
       }
 
       draw_virt_text(buf, win_col_offset, &col, grid->Columns);
+      if (line_cache_fill != NULL) {
+        line_cache_add_row(grid, col, false);
+        line_cache_complete = true;
+      }
       grid_put_linebuf(grid, row, 0, col, grid->Columns, wp->w_p_rl, wp,
                        wp->w_hl_attr_normal, false);
       row++;
@@ -4177,9 +4448,9 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
         col--;
       }
       if (mb_utf8) {
-        schar_from_cc(linebuf_char[off], mb_c, u8cc);
+        linebuf_char[off] = schar_from_cc(mb_c, u8cc);
       } else {
-        schar_from_ascii(linebuf_char[off], c);
+        linebuf_char[off] = schar_from_ascii((char)c);
       }
       if (multi_attr) {
         linebuf_attr[off] = multi_attr;
@@ -4193,7 +4464,7 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
         off++;
         col++;
         // UTF-8: Put a 0 in the second screen char.
-        linebuf_char[off][0] = 0;
+        linebuf_char[off] = 0;
         if (draw_state > WL_NR && filler_todo <= 0) {
           vcol++;
         }
@@ -4317,18 +4588,13 @@ static int win_line(win_T *wp, linenr_T lnum, int startrow, int endrow,
 
       int draw_col = col - boguscols;
       draw_virt_text(buf, win_col_offset, &draw_col, grid->Columns);
+      if (line_cache_fill != NULL) {
+        line_cache_add_row(grid, draw_col, wrap);
+      }
       grid_put_linebuf(grid, row, 0, draw_col, grid->Columns, wp->w_p_rl,
                        wp, wp->w_hl_attr_normal, wrap);
       if (wrap) {
-        ScreenGrid *current_grid = grid;
-        int current_row = row, dummy_col = 0;  // dummy_col unused
-        screen_adjust_grid(&current_grid, &current_row, &dummy_col);
-
-        // Force a redraw of the first column of the next line.
-        current_grid->attrs[current_grid->line_offset[current_row+1]] = -1;
-
-        // Remember that the line wraps, used for modeless copy.
-        current_grid->line_wraps[current_row] = true;
+        grid_mark_line_wrap(grid, row);
       }
 
       boguscols = 0;
@@ -4569,14 +4835,57 @@ static int grid_char_needs_redraw(ScreenGrid *grid, int off_from, int off_to,
                                   int cols)
 {
   return (cols > 0
-          && ((schar_cmp(linebuf_char[off_from], grid->chars[off_to])
+          && ((linebuf_char[off_from] != grid->chars[off_to]
                || linebuf_attr[off_from] != grid->attrs[off_to]
                || (line_off2cells(linebuf_char, off_from, off_from + cols) > 1
-                   && schar_cmp(linebuf_char[off_from + 1],
-                                grid->chars[off_to + 1])))
+                   && linebuf_char[off_from + 1] != grid->chars[off_to + 1]))
               || rdb_flags & RDB_NODELTA));
 }
 
+/// Return the number of cells at the start of linebuf_char[] and
+/// linebuf_attr[] from "off_from", that are equal to the cells of "grid" from
+/// "off_to".  At most "cols" cells are compared.  Does not stop between the
+/// two halves of a double-width char.
+static int grid_line_equal_prefix(ScreenGrid *grid, int off_from, int off_to,
+                                  int cols)
+{
+  // Skip equal blocks with memcmp(), which compares a block of cells much
+  // faster than a loop over them.
+#define CELL_BLOCK 32
+  int n = 0;
+  while (n + CELL_BLOCK <= cols
+         && memcmp(linebuf_char + off_from + n, grid->chars + off_to + n,
+                   CELL_BLOCK * sizeof(schar_T)) == 0
+         && memcmp(linebuf_attr + off_from + n, grid->attrs + off_to + n,
+                   CELL_BLOCK * sizeof(sattr_T)) == 0) {
+    n += CELL_BLOCK;
+  }
+#undef CELL_BLOCK
+  while (n < cols
+         && linebuf_char[off_from + n] == grid->chars[off_to + n]
+         && linebuf_attr[off_from + n] == grid->attrs[off_to + n]) {
+    n++;
+  }
+  if (n > 0 && n < cols && linebuf_char[off_from + n] == 0) {
+    n--;
+  }
+  return n;
+}
+
+/// Mark "row" of "grid" as continuing in the next row.
+static void grid_mark_line_wrap(ScreenGrid *grid, int row)
+{
+  ScreenGrid *current_grid = grid;
+  int current_row = row, dummy_col = 0;  // dummy_col unused
+  screen_adjust_grid(&current_grid, &current_row, &dummy_col);
+
+  // Force a redraw of the first column of the next line.
+  current_grid->attrs[current_grid->line_offset[current_row+1]] = -1;
+
+  // Remember that the line wraps, used for modeless copy.
+  current_grid->line_wraps[current_row] = true;
+}
+
 /// Move one buffered line to the window grid, but only the characters that
 /// have actually changed.  Handle insert/delete character.
 /// "coloff" gives the first column on the grid for this line.
@@ -4629,8 +4938,7 @@ static void grid_put_linebuf(ScreenGrid *grid, int row, int coloff, int endcol,
   if (rlflag) {
     /* Clear rest first, because it's left of the text. */
     if (clear_width > 0) {
-      while (col <= endcol && grid->chars[off_to][0] == ' '
-             && grid->chars[off_to][1] == NUL
+      while (col <= endcol && grid->chars[off_to] == schar_from_ascii(' ')
              && grid->attrs[off_to] == bg_attr
              ) {
         ++off_to;
@@ -4654,6 +4962,15 @@ static void grid_put_linebuf(ScreenGrid *grid, int row, int coloff, int endcol,
     }
   }
 
+  if (!(rdb_flags & RDB_NODELTA)) {
+    // Skip the cells at the start that did not change.
+    int skip = grid_line_equal_prefix(grid, (int)off_from, (int)off_to,
+                                      endcol - col);
+    col += skip;
+    off_from += (unsigned)skip;
+    off_to += (unsigned)skip;
+  }
+
   redraw_next = grid_char_needs_redraw(grid, off_from, off_to, endcol - col);
 
   while (col < endcol) {
@@ -4685,9 +5002,9 @@ static void grid_put_linebuf(ScreenGrid *grid, int row, int coloff, int endcol,
         clear_next = true;
       }
 
-      schar_copy(grid->chars[off_to], linebuf_char[off_from]);
+      grid->chars[off_to] = linebuf_char[off_from];
       if (char_cells == 2) {
-        schar_copy(grid->chars[off_to+1], linebuf_char[off_from+1]);
+        grid->chars[off_to+1] = linebuf_char[off_from+1];
       }
 
       grid->attrs[off_to] = linebuf_attr[off_from];
@@ -4706,7 +5023,7 @@ static void grid_put_linebuf(ScreenGrid *grid, int row, int coloff, int endcol,
   if (clear_next) {
     /* Clear the second half of a double-wide character of which the left
      * half was overwritten with a single-wide character. */
-    schar_from_ascii(grid->chars[off_to], ' ');
+    grid->chars[off_to] = schar_from_ascii(' ');
     end_dirty++;
   }
 
@@ -4715,11 +5032,9 @@ static void grid_put_linebuf(ScreenGrid *grid, int row, int coloff, int endcol,
     // blank out the rest of the line
     // TODO(bfredl): we could cache winline widths
     while (col < clear_width) {
-      if (grid->chars[off_to][0] != ' '
-          || grid->chars[off_to][1] != NUL
+      if (grid->chars[off_to] != schar_from_ascii(' ')
           || grid->attrs[off_to] != bg_attr) {
-        grid->chars[off_to][0] = ' ';
-        grid->chars[off_to][1] = NUL;
+        grid->chars[off_to] = schar_from_ascii(' ');
         grid->attrs[off_to] = bg_attr;
         if (start_dirty == -1) {
           start_dirty = col;
@@ -5506,7 +5821,7 @@ static void win_redr_border(win_T *wp)
       grid_puts_line_flush(false);
     }
     if (adj[1]) {
-      int ic = (i == 0 && !adj[0] && chars[2][0]) ? 2 : 3;
+      int ic = (i == 0 && !adj[0] && chars[2]) ? 2 : 3;
       grid_puts_line_start(grid, i+adj[0]);
       grid_put_schar(grid, i+adj[0], icol+adj[3], chars[ic], attrs[ic]);
       grid_puts_line_flush(false);
@@ -5519,7 +5834,7 @@ static void win_redr_border(win_T *wp)
       grid_put_schar(grid, irow+adj[0], 0, chars[6], attrs[6]);
     }
     for (int i = 0; i < icol; i++) {
-      int ic = (i == 0 && !adj[3] && chars[6][0]) ? 6 : 5;
+      int ic = (i == 0 && !adj[3] && chars[6]) ? 6 : 5;
       grid_put_schar(grid, irow+adj[0], i+adj[3], chars[ic], attrs[ic]);
     }
     grid_put_schar(grid, irow+adj[0], icol+adj[3], chars[4], attrs[4]);
@@ -5530,50 +5845,134 @@ static void win_redr_border(win_T *wp)
 // Low-level functions to manipulate invidual character cells on the
 // screen grid.
 
-/// Put a ASCII character in a screen cell.
-static void schar_from_ascii(char_u *p, const char c)
+/// Get the screen cell for the UTF-8 text "buf[len]", which must be less
+/// than MAX_SCHAR_SIZE bytes.  Text that does not fit in the cell is added to
+/// the glyph table.
+schar_T schar_from_buf(const char_u *buf, size_t len)
+  FUNC_ATTR_NONNULL_ALL
 {
-  p[0] = c;
-  p[1] = 0;
+  assert(len < MAX_SCHAR_SIZE);
+  if (len <= sizeof(schar_T)) {
+    char_u p[sizeof(schar_T)] = { 0 };
+    memcpy(p, buf, len);
+    schar_T sc;
+    memcpy(&sc, p, sizeof(sc));
+    return sc;
+  }
+
+  char text[MAX_SCHAR_SIZE];
+  memcpy(text, buf, len);
+  text[len] = NUL;
+  if (glyph_map == NULL) {
+    glyph_map = pmap_new(cstr_t)();
+  }
+  // The map holds the index plus one, zero means it was not found.
+  uint32_t idx = (uint32_t)(uintptr_t)pmap_get(cstr_t)(glyph_map, text);
+  if (idx == 0) {
+    if (glyph_count == GLYPH_MAX) {
+      // The table is full, only show the base character.
+      return schar_from_buf(buf, (size_t)utf_ptr2len((char_u *)text));
+    }
+    char **chunk = &glyph_chunks[glyph_count / GLYPH_CHUNK_SIZE];
+    if (*chunk == NULL) {
+      *chunk = xmalloc(GLYPH_CHUNK_SIZE * MAX_SCHAR_SIZE);
+    }
+    char *entry = *chunk + (glyph_count % GLYPH_CHUNK_SIZE) * MAX_SCHAR_SIZE;
+    memcpy(entry, text, len + 1);
+    idx = ++glyph_count;
+    pmap_put(cstr_t)(glyph_map, entry, (void *)(uintptr_t)idx);
+  }
+  idx--;
+  const uint8_t p[sizeof(schar_T)] = {
+    0xFF, (uint8_t)(idx >> 16), (uint8_t)(idx >> 8), (uint8_t)idx
+  };
+  schar_T sc;
+  memcpy(&sc, p, sizeof(sc));
+  return sc;
 }
 
-/// Put a unicode character in a screen cell.
-static int schar_from_char(char_u *p, int c)
+/// Get the screen cell for a unicode character.
+schar_T schar_from_char(int c)
 {
-  int len = utf_char2bytes(c, p);
-  p[len] = NUL;
-  return len;
+  char_u buf[MB_MAXBYTES];
+  return schar_from_buf(buf, (size_t)utf_char2bytes(c, buf));
 }
 
-/// Put a unicode char, and up to MAX_MCO composing chars, in a screen cell.
-static int schar_from_cc(char_u *p, int c, int u8cc[MAX_MCO])
+/// Get the screen cell for a unicode char, and up to MAX_MCO composing chars.
+schar_T schar_from_cc(int c, int u8cc[MAX_MCO])
 {
-  int len = utf_char2bytes(c, p);
+  char_u buf[MAX_SCHAR_SIZE];
+  int len = utf_char2bytes(c, buf);
   for (int i = 0; i < MAX_MCO; i++) {
     if (u8cc[i] == 0) {
       break;
     }
-    len += utf_char2bytes(u8cc[i], p + len);
+    len += utf_char2bytes(u8cc[i], buf + len);
   }
-  p[len] = 0;
+  return schar_from_buf(buf, (size_t)len);
+}
+
+/// Get the screen cell for the NUL-terminated text "str".
+schar_T schar_from_str(const char *str)
+  FUNC_ATTR_NONNULL_ALL
+{
+  size_t len = strlen(str);
+  return schar_from_buf((const char_u *)str, MIN(len, MAX_SCHAR_SIZE - 1));
+}
+
+/// Put the text of screen cell "sc" in "buf", which must be MAX_SCHAR_SIZE
+/// bytes.
+///
+/// Also called from the UI thread of the TUI, the glyph table can be read
+/// there as its entries are never changed once added.
+///
+/// @return  the length of the text, without the NUL.
+size_t schar_get(char *buf, schar_T sc)
+  FUNC_ATTR_NONNULL_ALL
+{
+  uint8_t p[sizeof(schar_T)];
+  memcpy(p, &sc, sizeof(sc));
+  if (schar_is_glyph(sc)) {
+    uint32_t idx = ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    const char *entry = glyph_chunks[idx / GLYPH_CHUNK_SIZE]
+                        + (idx % GLYPH_CHUNK_SIZE) * MAX_SCHAR_SIZE;
+    size_t len = strlen(entry);
+    memcpy(buf, entry, len + 1);
+    return len;
+  }
+  size_t len = 0;
+  while (len < sizeof(schar_T) && p[len] != NUL) {
+    len++;
+  }
+  memcpy(buf, p, len);
+  buf[len] = NUL;
   return len;
 }
 
-/// compare the contents of two screen cells.
-static int schar_cmp(char_u *sc1, char_u *sc2)
+/// Get the first character of screen cell "sc", zero when it is empty.
+int schar_get_first_codepoint(schar_T sc)
 {
-  return STRNCMP(sc1, sc2, sizeof(schar_T));
+  char text[MAX_SCHAR_SIZE];
+  schar_get(text, sc);
+  return utf_ptr2char((char_u *)text);
 }
 
-/// copy the contents of screen cell `sc2` into cell `sc1`
-static void schar_copy(char_u *sc1, char_u *sc2)
+/// Free the glyph table.  The grids must not be used after this.
+static void schar_free_all_mem(void)
 {
-  STRLCPY(sc1, sc2, sizeof(schar_T));
+  if (glyph_map != NULL) {
+    pmap_free(cstr_t)(glyph_map);
+    glyph_map = NULL;
+  }
+  for (size_t i = 0; i < ARRAY_SIZE(glyph_chunks); i++) {
+    XFREE_CLEAR(glyph_chunks[i]);
+  }
+  glyph_count = 0;
 }
 
 static int line_off2cells(schar_T *line, size_t off, size_t max_off)
 {
-  return (off + 1 < max_off && line[off + 1][0] == 0) ? 2 : 1;
+  return (off + 1 < max_off && line[off + 1] == 0) ? 2 : 1;
 }
 
 /// Return number of display cells for char at grid->chars[off].
@@ -5604,7 +6003,7 @@ int grid_fix_col(ScreenGrid *grid, int col, int row)
 
   col += coloff;
   if (grid->chars != NULL && col > 0
-      && grid->chars[grid->line_offset[row] + col][0] == 0) {
+      && grid->chars[grid->line_offset[row] + col] == 0) {
     return col - 1 - coloff;
   }
   return col - coloff;
@@ -5619,7 +6018,8 @@ void grid_putchar(ScreenGrid *grid, int c, int row, int col, int attr)
   grid_puts(grid, buf, row, col, attr);
 }
 
-/// get a single character directly from grid.chars into "bytes[]".
+/// get a single character directly from grid.chars into "bytes[]", which
+/// must be MAX_SCHAR_SIZE bytes.
 /// Also return its attribute in *attrp;
 void grid_getbytes(ScreenGrid *grid, int row, int col, char_u *bytes,
                    int *attrp)
@@ -5632,7 +6032,7 @@ void grid_getbytes(ScreenGrid *grid, int row, int col, char_u *bytes,
   if (grid->chars != NULL && row < grid->Rows && col < grid->Columns) {
     off = grid->line_offset[row] + col;
     *attrp = grid->attrs[off];
-    schar_copy(bytes, grid->chars[off]);
+    schar_get((char *)bytes, grid->chars[off]);
   }
 }
 
@@ -5664,12 +6064,13 @@ void grid_puts_line_start(ScreenGrid *grid, int row)
   put_dirty_grid = grid;
 }
 
-void grid_put_schar(ScreenGrid *grid, int row, int col, char_u *schar, int attr)
+void grid_put_schar(ScreenGrid *grid, int row, int col, schar_T schar,
+                    int attr)
 {
   assert(put_dirty_row == row);
   unsigned int off = grid->line_offset[row] + col;
-  if (grid->attrs[off] != attr || schar_cmp(grid->chars[off], schar)) {
-      schar_copy(grid->chars[off], schar);
+  if (grid->attrs[off] != attr || grid->chars[off] != schar) {
+      grid->chars[off] = schar;
       grid->attrs[off] = attr;
 
       put_dirty_first = MIN(put_dirty_first, col);
@@ -5768,12 +6169,10 @@ void grid_puts_len(ScreenGrid *grid, char_u *text, int textlen, int row,
       mbyte_cells = 1;
     }
 
-    schar_T buf;
-    schar_from_cc(buf, u8c, u8cc);
-
+    schar_T sc = schar_from_cc(u8c, u8cc);
 
-    need_redraw = schar_cmp(grid->chars[off], buf)
-                  || (mbyte_cells == 2 && grid->chars[off + 1][0] != 0)
+    need_redraw = grid->chars[off] != sc
+                  || (mbyte_cells == 2 && grid->chars[off + 1] != 0)
                   || grid->attrs[off] != attr
                   || exmode_active;
 
@@ -5795,10 +6194,10 @@ void grid_puts_len(ScreenGrid *grid, char_u *text, int textlen, int row,
         clear_next_cell = true;
       }
 
-      schar_copy(grid->chars[off], buf);
+      grid->chars[off] = sc;
       grid->attrs[off] = attr;
       if (mbyte_cells == 2) {
-        grid->chars[off + 1][0] = 0;
+        grid->chars[off + 1] = 0;
         grid->attrs[off + 1] = attr;
       }
       put_dirty_first = MIN(put_dirty_first, col);
@@ -6197,13 +6596,13 @@ void grid_fill(ScreenGrid *grid, int start_row, int end_row, int start_col,
     int dirty_last = 0;
 
     int col = start_col;
-    schar_from_char(sc, c1);
+    sc = schar_from_char(c1);
     int lineoff = grid->line_offset[row];
     for (col = start_col; col < end_col; col++) {
       int off = lineoff + col;
-      if (schar_cmp(grid->chars[off], sc)
+      if (grid->chars[off] != sc
           || grid->attrs[off] != attr) {
-        schar_copy(grid->chars[off], sc);
+        grid->chars[off] = sc;
         grid->attrs[off] = attr;
         if (dirty_first == INT_MAX) {
           dirty_first = col;
@@ -6211,7 +6610,7 @@ void grid_fill(ScreenGrid *grid, int start_row, int end_row, int start_col,
         dirty_last = col+1;
       }
       if (col == start_col) {
-        schar_from_char(sc, c2);
+        sc = schar_from_char(c2);
       }
     }
     if (dirty_last > dirty_first) {
@@ -6509,6 +6908,7 @@ void screen_free_all_mem(void)
   grid_free(&default_grid);
   xfree(linebuf_char);
   xfree(linebuf_attr);
+  schar_free_all_mem();
 }
 
 /// Clear tab_page_click_defs table
@@ -6584,7 +6984,7 @@ void screenclear(void)
 void grid_clear_line(ScreenGrid *grid, unsigned off, int width, bool valid)
 {
   for (int col = 0; col < width; col++) {
-    schar_from_ascii(grid->chars[off + col], ' ');
+    grid->chars[off + col] = schar_from_ascii(' ');
   }
   int fill = valid ? 0 : -1;
   (void)memset(grid->attrs + off, fill, (size_t)width * sizeof(sattr_T));
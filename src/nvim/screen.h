@@ -7,6 +7,7 @@
 #include "nvim/buffer_defs.h"
 #include "nvim/grid_defs.h"
 #include "nvim/pos.h"
+#include "nvim/state.h"
 
 /*
  * flags for update_screen()
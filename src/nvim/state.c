@@ -16,6 +16,7 @@
 #include "nvim/os/input.h"
 #include "nvim/ex_docmd.h"
 #include "nvim/edit.h"
+#include "nvim/screen.h"
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
 # include "state.c.generated.h"
@@ -50,8 +51,14 @@ getkey:
       ui_flush();
       // Call `os_inchar` directly to block for events or user input without
       // consuming anything from `input_buffer`(os/input.c) or calling the
-      // mapping engine.
-      (void)os_inchar(NULL, 0, -1, 0, main_loop.events);
+      // mapping engine.  When a redraw waits for the next frame, block only
+      // until it is due.
+      int wait_ms = redraw_wait_ms(s);
+      (void)os_inchar(NULL, 0, wait_ms, 0, main_loop.events);
+      if (wait_ms >= 0 && multiqueue_empty(main_loop.events)
+          && !input_available()) {
+        continue;  // check() again to draw the frame.
+      }
       // If an event was put into the queue, we send K_EVENT directly.
       key = !multiqueue_empty(main_loop.events)
             ? K_EVENT
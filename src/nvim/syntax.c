@@ -1015,6 +1015,7 @@ static void syn_stack_free_block(synblock_T *block)
 void syn_stack_free_all(synblock_T *block)
 {
   syn_stack_free_block(block);
+  line_cache_gen++;
 
   /* When using "syntax" fold method, must update all folds. */
   FOR_ALL_WINDOWS_IN_TAB(wp, curtab) {
@@ -7704,6 +7705,7 @@ void highlight_changed(void)
   int hlcnt;
 
   need_highlight_changed = FALSE;
+  line_cache_gen++;
 
   /// Translate builtin highlight groups into attributes for quick lookup.
   for (int hlf = 0; hlf < (int)HLF_COUNT; hlf++) {
@@ -84,6 +84,7 @@ typedef struct terminal_state {
   int save_rd;              // saved value of RedrawingDisabled
   bool close;
   bool got_bsl;             // if the last input was <C-\>
+  int key;                  // last key, K_EVENT for events
 } TerminalState;
 
 #ifdef INCLUDE_GENERATED_DECLARATIONS
@@ -423,13 +424,15 @@ static void terminal_check_cursor(void)
 //   0 if the main loop must exit
 static int terminal_check(VimState *state)
 {
+  TerminalState *s = (TerminalState *)state;
   if (stop_insert_mode) {
     return 0;
   }
 
   terminal_check_cursor();
 
-  if (must_redraw) {
+  // With 'maxfps' a redraw for terminal output may wait for the next frame.
+  if (must_redraw && !redraw_defer(state, s->key != K_EVENT)) {
     update_screen(0);
   }
 
@@ -445,6 +448,7 @@ static int terminal_check(VimState *state)
 static int terminal_execute(VimState *state, int key)
 {
   TerminalState *s = (TerminalState *)state;
+  s->key = key;
 
   switch (key) {
     case K_LEFTMOUSE:
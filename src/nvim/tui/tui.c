@@ -33,6 +33,8 @@
 #include "nvim/os/os.h"
 #include "nvim/os/signal.h"
 #include "nvim/os/tty.h"
+#include "nvim/profile.h"
+#include "nvim/screen.h"
 #ifdef WIN32
 # include "nvim/os/os_win_console.h"
 #endif
@@ -80,11 +82,14 @@ typedef struct {
   UIBridgeData *bridge;
   Loop *loop;
   unibi_var_t params[9];
-  char buf[OUTBUF_SIZE];
-  size_t bufpos;
+  char *buf;  ///< output of the current frame, grows as needed
+  size_t bufsize, bufpos;
   char norm[CNORM_COMMAND_MAX_SIZE];
   char invis[CNORM_COMMAND_MAX_SIZE];
   size_t normlen, invislen;
+  char sync_begin[CNORM_COMMAND_MAX_SIZE];
+  char sync_end[CNORM_COMMAND_MAX_SIZE];
+  size_t sync_beginlen, sync_endlen;
   TermInput input;
   uv_loop_t write_loop;
   unibi_term *ut;
@@ -109,7 +114,6 @@ typedef struct {
   bool bce;
   bool mouse_enabled;
   bool busy, is_invisible, want_invisible;
-  bool cork, overflow;
   bool cursor_color_changed;
   bool is_starting;
   FILE *screenshot;
@@ -136,6 +140,7 @@ typedef struct {
     int get_bg;
     int set_underline_style;
     int set_underline_color;
+    int sync;
   } unibi_ext;
   char *space_buf;
 } TUIData;
@@ -193,6 +198,20 @@ static size_t unibi_pre_fmt_str(TUIData *data, unsigned int unibi_index,
   return unibi_run(str, data->params, buf, len);
 }
 
+static size_t unibi_pre_fmt_ext_str(TUIData *data, int unibi_index,
+                                    int param, char *buf, size_t len)
+{
+  if (unibi_index < 0) {
+    return 0U;
+  }
+  const char *str = unibi_get_ext_str(data->ut, (unsigned)unibi_index);
+  if (!str) {
+    return 0U;
+  }
+  UNIBI_SET_NUM_VAR(data->params[0], param);
+  return unibi_run(str, data->params, buf, len);
+}
+
 static void termname_set_event(void **argv)
 {
   char *termname = argv[0];
@@ -210,8 +229,6 @@ static void terminfo_start(UI *ui)
   data->is_invisible = true;
   data->want_invisible = false;
   data->busy = false;
-  data->cork = false;
-  data->overflow = false;
   data->cursor_color_changed = false;
   data->showing_mode = SHAPE_IDX_N;
   data->unibi_ext.enable_mouse = -1;
@@ -231,6 +248,7 @@ static void terminfo_start(UI *ui)
   data->unibi_ext.reset_cursor_style = -1;
   data->unibi_ext.get_bg = -1;
   data->unibi_ext.set_underline_color = -1;
+  data->unibi_ext.sync = -1;
   data->out_fd = STDOUT_FILENO;
   data->out_isatty = os_isatty(data->out_fd);
 
@@ -299,6 +317,12 @@ static void terminfo_start(UI *ui)
                                     data->norm, sizeof data->norm);
   data->invislen = unibi_pre_fmt_str(data, unibi_cursor_invisible,
                                      data->invis, sizeof data->invis);
+  data->sync_beginlen = unibi_pre_fmt_ext_str(data, data->unibi_ext.sync, 1,
+                                              data->sync_begin,
+                                              sizeof data->sync_begin);
+  data->sync_endlen = unibi_pre_fmt_ext_str(data, data->unibi_ext.sync, 2,
+                                            data->sync_end,
+                                            sizeof data->sync_end);
   // Set 't_Co' from the result of unibilium & fix_terminfo.
   t_colors = unibi_get_num(data->ut, unibi_max_colors);
   // Ask the terminal to send us the background color.
@@ -429,6 +453,8 @@ static void tui_main(UIBridgeData *bridge, UI *ui)
   data->loop = &tui_loop;
   data->is_starting = true;
   data->screenshot = NULL;
+  data->bufsize = OUTBUF_SIZE;
+  data->buf = xmalloc(data->bufsize);
   kv_init(data->invalid_regions);
   signal_watcher_init(data->loop, &data->winch_handle, ui);
   signal_watcher_init(data->loop, &data->cont_handle, data);
@@ -472,6 +498,7 @@ static void tui_main(UIBridgeData *bridge, UI *ui)
   kv_destroy(data->invalid_regions);
   kv_destroy(data->attrs);
   xfree(data->space_buf);
+  xfree(data->buf);
   xfree(data);
 }
 
@@ -1393,15 +1420,34 @@ static void tui_raw_line(UI *ui, Integer g, Integer linerow, Integer startcol,
 {
   TUIData *data = ui->data;
   UGrid *grid = &data->grid;
+  // Only print the cells that differ from what the terminal already shows.
+  int first = (int)endcol, last = (int)startcol;
   for (Integer c = startcol; c < endcol; c++) {
-    memcpy(grid->cells[linerow][c].data, chunk[c-startcol], sizeof(schar_T));
+    UCell *cell = &grid->cells[linerow][c];
     assert((size_t)attrs[c-startcol] < kv_size(data->attrs));
-    grid->cells[linerow][c].attr = attrs[c-startcol];
+    char text[MAX_SCHAR_SIZE];
+    schar_get(text, chunk[c-startcol]);
+    if (cell->attr == attrs[c-startcol] && strequal(cell->data, text)) {
+      continue;
+    }
+    STRCPY(cell->data, text);
+    cell->attr = attrs[c-startcol];
+    first = MIN(first, (int)c);
+    last = (int)c + 1;
+  }
+  if (first < last) {
+    // Print double-width chars as a whole.
+    if (first > 0 && grid->cells[linerow][first].data[0] == NUL) {
+      first--;
+    }
+    if (last < grid->width && grid->cells[linerow][last].data[0] == NUL) {
+      last++;
+    }
+    UGRID_FOREACH_CELL(grid, (int)linerow, first, last, {
+      cursor_goto(ui, (int)linerow, curcol);
+      print_cell(ui, cell);
+    });
   }
-  UGRID_FOREACH_CELL(grid, (int)linerow, (int)startcol, (int)endcol, {
-    cursor_goto(ui, (int)linerow, curcol);
-    print_cell(ui, cell);
-  });
 
   if (clearcol > endcol) {
     ugrid_clear_chunk(grid, (int)linerow, (int)endcol, (int)clearcol,
@@ -1415,7 +1461,7 @@ static void tui_raw_line(UI *ui, Integer g, Integer linerow, Integer startcol,
     // Only do line wrapping if the grid width is equal to the terminal
     // width and the line continuation is within the grid.
 
-    if (endcol != grid->width) {
+    if (first >= last || last != grid->width) {
       // Print the last char of the row, if we haven't already done so.
       int size = grid->cells[linerow][grid->width - 1].data[0] == NUL ? 2 : 1;
       cursor_goto(ui, (int)linerow, grid->width - size);
@@ -1521,18 +1567,9 @@ static void unibi_goto(UI *ui, int row, int col)
     } \
     if (str) { \
       unibi_var_t vars[26 + 26]; \
-      size_t orig_pos = data->bufpos; \
       \
       memset(&vars, 0, sizeof(vars)); \
-      data->cork = true; \
-retry: \
       unibi_format(vars, vars + 26, str, data->params, out, ui, NULL, NULL); \
-      if (data->overflow) { \
-        data->bufpos = orig_pos; \
-        flush_buf(ui); \
-        goto retry; \
-      } \
-      data->cork = false; \
     } \
   } while (0)
 static void unibi_out(UI *ui, int unibi_index)
@@ -1549,19 +1586,14 @@ static void out(void *ctx, const char *str, size_t len)
 {
   UI *ui = ctx;
   TUIData *data = ui->data;
-  size_t available = sizeof(data->buf) - data->bufpos;
-
-  if (data->cork && data->overflow) {
-    return;
-  }
 
-  if (len > available) {
-    if (data->cork) {
-      data->overflow = true;
-      return;
-    } else {
-      flush_buf(ui);
+  // Grow the buffer instead of flushing, so that a frame is sent to the
+  // terminal with a single write.
+  if (len > data->bufsize - data->bufpos) {
+    while (len > data->bufsize - data->bufpos) {
+      data->bufsize *= 2;
     }
+    data->buf = xrealloc(data->buf, data->bufsize);
   }
 
   memcpy(data->buf + data->bufpos, str, len);
@@ -1924,6 +1956,12 @@ static void augment_terminfo(TUIData *data, const char *term,
     || terminfo_is_term_family(term, "iTerm.app")
     || terminfo_is_term_family(term, "iTerm2.app");
   bool alacritty = terminfo_is_term_family(term, "alacritty");
+  bool kitty = terminfo_is_term_family(term, "xterm-kitty")
+    || !!os_getenv("KITTY_WINDOW_ID");
+  bool foot = terminfo_is_term_family(term, "foot");
+  const char *term_program = os_getenv("TERM_PROGRAM");
+  bool wezterm = term_program && strequal(term_program, "WezTerm");
+  bool contour = terminfo_is_term_family(term, "contour");
   // None of the following work over SSH; see :help TERM .
   bool iterm_pretending_xterm = xterm && iterm_env;
 
@@ -2052,12 +2090,21 @@ static void augment_terminfo(TUIData *data, const char *term,
       data->unibi_ext.set_underline_color = (int)unibi_add_ext_str(
           ut, "ext.set_underline_color", "\x1b[58:2::%p1%d:%p2%d:%p3%dm");
   }
+
+  // Synchronized output (DECSET 2026).  tmux uses the "Sync" capability for
+  // this, otherwise only define it for terminals known to support it.
+  data->unibi_ext.sync = unibi_find_ext_str(ut, "Sync");
+  if (data->unibi_ext.sync == -1
+      && (kitty || foot || wezterm || contour)) {
+    data->unibi_ext.sync = (int)unibi_add_ext_str(
+        ut, "ext.sync", "\x1b[?2026%?%p1%{1}%-%tl%eh%;");
+  }
 }
 
 static void flush_buf(UI *ui)
 {
   uv_write_t req;
-  uv_buf_t bufs[3];
+  uv_buf_t bufs[5];
   uv_buf_t *bufp = &bufs[0];
   TUIData *data = ui->data;
 
@@ -2090,12 +2137,27 @@ static void flush_buf(UI *ui)
     data->is_invisible = true;
   }
 
+  // Wrap the frame in a synchronized update, so that the terminal does not
+  // show it half-drawn.
+  bool sync = data->bufpos > 0 && data->sync_beginlen > 0 && !data->screenshot;
+  if (sync) {
+    bufp->base = data->sync_begin;
+    bufp->len = UV_BUF_LEN(data->sync_beginlen);
+    bufp++;
+  }
+
   if (data->bufpos > 0) {
     bufp->base = data->buf;
     bufp->len = UV_BUF_LEN(data->bufpos);
     bufp++;
   }
 
+  if (sync) {
+    bufp->base = data->sync_end;
+    bufp->len = UV_BUF_LEN(data->sync_endlen);
+    bufp++;
+  }
+
   if (!data->busy) {
     assert(data->is_invisible);
     // not busy and the cursor is invisible. Write a "cursor normal" command
@@ -2116,9 +2178,20 @@ static void flush_buf(UI *ui)
     uv_write(&req, STRUCT_CAST(uv_stream_t, &data->output_handle),
              bufs, (unsigned)(bufp - bufs), NULL);
     uv_run(&data->write_loop, UV_RUN_DEFAULT);
+    if (redraw_prof_enabled) {
+      size_t written = 0;
+      for (size_t i = 0; i < (size_t)(bufp - bufs); i++) {
+        written += bufs[i].len;
+      }
+      redraw_prof_count(kRedrawCountBytes, (int64_t)written);
+    }
   }
   data->bufpos = 0;
-  data->overflow = false;
+  if (data->bufsize > OUTBUF_SIZE * 16) {
+    // Do not keep the memory of a huge frame around.
+    data->bufsize = OUTBUF_SIZE;
+    data->buf = xrealloc(data->buf, data->bufsize);
+  }
 }
 
 #if TERMKEY_VERSION_MAJOR > 0 || TERMKEY_VERSION_MINOR > 18
@@ -7,7 +7,7 @@
 typedef struct ucell UCell;
 typedef struct ugrid UGrid;
 
-#define CELLBYTES (sizeof(schar_T))
+#define CELLBYTES (MAX_SCHAR_SIZE - 1)
 
 struct ucell {
   char data[CELLBYTES + 1];
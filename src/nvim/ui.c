@@ -32,6 +32,7 @@
 #include "nvim/os/input.h"
 #include "nvim/os/signal.h"
 #include "nvim/popupmnu.h"
+#include "nvim/profile.h"
 #include "nvim/screen.h"
 #include "nvim/highlight.h"
 #include "nvim/ui_compositor.h"
@@ -386,6 +387,7 @@ void ui_line(ScreenGrid *grid, int row, int startcol, int endcol, int clearcol,
   ui_call_raw_line(grid->handle, row, startcol, endcol, clearcol, clearattr,
                    flags, (const schar_T *)grid->chars + off,
                    (const sattr_T *)grid->attrs + off);
+  REDRAW_PROF_COUNT(kRedrawCountCells, clearcol - startcol);
 
   // 'writedelay': flush & delay each time.
   if (p_wd && !(rdb_flags & RDB_COMPOSITOR)) {
@@ -443,6 +445,7 @@ int ui_current_col(void)
 
 void ui_flush(void)
 {
+  proftime_T prof_start = REDRAW_PROF_START();
   cmdline_ui_flush();
   win_ui_flush();
   msg_ext_ui_flush();
@@ -469,6 +472,8 @@ void ui_flush(void)
     pending_has_mouse = has_mouse;
   }
   ui_call_flush();
+  REDRAW_PROF_END(kRedrawPhaseFlush, prof_start);
+  redraw_prof_frame_end();
 }
 
 
@@ -6,7 +6,9 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
 
 #include "nvim/log.h"
@@ -24,10 +26,40 @@
 
 #define UI(b) (((UIBridgeData *)b)->ui)
 
-// Schedule a function call on the UI bridge thread.
+// Schedule a function call on the UI bridge thread, after the lines written
+// to the ring.
 #define UI_BRIDGE_CALL(ui, name, argc, ...) \
-  ((UIBridgeData *)ui)->scheduler( \
-      event_create(ui_bridge_##name##_event, argc, __VA_ARGS__), UI(ui))
+  do { \
+    ui_bridge_sync((UIBridgeData *)ui); \
+    ((UIBridgeData *)ui)->scheduler( \
+        event_create(ui_bridge_##name##_event, argc, __VA_ARGS__), UI(ui)); \
+  } while (0)
+
+// Access to the ring positions shared by the main thread and the UI thread.
+#if defined(__GNUC__) || defined(__clang__)
+# define RING_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define RING_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#elif defined(_M_IX86) || defined(_M_X64)
+// With the default /volatile:ms, MSVC gives volatile accesses acquire and
+// release semantics on x86 and x64.
+# define RING_LOAD(p) (*(volatile size_t *)(p))
+# define RING_STORE(p, v) (*(volatile size_t *)(p) = (v))
+#else
+// Other MSVC targets, like ARM64, default to /volatile:iso: use interlocked
+// operations, they are full barriers.
+# include <intrin.h>
+# ifdef _WIN64
+#  define RING_LOAD(p) \
+  ((size_t)_InterlockedCompareExchange64((volatile __int64 *)(p), 0, 0))
+#  define RING_STORE(p, v) \
+  ((void)_InterlockedExchange64((volatile __int64 *)(p), (__int64)(v)))
+# else
+#  define RING_LOAD(p) \
+  ((size_t)_InterlockedCompareExchange((volatile long *)(p), 0, 0))
+#  define RING_STORE(p, v) \
+  ((void)_InterlockedExchange((volatile long *)(p), (long)(v)))
+# endif
+#endif
 
 #define INT2PTR(i) ((void *)(intptr_t)i)
 #define PTR2INT(p) ((Integer)(intptr_t)p)
@@ -66,6 +98,9 @@ UI *ui_bridge_attach(UI *ui, ui_main_fn ui_main, event_scheduler scheduler)
   rv->bridge.raw_line = ui_bridge_raw_line;
   rv->bridge.inspect = ui_bridge_inspect;
   rv->scheduler = scheduler;
+  rv->ring = xmalloc(UI_BRIDGE_RING_SIZE * sizeof(*rv->ring));
+  rv->arena_chars = xmalloc(UI_BRIDGE_ARENA_SIZE * sizeof(schar_T));
+  rv->arena_attrs = xmalloc(UI_BRIDGE_ARENA_SIZE * sizeof(sattr_T));
 
   for (UIExtension i = 0; (int)i < kUIExtCount; i++) {
     rv->bridge.ui_ext[i] = ui->ui_ext[i];
@@ -128,6 +163,9 @@ static void ui_bridge_stop(UI *b)
   uv_mutex_destroy(&bridge->mutex);
   uv_cond_destroy(&bridge->cond);
   xfree(bridge->ui);  // Threads joined, now safe to free UI container. #7922
+  xfree(bridge->ring);
+  xfree(bridge->arena_chars);
+  xfree(bridge->arena_attrs);
   xfree(b);
 }
 static void ui_bridge_stop_event(void **argv)
@@ -167,7 +205,34 @@ static void ui_bridge_raw_line(UI *ui, Integer grid, Integer row,
                                LineFlags flags, const schar_T *chunk,
                                const sattr_T *attrs)
 {
+  UIBridgeData *bridge = (UIBridgeData *)ui;
   size_t ncol = (size_t)(endcol-startcol);
+
+  // The cells must be contiguous, skip the end of the arena when they don't
+  // fit there.
+  size_t pos = bridge->arena_head;
+  size_t idx = pos % UI_BRIDGE_ARENA_SIZE;
+  if (idx + ncol > UI_BRIDGE_ARENA_SIZE) {
+    pos += UI_BRIDGE_ARENA_SIZE - idx;
+    idx = 0;
+  }
+  if (bridge->ring_write - RING_LOAD(&bridge->ring_read) < UI_BRIDGE_RING_SIZE
+      && pos + ncol - RING_LOAD(&bridge->arena_tail) <= UI_BRIDGE_ARENA_SIZE) {
+    memcpy(&bridge->arena_chars[idx], chunk, ncol * sizeof(schar_T));
+    memcpy(&bridge->arena_attrs[idx], attrs, ncol * sizeof(sattr_T));
+    UIBridgeLine *line = &bridge->ring[bridge->ring_write
+                                       % UI_BRIDGE_RING_SIZE];
+    *line = (UIBridgeLine) {
+      .grid = grid, .row = row, .startcol = startcol, .endcol = endcol,
+      .clearcol = clearcol, .clearattr = clearattr, .flags = flags,
+      .cells = idx, .arena_end = pos + ncol,
+    };
+    bridge->arena_head = pos + ncol;
+    bridge->ring_write++;
+    return;
+  }
+
+  // The UI thread is behind, schedule an event with a copy of the cells.
   schar_T *c = xmemdup(chunk, ncol * sizeof(schar_T));
   sattr_T *hl = xmemdup(attrs, ncol * sizeof(sattr_T));
   UI_BRIDGE_CALL(ui, raw_line, 10, ui, INT2PTR(grid), INT2PTR(row),
@@ -175,6 +240,35 @@ static void ui_bridge_raw_line(UI *ui, Integer grid, Integer row,
                  INT2PTR(clearattr), INT2PTR(flags), c, hl);
 }
 
+/// Schedule drawing the lines written to the ring since the last call.
+static void ui_bridge_sync(UIBridgeData *bridge)
+{
+  if (bridge->ring_write != bridge->ring_synced) {
+    bridge->ring_synced = bridge->ring_write;
+    bridge->scheduler(event_create(ui_bridge_ring_event, 2, bridge,
+                                   (void *)(uintptr_t)bridge->ring_write),
+                      bridge->ui);
+  }
+}
+
+/// Draw the lines in the ring up to the position in argv[1].  Runs in the UI
+/// thread.
+static void ui_bridge_ring_event(void **argv)
+{
+  UIBridgeData *bridge = argv[0];
+  size_t end = (size_t)(uintptr_t)argv[1];
+  UI *ui = bridge->ui;
+  for (size_t pos = bridge->ring_read; pos != end; pos++) {
+    UIBridgeLine *line = &bridge->ring[pos % UI_BRIDGE_RING_SIZE];
+    ui->raw_line(ui, line->grid, line->row, line->startcol, line->endcol,
+                 line->clearcol, line->clearattr, line->flags,
+                 &bridge->arena_chars[line->cells],
+                 &bridge->arena_attrs[line->cells]);
+    RING_STORE(&bridge->arena_tail, line->arena_end);
+    RING_STORE(&bridge->ring_read, pos + 1);
+  }
+}
+
 static void ui_bridge_suspend(UI *b)
 {
   UIBridgeData *data = (UIBridgeData *)b;
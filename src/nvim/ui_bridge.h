@@ -8,6 +8,18 @@
 #include "nvim/ui.h"
 #include "nvim/event/defs.h"
 
+// Number of raw_line calls and cells that fit in the ring of a bridge.
+#define UI_BRIDGE_RING_SIZE 1024
+#define UI_BRIDGE_ARENA_SIZE (64 * 1024)
+
+// A raw_line call waiting in the ring, its cells are in the arena.
+typedef struct {
+  Integer grid, row, startcol, endcol, clearcol, clearattr;
+  LineFlags flags;
+  size_t cells;      // index of the first cell in the arena
+  size_t arena_end;  // arena position after the cells
+} UIBridgeLine;
+
 typedef struct ui_bridge_data UIBridgeData;
 typedef void(*ui_main_fn)(UIBridgeData *bridge, UI *ui);
 struct ui_bridge_data {
@@ -27,6 +39,22 @@ struct ui_bridge_data {
   // thread finishes handling all events. This flag is set by the UI thread as a
   // signal that it will no longer send messages to the main thread.
   bool stopped;
+
+  // raw_line calls are not scheduled as events: the main thread writes them
+  // to this single-producer, single-consumer ring and copies the cells to
+  // the arena, without allocating or locking.  Before the next event is
+  // scheduled, an event telling the UI thread how far to read the ring is
+  // scheduled, thus the order of calls is kept.  When the ring is full the
+  // call is scheduled as an event like the others.
+  // The positions only increase, the index is the position modulo the size.
+  UIBridgeLine *ring;
+  schar_T *arena_chars;
+  sattr_T *arena_attrs;
+  size_t ring_write;    // main thread: next position to write
+  size_t ring_synced;   // main thread: ring_write when last scheduled
+  size_t arena_head;    // main thread: next arena position to use
+  size_t ring_read;     // set by the UI thread: next position to read
+  size_t arena_tail;    // set by the UI thread: arena position in use
 };
 
 #define CONTINUE(b) \
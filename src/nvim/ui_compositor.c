@@ -21,6 +21,7 @@
 #include "nvim/memory.h"
 #include "nvim/message.h"
 #include "nvim/popupmnu.h"
+#include "nvim/profile.h"
 #include "nvim/ui_compositor.h"
 #include "nvim/ugrid.h"
 #include "nvim/screen.h"
@@ -41,6 +42,14 @@ static size_t bufsize = 0;
 static schar_T *linebuf;
 static sattr_T *attrbuf;
 
+// The composed screen as last sent to the UIs.  compose_line() only sends the
+// cells that differ from it, thus recomposing an area after a float moved or
+// was redrawn only sends the cells that actually changed.  A cell with
+// attribute -1 is unknown and is always sent.
+static schar_T *shadow_chars;
+static sattr_T *shadow_attrs;
+static int shadow_width = 0, shadow_height = 0;
+
 #ifndef NDEBUG
 static int chk_width = 0, chk_height = 0;
 #endif
@@ -52,7 +61,7 @@ static int msg_current_row = INT_MAX;
 static bool msg_was_scrolled = false;
 
 static int msg_sep_row = -1;
-static schar_T msg_sep_char = { ' ', NUL };
+static schar_T msg_sep_char = 0;  // set by ui_comp_init()
 
 static int dbghl_normal, dbghl_clear, dbghl_composed, dbghl_recompose;
 
@@ -62,9 +71,11 @@ void ui_comp_init(void)
     return;
   }
   compositor = xcalloc(1, sizeof(UI));
+  msg_sep_char = schar_from_ascii(' ');
 
   compositor->rgb = true;
   compositor->grid_resize = ui_comp_grid_resize;
+  compositor->grid_clear = ui_comp_grid_clear;
   compositor->grid_scroll = ui_comp_grid_scroll;
   compositor->grid_cursor_goto = ui_comp_grid_cursor_goto;
   compositor->raw_line = ui_comp_raw_line;
@@ -108,6 +119,9 @@ void ui_comp_detach(UI *ui)
     XFREE_CLEAR(linebuf);
     XFREE_CLEAR(attrbuf);
     bufsize = 0;
+    XFREE_CLEAR(shadow_chars);
+    XFREE_CLEAR(shadow_attrs);
+    shadow_width = shadow_height = 0;
   }
   ui->composed = false;
 }
@@ -307,6 +321,7 @@ ScreenGrid *ui_comp_mouse_focus(int row, int col)
 static void compose_line(Integer row, Integer startcol, Integer endcol,
                          LineFlags flags)
 {
+  proftime_T prof_start = REDRAW_PROF_START();
   // If rightleft is set, startcol may be -1. In such cases, the assertions
   // will fail because no overlap is found. Adjust startcol to prevent it.
   startcol = MAX(startcol, 0);
@@ -365,7 +380,7 @@ static void compose_line(Integer row, Integer startcol, Integer endcol,
       grid = &msg_grid;
       sattr_T msg_sep_attr = (sattr_T)HL_ATTR(HLF_MSGSEP);
       for (int i = col; i < until; i++) {
-        memcpy(linebuf[i-startcol], msg_sep_char, sizeof(*linebuf));
+        linebuf[i-startcol] = msg_sep_char;
         attrbuf[i-startcol] = msg_sep_attr;
       }
     } else {
@@ -374,9 +389,8 @@ static void compose_line(Integer row, Integer startcol, Integer endcol,
       memcpy(linebuf+(col-startcol), grid->chars+off, n * sizeof(*linebuf));
       memcpy(attrbuf+(col-startcol), grid->attrs+off, n * sizeof(*attrbuf));
       if (grid->comp_col+grid->Columns > until
-          && grid->chars[off+n][0] == NUL) {
-        linebuf[until-1-startcol][0] = ' ';
-        linebuf[until-1-startcol][1] = '\0';
+          && grid->chars[off+n] == 0) {
+        linebuf[until-1-startcol] = schar_from_ascii(' ');
         if (col == startcol && n == 1) {
           skipstart = 0;
         }
@@ -389,10 +403,10 @@ static void compose_line(Integer row, Integer startcol, Integer endcol,
       for (int i = col-(int)startcol; i < until-startcol; i += width) {
         width = 1;
         // negative space
-        bool thru = strequal((char *)linebuf[i], " ") && bg_line[i][0] != NUL;
-        if (i+1 < endcol-startcol && bg_line[i+1][0] == NUL) {
+        bool thru = linebuf[i] == schar_from_ascii(' ') && bg_line[i] != 0;
+        if (i+1 < endcol-startcol && bg_line[i+1] == 0) {
           width = 2;
-          thru &= strequal((char *)linebuf[i+1], " ");
+          thru &= linebuf[i+1] == schar_from_ascii(' ');
         }
         attrbuf[i] = (sattr_T)hl_blend_attrs(bg_attrs[i], attrbuf[i], &thru);
         if (width == 2) {
@@ -407,19 +421,18 @@ static void compose_line(Integer row, Integer startcol, Integer endcol,
 
     // Tricky: if overlap caused a doublewidth char to get cut-off, must
     // replace the visible half with a space.
-    if (linebuf[col-startcol][0] == NUL) {
-      linebuf[col-startcol][0] = ' ';
-      linebuf[col-startcol][1] = NUL;
+    if (linebuf[col-startcol] == 0) {
+      linebuf[col-startcol] = schar_from_ascii(' ');
       if (col == endcol-1) {
         skipend = 0;
       }
-    } else if (n > 1 && linebuf[col-startcol+1][0] == NUL) {
+    } else if (n > 1 && linebuf[col-startcol+1] == 0) {
       skipstart = 0;
     }
 
     col = until;
   }
-  if (linebuf[endcol-startcol-1][0] == NUL) {
+  if (linebuf[endcol-startcol-1] == 0) {
     skipend = 0;
   }
 
@@ -441,10 +454,103 @@ static void compose_line(Integer row, Integer startcol, Integer endcol,
       }
     }
   }
-  ui_composed_call_raw_line(1, row, startcol+skipstart,
-                            endcol-skipend, endcol-skipend, 0, flags,
-                            (const schar_T *)linebuf+skipstart,
-                            (const sattr_T *)attrbuf+skipstart);
+
+  // Skip the cells at both ends that the UIs already show.
+  int first = (int)startcol + skipstart;
+  int last = (int)endcol - skipend;
+  if (row < shadow_height && last <= shadow_width) {
+    size_t off = (size_t)row * (size_t)shadow_width;
+    while (first < last
+           && linebuf[first-startcol] == shadow_chars[off+(size_t)first]
+           && attrbuf[first-startcol] == shadow_attrs[off+(size_t)first]) {
+      first++;
+    }
+    while (last > first
+           && linebuf[last-1-startcol] == shadow_chars[off+(size_t)last-1]
+           && attrbuf[last-1-startcol] == shadow_attrs[off+(size_t)last-1]) {
+      last--;
+    }
+    // Do not split a double-width char.
+    if (first > startcol + skipstart && linebuf[first-startcol] == 0) {
+      first--;
+    }
+    if (last < endcol - skipend && linebuf[last-startcol] == 0) {
+      last++;
+    }
+    if (first == last && !(flags & kLineFlagWrap)) {
+      REDRAW_PROF_END(kRedrawPhaseCompose, prof_start);
+      return;
+    }
+    shadow_put(row, first, last, linebuf+(first-startcol),
+               attrbuf+(first-startcol));
+  }
+
+  ui_composed_call_raw_line(1, row, first, last, last, 0, flags,
+                            (const schar_T *)linebuf+(first-startcol),
+                            (const sattr_T *)attrbuf+(first-startcol));
+  REDRAW_PROF_END(kRedrawPhaseCompose, prof_start);
+}
+
+/// Remember that the cells from "startcol" to "endcol" in "row" of the
+/// composed screen were sent to the UIs.
+static void shadow_put(Integer row, Integer startcol, Integer endcol,
+                       const schar_T *chunk, const sattr_T *attrs)
+{
+  if (row >= shadow_height || startcol >= shadow_width) {
+    return;
+  }
+  endcol = MIN(endcol, shadow_width);
+  size_t off = (size_t)row * (size_t)shadow_width + (size_t)startcol;
+  size_t n = (size_t)(endcol-startcol);
+  memcpy(shadow_chars+off, chunk, n * sizeof(*shadow_chars));
+  memcpy(shadow_attrs+off, attrs, n * sizeof(*shadow_attrs));
+}
+
+/// Set the cells from "startcol" to "endcol" in the rows from "startrow" to
+/// "endrow" of the composed screen to spaces with "attr", or mark them as
+/// unknown when "attr" is -1.
+static void shadow_fill(Integer startrow, Integer endrow, Integer startcol,
+                        Integer endcol, int attr)
+{
+  endrow = MIN(endrow, shadow_height);
+  endcol = MIN(endcol, shadow_width);
+  for (Integer row = MAX(startrow, 0); row < endrow; row++) {
+    size_t off = (size_t)row * (size_t)shadow_width;
+    for (Integer col = MAX(startcol, 0); col < endcol; col++) {
+      shadow_chars[off+(size_t)col] = schar_from_ascii(' ');
+      shadow_attrs[off+(size_t)col] = attr;
+    }
+  }
+}
+
+/// Scroll the composed screen like the grid_scroll event does.  The cells
+/// that are scrolled in are unknown.
+static void shadow_scroll(Integer top, Integer bot, Integer left,
+                          Integer right, Integer rows)
+{
+  bot = MIN(bot, shadow_height);
+  right = MIN(right, shadow_width);
+  if (top >= bot || left >= right) {
+    return;
+  }
+  size_t n = (size_t)(right-left);
+  if (rows > 0) {
+    for (Integer row = top; row < bot - rows; row++) {
+      size_t to = (size_t)row * (size_t)shadow_width + (size_t)left;
+      size_t from = to + (size_t)rows * (size_t)shadow_width;
+      memmove(shadow_chars+to, shadow_chars+from, n * sizeof(*shadow_chars));
+      memmove(shadow_attrs+to, shadow_attrs+from, n * sizeof(*shadow_attrs));
+    }
+    shadow_fill(MAX(bot - rows, top), bot, left, right, -1);
+  } else if (rows < 0) {
+    for (Integer row = bot - 1; row >= top - rows; row--) {
+      size_t to = (size_t)row * (size_t)shadow_width + (size_t)left;
+      size_t from = to - (size_t)(-rows) * (size_t)shadow_width;
+      memmove(shadow_chars+to, shadow_chars+from, n * sizeof(*shadow_chars));
+      memmove(shadow_attrs+to, shadow_attrs+from, n * sizeof(*shadow_attrs));
+    }
+    shadow_fill(top, MIN(top - rows, bot), left, right, -1);
+  }
 }
 
 static void compose_debug(Integer startrow, Integer endrow, Integer startcol,
@@ -463,6 +569,8 @@ static void compose_debug(Integer startrow, Integer endrow, Integer startcol,
                               (const schar_T *)linebuf,
                               (const sattr_T *)attrbuf);
   }
+  // Make sure the cells are drawn again over the debug highlight.
+  shadow_fill(startrow, endrow, startcol, endcol, -1);
 
 
   if (delay) {
@@ -556,6 +664,8 @@ static void ui_comp_raw_line(UI *ui, Integer grid, Integer row,
       assert(attrs[i] >= 0);
     }
 #endif
+    shadow_put(row, startcol, endcol, chunk, attrs);
+    shadow_fill(row, row+1, endcol, clearcol, (int)clearattr);
     ui_composed_call_raw_line(1, row, startcol, endcol, clearcol, clearattr,
                               flags, chunk, attrs);
   }
@@ -579,7 +689,7 @@ static void ui_comp_msg_set_pos(UI *ui, Integer grid, Integer row,
   if (scrolled && row > 0) {
     msg_sep_row = (int)row-1;
     if (sep_char.data) {
-      STRLCPY(msg_sep_char, sep_char.data, sizeof(msg_sep_char));
+      msg_sep_char = schar_from_str(sep_char.data);
     }
   } else {
     msg_sep_row = -1;
@@ -596,6 +706,7 @@ static void ui_comp_msg_set_pos(UI *ui, Integer grid, Integer row,
     } else {
       // scroll separator togheter with message text
       int first_row = MAX((int)row-(msg_was_scrolled?1:0), 0);
+      shadow_scroll(first_row, Rows, 0, Columns, delta);
       ui_composed_call_grid_scroll(1, first_row, Rows, 0, Columns, delta, 0);
       if (scrolled && !msg_was_scrolled && row > 0) {
         compose_area(row-1, row, 0, Columns);
@@ -646,6 +757,7 @@ static void ui_comp_grid_scroll(UI *ui, Integer grid, Integer top,
       }
     }
   } else {
+    shadow_scroll(top, bot, left, right, rows);
     ui_composed_call_grid_scroll(1, top, bot, left, right, rows, cols);
     if (rdb_flags & RDB_COMPOSITOR) {
       debug_delay(2);
@@ -670,6 +782,24 @@ static void ui_comp_grid_resize(UI *ui, Integer grid,
       attrbuf = xmalloc(new_bufsize * sizeof(*attrbuf));
       bufsize = new_bufsize;
     }
+    size_t ncells = (size_t)width * (size_t)height;
+    if ((size_t)shadow_width * (size_t)shadow_height != ncells) {
+      xfree(shadow_chars);
+      xfree(shadow_attrs);
+      shadow_chars = xmalloc(ncells * sizeof(*shadow_chars));
+      shadow_attrs = xmalloc(ncells * sizeof(*shadow_attrs));
+    }
+    shadow_width = (int)width;
+    shadow_height = (int)height;
+    shadow_fill(0, height, 0, width, -1);
+  }
+}
+
+static void ui_comp_grid_clear(UI *ui, Integer grid)
+{
+  if (grid == 1) {
+    shadow_fill(0, shadow_height, 0, shadow_width, 0);
+    ui_composed_call_grid_clear(1);
   }
 }
 
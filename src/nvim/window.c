@@ -718,7 +718,7 @@ void win_config_float(win_T *wp, FloatConfig fconfig)
   bool has_border = wp->w_floating && wp->w_float_config.border;
   for (int i = 0; i < 4; i++) {
     wp->w_border_adj[i] =
-      has_border && wp->w_float_config.border_chars[2 * i+1][0];
+      has_border && wp->w_float_config.border_chars[2 * i + 1] != 0;
   }
 
   if (!ui_has(kUIMultigrid)) {
@@ -4636,6 +4636,7 @@ win_free (
   }
 
   xfree(wp->w_lines);
+  line_cache_free(wp);
 
   for (i = 0; i < wp->w_tagstacklen; i++) {
     xfree(wp->w_tagstack[i].tagname);
@@ -0,0 +1,126 @@
+-- Benchmarks for the memline/memfile operations: appending, deleting and
+-- replacing lines, getting lines in sequential and random order and
+-- line2byte().
+--
+-- The work is timed inside Nvim, so that RPC overhead is not included.  Each
+-- result is printed and written as one JSON object per line to the file in
+-- $NVIM_BENCH_OUTPUT (default "memline_bench.json"), for tracking
+-- regressions.  $NVIM_BENCH_MAX_LINES limits the buffer sizes, the default
+-- stops at 1000000 lines; use 10000000 for the biggest buffers.
+
+local helpers = require('test.functional.helpers')(after_each)
+local clear, exec_lua = helpers.clear, helpers.exec_lua
+
+local result_file = os.getenv('NVIM_BENCH_OUTPUT') or 'memline_bench.json'
+local max_lines = tonumber(os.getenv('NVIM_BENCH_MAX_LINES')) or 1000000
+local sizes = {}
+for _, n in ipairs({10000, 100000, 1000000, 10000000}) do
+  if n <= max_lines then
+    table.insert(sizes, n)
+  end
+end
+
+-- Lua code run in Nvim.  Every benchmark gets a new buffer of "n" lines and
+-- returns the time it took in nanoseconds for "count" operations.
+local bench_code = [[
+  local name, n = ...
+  local api = vim.api
+  local hrtime = vim.loop.hrtime
+
+  local function lines(count, from)
+    local t = {}
+    for i = 1, count do
+      t[i] = 'line ' .. (from + i) .. ' of the memline benchmark'
+    end
+    return t
+  end
+
+  local buf = api.nvim_create_buf(false, true)
+  api.nvim_set_current_buf(buf)
+  api.nvim_buf_set_lines(buf, 0, -1, true, lines(n, 0))
+  -- Same random sequence for every run.
+  math.randomseed(42)
+  local count = math.min(n, 100000)
+  local start = hrtime()
+
+  if name == 'append' then
+    for i = 1, count do
+      api.nvim_buf_set_lines(buf, n - 1 + i, n - 1 + i, true, {'appended'})
+    end
+  elseif name == 'append_random' then
+    for i = 1, count do
+      local lnum = math.random(0, n + i - 1)
+      api.nvim_buf_set_lines(buf, lnum, lnum, true, {'inserted'})
+    end
+  elseif name == 'delete' then
+    count = math.min(count, n - 1)
+    for _ = 1, count do
+      api.nvim_buf_set_lines(buf, 0, 1, true, {})
+    end
+  elseif name == 'replace' then
+    for _ = 1, count do
+      local lnum = math.random(0, n - 1)
+      api.nvim_buf_set_lines(buf, lnum, lnum + 1, true, {'replaced line'})
+    end
+  elseif name == 'get_sequential' then
+    for lnum = 0, count - 1 do
+      api.nvim_buf_get_lines(buf, lnum, lnum + 1, true)
+    end
+  elseif name == 'get_random' then
+    for _ = 1, count do
+      local lnum = math.random(0, n - 1)
+      api.nvim_buf_get_lines(buf, lnum, lnum + 1, true)
+    end
+  elseif name == 'line2byte' then
+    local line2byte = vim.fn.line2byte
+    for _ = 1, count do
+      line2byte(math.random(1, n))
+    end
+  elseif name == 'line2byte_after_change' then
+    local line2byte = vim.fn.line2byte
+    for _ = 1, count do
+      local lnum = math.random(1, n)
+      api.nvim_buf_set_lines(buf, lnum - 1, lnum, true, {'changed'})
+      line2byte(math.random(1, n))
+    end
+  end
+
+  local elapsed = hrtime() - start
+  api.nvim_buf_delete(buf, {force = true})
+  return {elapsed, count}
+]]
+
+local benchmarks = {
+  'append', 'append_random', 'delete', 'replace', 'get_sequential',
+  'get_random', 'line2byte', 'line2byte_after_change',
+}
+
+describe('memline', function()
+  local results = {}
+
+  setup(clear)
+
+  teardown(function()
+    local f = assert(io.open(result_file, 'w'))
+    print ''
+    for _, r in ipairs(results) do
+      local line = string.format(
+        '{"benchmark": "%s", "lines": %d, "count": %d, "ns": %d, '
+        .. '"ns_per_op": %.1f}', r.name, r.lines, r.count, r.ns,
+        r.ns / r.count)
+      print(line)
+      f:write(line, '\n')
+    end
+    f:close()
+  end)
+
+  for _, name in ipairs(benchmarks) do
+    for _, n in ipairs(sizes) do
+      it(name .. ' with ' .. n .. ' lines', function()
+        local r = exec_lua(bench_code, name, n)
+        table.insert(results, {name = name, lines = n, ns = r[1],
+                               count = r[2]})
+      end)
+    end
+  end
+end)
@@ -0,0 +1,74 @@
+-- Benchmark for comparing drawn lines with the screen grid, which decides
+-- what is sent to the UI.  A big screen is redrawn with unchanged text (all
+-- cells are equal) and with changed text (all cells differ).
+--
+-- The work is timed inside Nvim.  $NVIM_BENCH_COLUMNS and $NVIM_BENCH_ROWS
+-- set the screen size, default 400x120.
+
+local helpers = require('test.functional.helpers')(after_each)
+local Screen = require('test.functional.ui.screen')
+local clear, exec_lua = helpers.clear, helpers.exec_lua
+
+local columns = tonumber(os.getenv('NVIM_BENCH_COLUMNS')) or 400
+local rows = tonumber(os.getenv('NVIM_BENCH_ROWS')) or 120
+local count = 200
+
+local bench_code = [[
+  local changed, count = ...
+  local api = vim.api
+  local width = vim.o.columns
+  local line_a = string.rep('abcdefghij', width / 10 + 1)
+  local line_b = string.rep('ABCDEFGHIJ', width / 10 + 1)
+
+  local function fill(line)
+    local lines = {}
+    for i = 1, vim.o.lines do
+      lines[i] = line
+    end
+    api.nvim_buf_set_lines(0, 0, -1, true, lines)
+  end
+
+  fill(line_a)
+  vim.cmd('redraw')
+  local total = 0
+  for i = 1, count do
+    if changed then
+      fill(i % 2 == 0 and line_a or line_b)
+    else
+      api.nvim__buf_redraw_range(0, 0, -1)
+    end
+    local start = vim.loop.hrtime()
+    vim.cmd('redraw')
+    total = total + vim.loop.hrtime() - start
+  end
+  return total
+]]
+
+describe('redraw', function()
+  local results = {}
+
+  before_each(function()
+    clear()
+    local screen = Screen.new(columns, rows)
+    screen:attach()
+    helpers.command('set nowrap')
+  end)
+
+  teardown(function()
+    print ''
+    for _, r in ipairs(results) do
+      print(string.format('%s: %dx%d, %.1f us per redraw', r.name, columns,
+                          rows, r.ns / count / 1000))
+    end
+  end)
+
+  it('with unchanged cells', function()
+    local ns = exec_lua(bench_code, false, count)
+    table.insert(results, {name = 'unchanged', ns = ns})
+  end)
+
+  it('with changed cells', function()
+    local ns = exec_lua(bench_code, true, count)
+    table.insert(results, {name = 'changed', ns = ns})
+  end)
+end)
@@ -287,6 +287,27 @@ describe('api/buf', function()
       end
     end)
 
+    it('works with many lines spanning several blocks', function()
+      local lines = {}
+      for i = 1, 5000 do
+        lines[i] = ('line %d '):format(i)..('x'):rep(i % 97)
+      end
+      set_lines(0, -1, true, lines)
+      eq(lines, get_lines(0, -1, true))
+      -- Insert in the middle, after lines in a full block.
+      set_lines(2500, 2500, true, lines)
+      eq(10000, curbufmeths.line_count())
+      eq(lines[2500], get_lines(2499, 2500, true)[1])
+      eq(lines[1], get_lines(2500, 2501, true)[1])
+      eq(lines[5000], get_lines(7499, 7500, true)[1])
+      eq(lines[2501], get_lines(7500, 7501, true)[1])
+      local offset = 1
+      for _, l in ipairs(get_lines(0, -2, true)) do
+        offset = offset + #l + 1
+      end
+      eq(offset, funcs.line2byte(10000))
+    end)
+
     it('can get line ranges with non-strict indexing', function()
       set_lines(0, -1, true, {'a', 'b', 'c'})
       eq({'a', 'b', 'c'}, get_lines(0, -1, true)) --sanity
@@ -572,6 +593,30 @@ describe('api/buf', function()
       command("bunload! 1")
       eq(-1, bufmeths.get_offset(1,1))
     end)
+
+    it('works after changes in a big buffer', function()
+      local lines = {}
+      for i = 1, 20000 do
+        lines[i] = ('x'):rep(i % 37)
+      end
+      curbufmeths.set_lines(0, -1, true, lines)
+      -- Split blocks in the middle, delete whole blocks, change a line.
+      curbufmeths.set_lines(5000, 5000, true, {('y'):rep(3000), 'z'})
+      curbufmeths.set_lines(9000, 12000, true, {})
+      curbufmeths.set_lines(100, 101, true, {('w'):rep(100)})
+      lines = curbufmeths.get_lines(0, -1, true)
+
+      local offset = 0
+      for i = 1, #lines do
+        if i % 997 == 1 or i == 5001 or i == 5002 or i == 9001 then
+          eq(offset, get_offset(i - 1))
+          eq(i, funcs.byte2line(offset + 1))
+        end
+        offset = offset + #lines[i] + 1
+      end
+      eq(offset, get_offset(#lines))
+      eq(-1, funcs.byte2line(offset + 1))
+    end)
   end)
 
   describe('nvim_buf_get_var, nvim_buf_set_var, nvim_buf_del_var', function()
@@ -22,6 +22,20 @@ describe('notify', function()
       command('set filetype=lua')
       eq({'notification', 'lua!', {}}, next_msg())
     end)
+
+    it('sends notifications of one request in order', function()
+      local writes = meths._stats().rpc_write
+      -- About 110 KiB, written together at the end of the request, in chunks
+      -- of 64 KiB.
+      command('for i in range(1000) | call rpcnotify('..channel..
+              ', "seq", i, repeat("x", 100)) | endfor')
+      for i = 0, 999 do
+        eq({'notification', 'seq', {i, string.rep('x', 100)}}, next_msg())
+      end
+      -- The response to nvim__stats(), the first 64 KiB, and the rest with
+      -- the response to the command.
+      eq(3, meths._stats().rpc_write - writes)
+    end)
   end)
 
   describe('passing 0 as the channel id', function()
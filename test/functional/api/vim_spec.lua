@@ -1,6 +1,8 @@
 local helpers = require('test.functional.helpers')(after_each)
 local Screen = require('test.functional.ui.screen')
 
+local luv = require('luv')
+local mpack = require('mpack')
 local NIL = helpers.NIL
 local clear, nvim, eq, neq = helpers.clear, helpers.nvim, helpers.eq, helpers.neq
 local command = helpers.command
@@ -25,6 +27,61 @@ local intchar2lua = helpers.intchar2lua
 local mergedicts_copy = helpers.mergedicts_copy
 local endswith = helpers.endswith
 
+-- Starts an Nvim that talks msgpack through raw pipes, so that a test
+-- controls the bytes sent and when they arrive.  "received" holds the bytes
+-- not yet read by next_msg().
+local function raw_client()
+  local stdin, stdout = luv.new_pipe(false), luv.new_pipe(false)
+  local proc = luv.spawn(helpers.nvim_prog, {
+    args = {'-u', 'NONE', '-i', 'NONE', '--headless', '--embed'},
+    stdio = {stdin, stdout, nil},
+  }, function() end)
+  local client = {received = ''}
+  local unpack = mpack.Unpacker()
+  stdout:read_start(function(err, chunk)
+    assert(not err, err)
+    client.received = client.received .. (chunk or '')
+  end)
+
+  function client.write(data)
+    stdin:write(data)
+  end
+
+  -- Runs the event loop until cond() is true.
+  function client.wait(cond)
+    local timer = luv.new_timer()
+    local timed_out = false
+    timer:start(10000, 0, function() timed_out = true end)
+    while not cond() and not timed_out do
+      luv.run('once')
+    end
+    timer:close()
+    assert(not timed_out, 'timed out')
+  end
+
+  function client.next_msg()
+    local msg
+    client.wait(function()
+      if client.received ~= '' then
+        local pos
+        msg, pos = unpack(client.received)
+        client.received = client.received:sub(pos)
+      end
+      return msg ~= nil
+    end)
+    return msg
+  end
+
+  function client.close()
+    stdout:close()
+    stdin:close()
+    proc:kill('sigterm')
+    proc:close()
+  end
+
+  return client
+end
+
 describe('API', function()
   before_each(clear)
 
@@ -70,6 +127,22 @@ describe('API', function()
     eq(2, eval('1+1'))
   end)
 
+  it('handles big requests in order', function()
+    -- Big requests are decoded on another thread, the small ones after them
+    -- must still be handled after them.
+    local lines = {}
+    for i = 1, 20000 do
+      lines[i] = 'line '..i
+    end
+    nvim_async('buf_set_lines', 0, 0, -1, true, lines)
+    nvim_async('buf_set_lines', 0, 0, 1, true, {'first'})
+    eq(20000, eval('line("$")'))
+    eq('first', funcs.getline(1))
+    eq('line 20000', funcs.getline('$'))
+    request('nvim_buf_set_lines', 0, 0, -1, true, lines)
+    eq('line 1', funcs.getline(1))
+  end)
+
   it('does not set CA_COMMAND_BUSY #7254', function()
     nvim('command', 'split')
     nvim('command', 'autocmd WinEnter * startinsert')
@@ -77,6 +150,92 @@ describe('API', function()
     eq({mode='i', blocking=false}, nvim("get_mode"))
   end)
 
+  describe('string arguments', function()
+    local pack = mpack.Packer()
+    local client
+
+    before_each(function()
+      client = raw_client()
+    end)
+
+    after_each(function()
+      client.close()
+    end)
+
+    -- A request that returns its arguments.
+    local function echo_request(id, args)
+      return pack({0, id, 'nvim_exec_lua', {'return {...}', args}})
+    end
+
+    local function expect_echo(id, args)
+      eq({1, id, NIL, args}, client.next_msg())
+    end
+
+    -- Sends "msg" in parts, cut before the given positions.
+    local function write_split(msg, cuts)
+      local pos = 1
+      for _, cut in ipairs(cuts) do
+        client.write(msg:sub(pos, cut - 1))
+        luv.run('nowait')
+        helpers.sleep(10)
+        pos = cut
+      end
+      client.write(msg:sub(pos))
+    end
+
+    it('at the start, in the middle and at the end of a request', function()
+      local args = {'start', 'middle', '', 'x', 'end'}
+      client.write(echo_request(1, args))
+      expect_echo(1, args)
+      -- nvim_exec() uses the source as a C string, the boolean after it is
+      -- overwritten with a NUL.
+      client.write(pack({0, 2, 'nvim_exec', {'echo "abc"', true}}))
+      eq({1, 2, NIL, 'abc'}, client.next_msg())
+    end)
+
+    it('inside maps and arrays', function()
+      local args = {{key='value', list={'a', {deep='b'}, ''}}, {'c', {'d'}}, 'e'}
+      client.write(echo_request(1, args))
+      expect_echo(1, args)
+    end)
+
+    it('in a request split across reads', function()
+      local big = string.rep('x', 1000)
+      local args = {'before', big, 'after'}
+      local msg = echo_request(1, args)
+      local start = msg:find(big, 1, true)
+      -- In the middle of a string, right after one, and in the last one.
+      write_split(msg, {start + 10, start + #big, #msg - 2})
+      expect_echo(1, args)
+
+      msg = echo_request(2, {'a', 'bc'})
+      local cuts = {}
+      for i = 2, #msg do
+        cuts[#cuts + 1] = i
+      end
+      write_split(msg, cuts)
+      expect_echo(2, {'a', 'bc'})
+    end)
+
+    it('in several requests in one read', function()
+      client.write(echo_request(1, {'one'})
+                   ..echo_request(2, {'two', 'three'})
+                   ..pack({0, 3, 'nvim_exec', {'echo "four"', true}}))
+      expect_echo(1, {'one'})
+      expect_echo(2, {'two', 'three'})
+      eq({1, 3, NIL, 'four'}, client.next_msg())
+    end)
+
+    it('in big requests', function()
+      -- Decoded on the decoder thread.
+      local big = string.rep('y', 100000)
+      local args = {big, {k=big}, 'z'}
+      client.write(echo_request(1, args)..echo_request(2, {big}))
+      expect_echo(1, args)
+      expect_echo(2, {big})
+    end)
+  end)
+
   describe('nvim_exec', function()
     it('one-line input', function()
       nvim('exec', "let x1 = 'a'", false)
@@ -1522,6 +1681,68 @@ describe('API', function()
     end)
   end)
 
+  describe('nvim__call_batch', function()
+    it('sends the results before the response', function()
+      meths.buf_set_lines(0, 0, -1, true, {'first'})
+      local req = {
+        {'nvim_get_current_line', {}},
+        {'nvim_set_current_line', {'second'}},
+        {'nvim_get_current_line', {}},
+      }
+      eq({3, NIL}, request('nvim__call_batch', req))
+      eq({'notification', 'nvim__call_batch', {0, 'first'}}, next_msg())
+      eq({'notification', 'nvim__call_batch', {1, NIL}}, next_msg())
+      eq({'notification', 'nvim__call_batch', {2, 'second'}}, next_msg())
+    end)
+
+    it('is aborted by errors in call', function()
+      local error_types = meths.get_api_info()[2].error_types
+      local req = {
+        {'nvim_set_var', {'one', 1}},
+        {'nvim_buf_set_lines', {}},
+        {'nvim_set_var', {'two', 2}},
+      }
+      eq({1, {1, error_types.Exception.id,
+              'Wrong number of arguments: expecting 5 but got 0'}},
+         request('nvim__call_batch', req))
+      eq({'notification', 'nvim__call_batch', {0, NIL}}, next_msg())
+      eq(1, meths.get_var('one'))
+      eq(false, pcall(meths.get_var, 'two'))
+    end)
+
+    it('makes no call when an item is malformed', function()
+      local req = {
+        {'nvim_set_var', {'avar', 1}},
+        {'nvim_set_var'},
+      }
+      local status, err = pcall(request, 'nvim__call_batch', req)
+      eq(false, status)
+      ok(err:match('Items in calls array must be arrays of size 2') ~= nil)
+      eq(false, pcall(meths.get_var, 'avar'))
+    end)
+  end)
+
+  it('writes the responses to pipelined requests together', function()
+    local client = raw_client()
+    local pack = mpack.Packer()
+    client.write(pack({0, 1, 'nvim__stats', {}}))
+    local writes = client.next_msg()[4].rpc_write
+    local reqs = {}
+    for id = 2, 201 do
+      table.insert(reqs, pack({0, id, 'nvim_eval', {tostring(id)}}))
+    end
+    client.write(table.concat(reqs))
+    for id = 2, 201 do
+      eq({1, id, NIL, id}, client.next_msg())
+    end
+    client.write(pack({0, 202, 'nvim__stats', {}}))
+    writes = client.next_msg()[4].rpc_write - writes
+    client.close()
+    -- The response to the first nvim__stats() and a few batches, not one
+    -- write per response.
+    ok(writes < 20, 'fewer than 20 writes, got '..writes)
+  end)
+
   describe('nvim_list_runtime_paths', function()
     it('returns nothing with empty &runtimepath', function()
       meths.set_option('runtimepath', '')
@@ -2195,4 +2416,208 @@ describe('API', function()
       ]]}
     end)
   end)
+
+  describe('nvim__redraw_profile', function()
+    local screen
+    before_each(function()
+      screen = Screen.new(40, 6)
+      screen:attach()
+    end)
+
+    it('collects timing and counters of redraws', function()
+      eq(false, request('nvim__redraw_profile', {}).enabled)
+      request('nvim__redraw_profile', {enable=true, reset=true})
+      meths.buf_set_lines(0, 0, -1, true, {'foo', 'bar'})
+      screen:expect{grid=[[
+        ^foo                                     |
+        bar                                     |
+        {1:~                                       }|
+        {1:~                                       }|
+        {1:~                                       }|
+                                                |
+      ]], attr_ids={[1] = {bold = true, foreground = Screen.colors.Blue1}}}
+      local stats = request('nvim__redraw_profile', {enable=false})
+      eq(false, stats.enabled)
+      ok(stats.frames > 0)
+      ok(stats.lines >= 2)
+      ok(stats.cells > 0)
+      ok(stats.bytes > 0)
+      eq(stats.frames, stats.phases.frame.count)
+      ok(stats.phases.line.count >= 2)
+      eq(17, #stats.phases.screen.hist)
+
+      command('redraw!')
+      eq(stats.frames, request('nvim__redraw_profile', {}).frames)
+      eq(0, request('nvim__redraw_profile', {reset=true}).frames)
+    end)
+
+    it('writes a line per frame to a log file', function()
+      local fname = tmpname()
+      request('nvim__redraw_profile', {enable=true, log=fname})
+      command('redraw!')
+      request('nvim__redraw_profile', {enable=false, log=''})
+      local lines = helpers.read_file(fname)
+      os.remove(fname)
+      matches('frame%s+screen%s+window', lines)
+      matches('\n%s*%d+%.%d+ ', lines)
+    end)
+
+    it('validates options', function()
+      eq('unexpected key: foo',
+         pcall_err(request, 'nvim__redraw_profile', {foo=true}))
+      eq('invalid value for key: enable',
+         pcall_err(request, 'nvim__redraw_profile', {enable='yes'}))
+    end)
+  end)
+
+  describe('nvim__shm_attach', function()
+    it('creates the shared memory', function()
+      if iswin() then
+        pending('N/A: no mmap() on Windows')
+        return
+      end
+      -- The channel is unusable without a shared memory client afterwards.
+      local shm_nvim = helpers.spawn(helpers.nvim_argv)
+      helpers.set_session(shm_nvim)
+      local info = request('nvim__shm_attach', 100000)
+      eq(131072, info.size)
+      local f = io.open(info.path, 'rb')
+      eq('NVSM', f:read(4))
+      eq(4096 + 2 * info.size, f:seek('end'))
+      f:close()
+      shm_nvim:close()
+      clear()
+    end)
+
+    it('exchanges messages through the rings', function()
+      if iswin() then
+        pending('N/A: no mmap() on Windows')
+        return
+      end
+      local has_ffi, ffi = pcall(require, 'ffi')
+      if not has_ffi then
+        pending('N/A: needs LuaJIT')
+        return
+      end
+      pcall(ffi.cdef, [[
+        void *mmap(void *addr, size_t length, int prot, int flags, int fd,
+                   long offset);
+        int munmap(void *addr, size_t length);
+        int open(const char *pathname, int flags, ...);
+        int close(int fd);
+      ]])
+      local PROT_READ_WRITE, MAP_SHARED, O_RDWR = 3, 1, 2
+
+      local client = raw_client()
+      local wait = client.wait
+      local pack, unpack = mpack.Packer(), mpack.Unpacker()
+
+      client.write(pack({0, 1, 'nvim__shm_attach', {0}}))
+      local msg = client.next_msg()
+      eq({1, 1, NIL}, {msg[1], msg[2], msg[3]})
+      local info = msg[4]
+      eq('', client.received)
+
+      local fd = ffi.C.open(info.path, O_RDWR)
+      ok(fd >= 0)
+      local size = info.size
+      local mapsize = 4096 + 2 * size
+      local mem = ffi.cast('char *', ffi.C.mmap(nil, mapsize, PROT_READ_WRITE,
+                                                MAP_SHARED, fd, 0))
+      ffi.C.close(fd)
+      ok(mem ~= ffi.cast('char *', -1))
+      -- head, tail and waiting of the client ring at offset 64, of the
+      -- server ring at offset 128.
+      local hdr = ffi.cast('volatile uint32_t *', mem)
+      local IN_HEAD, IN_TAIL, IN_WAITING = 16, 17, 18
+      local OUT_HEAD, OUT_TAIL, OUT_WAITING = 32, 33, 34
+      local in_ring, out_ring = mem + 4096, mem + 4096 + size
+
+      -- Only doorbell bytes go through the pipes now.
+      local function ring_bell()
+        client.write('\0')
+      end
+      local client_waited = false
+      local function send(data)
+        local pos = 1
+        while pos <= #data do
+          local head = hdr[IN_HEAD]
+          local n = math.min(size - (head - hdr[IN_TAIL]), #data - pos + 1)
+          if n == 0 then
+            client_waited = true
+            local bells = #client.received
+            hdr[IN_WAITING] = 1
+            ring_bell()
+            wait(function() return #client.received > bells end)
+          else
+            local off = head % size
+            local first = math.min(n, size - off)
+            ffi.copy(in_ring + off, data:sub(pos, pos + first - 1), first)
+            ffi.copy(in_ring, data:sub(pos + first, pos + n - 1), n - first)
+            hdr[IN_HEAD] = head + n
+            pos = pos + n
+          end
+        end
+        ring_bell()
+      end
+      local server_waited = false
+      local function receive()
+        local rv
+        wait(function()
+          local head, tail = hdr[OUT_HEAD], hdr[OUT_TAIL]
+          if head ~= tail then
+            local n = head - tail
+            local off = tail % size
+            local first = math.min(n, size - off)
+            local chunk = (ffi.string(out_ring + off, first)
+                           .. ffi.string(out_ring, n - first))
+            hdr[OUT_TAIL] = tail + n
+            rv = unpack(chunk)
+          end
+          if hdr[OUT_WAITING] ~= 0 then
+            server_waited = true
+            hdr[OUT_WAITING] = 0
+            ring_bell()
+          end
+          return rv ~= nil
+        end)
+        return rv
+      end
+
+      send(pack({0, 2, 'nvim_eval', {'1+1'}}))
+      eq({1, 2, NIL, 2}, receive())
+      eq({false, false}, {client_waited, server_waited})
+
+      -- A response that does not fit in the server ring.
+      send(pack({0, 3, 'nvim_eval', {"repeat('x', 200000)"}}))
+      eq({1, 3, NIL, string.rep('x', 200000)}, receive())
+      eq(true, server_waited)
+
+      -- A request that does not fit in the client ring.
+      send(pack({0, 4, 'nvim_eval',
+                 {"strlen('"..string.rep('y', 200000).."')"}}))
+      eq({1, 4, NIL, 200000}, receive())
+      eq(true, client_waited)
+      eq(0, hdr[IN_WAITING])
+
+      ffi.C.munmap(mem, mapsize)
+      client.close()
+    end)
+
+    it('rejects a notification', function()
+      local error_types = meths.get_api_info()[2].error_types
+      nvim_async('_shm_attach', 0)
+      eq({'notification', 'nvim_error_event',
+          {error_types.Exception.id,
+           'nvim__shm_attach must be called as a request'}}, next_msg())
+      -- The channel still uses the socket.
+      eq(2, eval('1+1'))
+    end)
+
+    it('validates the size', function()
+      eq('Invalid size: -1', pcall_err(request, 'nvim__shm_attach', -1))
+      eq('Invalid size: 134217728',
+         pcall_err(request, 'nvim__shm_attach', 134217728))
+    end)
+  end)
 end)
@@ -12,9 +12,11 @@ local rmdir = helpers.rmdir
 local mkdir = helpers.mkdir
 local sleep = helpers.sleep
 local read_file = helpers.read_file
+local write_file = helpers.write_file
 local trim = helpers.trim
 local currentdir = helpers.funcs.getcwd
 local iswin = helpers.iswin
+local Screen = require('test.functional.ui.screen')
 
 describe('fileio', function()
   before_each(function()
@@ -26,6 +28,7 @@ describe('fileio', function()
     os.remove('Xtest_startup_file1~')
     os.remove('Xtest_startup_file2')
     os.remove('Xtest_тест.md')
+    os.remove('Xtest_big_file')
     rmdir('Xtest_startup_swapdir')
     rmdir('Xtest_backupdir')
   end)
@@ -128,5 +131,171 @@ describe('fileio', function()
     table.insert(text, '')
     eq(text, funcs.readfile(fname, 'b'))
   end)
+
+  describe('big file', function()
+    -- Big enough to be read through a memory mapping.
+    local nlines = 100000
+    local function big_text(eol, last_eol)
+      local lines = {}
+      for i = 1, nlines do
+        lines[i] = 'line '..i..' тест'
+      end
+      return table.concat(lines, eol)..(last_eol and eol or '')
+    end
+
+    before_each(clear)
+
+    it('unix format', function()
+      write_file('Xtest_big_file', big_text('\n', true), true)
+      command('edit Xtest_big_file')
+      eq(nlines, funcs.line('$'))
+      eq('unix', helpers.eval('&fileformat'))
+      eq(1, helpers.eval('&eol'))
+      eq('line 1 тест', funcs.getline(1))
+      eq('line 54321 тест', funcs.getline(54321))
+      eq('line '..nlines..' тест', funcs.getline('$'))
+    end)
+
+    it('dos format without end-of-line', function()
+      write_file('Xtest_big_file', big_text('\r\n', false), true)
+      command('edit Xtest_big_file')
+      eq(nlines, funcs.line('$'))
+      eq('dos', helpers.eval('&fileformat'))
+      eq(0, helpers.eval('&eol'))
+      eq('line 2 тест', funcs.getline(2))
+      eq('line '..nlines..' тест', funcs.getline('$'))
+    end)
+
+    it('mixed line endings', function()
+      write_file('Xtest_big_file', 'first\r\n'..big_text('\n', true), true)
+      command('edit Xtest_big_file')
+      eq(nlines + 1, funcs.line('$'))
+      eq('unix', helpers.eval('&fileformat'))
+      eq('first\r', funcs.getline(1))
+    end)
+
+    it('with NUL bytes', function()
+      write_file('Xtest_big_file', 'a\0b\n'..big_text('\n', true), true)
+      command('edit Xtest_big_file')
+      eq(nlines + 1, funcs.line('$'))
+      eq('a\nb', funcs.getline(1))
+    end)
+
+    it("releases blocks above 'maxmem'", function()
+      clear({ args={ '--cmd', 'set directory=Xtest_startup_swapdir' } })
+      mkdir('Xtest_startup_swapdir')
+      write_file('Xtest_big_file', big_text('\n', true), true)
+      command('set maxmem=64')
+      command('edit Xtest_big_file')
+      command('%s/$/ x/')
+      local stats = request('nvim__stats')
+      eq(true, stats.memfile_release > 0)
+      eq(true, stats.memfile_write > 0)
+      eq('line 1 тест x', funcs.getline(1))
+      eq('line 54321 тест x', funcs.getline(54321))
+      eq(true, request('nvim__stats').memfile_read > 0)
+      eq(nlines, funcs.line('$'))
+    end)
+
+    it("compresses blocks above 'maxmem' without a swap file", function()
+      write_file('Xtest_big_file', big_text('\n', true), true)
+      command('set maxmem=64 noswapfile')
+      command('edit Xtest_big_file')
+      command('%s/$/ x/')
+      eq(true, request('nvim__stats').memfile_pack > 0)
+      eq(0, request('nvim__stats').memfile_write)
+      eq('line 1 тест x', funcs.getline(1))
+      eq('line 54321 тест x', funcs.getline(54321))
+      command('2,$d')
+      command('undo')
+      eq('line '..nlines..' тест x', funcs.getline('$'))
+      eq(nlines, funcs.line('$'))
+    end)
+
+    it('does not compress blocks again that did not compress', function()
+      local lines = {}
+      math.randomseed(42)
+      for i = 1, 20000 do
+        local chars = {}
+        for j = 1, 60 do
+          chars[j] = string.char(math.random(33, 126))
+        end
+        lines[i] = table.concat(chars)
+      end
+      write_file('Xtest_big_file', table.concat(lines, '\n')..'\n', true)
+      command('set maxmem=64 noswapfile')
+      command('edit Xtest_big_file')
+      local nopack = request('nvim__stats').memfile_nopack
+      eq(true, nopack > 0)
+      -- Getting every block again must not compress any of them again.
+      command('call getline(1, "$")')
+      command('call getline(1, "$")')
+      eq(nopack, request('nvim__stats').memfile_nopack)
+      eq(lines[12345], funcs.getline(12345))
+    end)
+
+    it('shows the top while reading', function()
+      write_file('Xtest_big_file', big_text('\n', true), true)
+      local screen = Screen.new(30, 4)
+      screen:attach()
+      command('edit Xtest_big_file')
+      screen:expect{any='line 3 тест'}
+      eq(nlines, funcs.line('$'))
+      eq('line '..nlines..' тест', funcs.getline('$'))
+      eq(0, helpers.eval('&readonly'))
+    end)
+
+    it('does not evaluate a status line on the partly read buffer', function()
+      write_file('Xtest_big_file', big_text('\n', true), true)
+      local screen = Screen.new(30, 4)
+      screen:attach()
+      helpers.source([[
+        let g:min_lines = -1
+        function! Lines() abort
+          if &buftype ==# '' && expand('%') ==# 'Xtest_big_file'
+            let n = line('$')
+            let g:min_lines = g:min_lines < 0 ? n : min([g:min_lines, n])
+          endif
+          return ''
+        endfunction
+        set laststatus=2 statusline=%{Lines()}
+      ]])
+      command('edit Xtest_big_file')
+      screen:expect{any='line 3 тест'}
+      eq(nlines, helpers.eval('g:min_lines'))
+    end)
+
+    it('rereads when the first lines drawn have another format', function()
+      -- The first 64 Kbyte are in dos format, the whole file is not.
+      local head = {}
+      for i = 1, 8000 do
+        head[i] = 'dos '..i..'\r\n'
+      end
+      write_file('Xtest_big_file', table.concat(head)..big_text('\n', true),
+                 true)
+      local screen = Screen.new(30, 4)
+      screen:attach()
+      command('edit Xtest_big_file')
+      eq(nlines + 8000, funcs.line('$'))
+      eq('unix', helpers.eval('&fileformat'))
+      eq('dos 1\r', funcs.getline(1))
+      eq('line 1 тест', funcs.getline(8001))
+      eq('line '..nlines..' тест', funcs.getline('$'))
+    end)
+
+    it('is written back unchanged', function()
+      local text = 'a\0b\n'..big_text('\n', true)
+      write_file('Xtest_big_file', text, true)
+      command('set maxmem=64')
+      command('edit Xtest_big_file')
+      command('3s/$/ x/')
+      command('3s/ x$//')
+      command('write')
+      eq(text, read_file('Xtest_big_file'))
+      command('set noeol nofixeol')
+      command('write')
+      eq(text:sub(1, -2), read_file('Xtest_big_file'))
+    end)
+  end)
 end)
 
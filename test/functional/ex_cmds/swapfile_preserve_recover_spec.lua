@@ -14,6 +14,7 @@ local spawn = helpers.spawn
 local nvim_async = helpers.nvim_async
 local expect_msg_seq = helpers.expect_msg_seq
 local pcall_err = helpers.pcall_err
+local retry = helpers.retry
 
 describe(':recover', function()
   before_each(clear)
@@ -87,6 +88,48 @@ describe(':preserve', function()
 
 end)
 
+describe('swapfile sync on idle', function()
+  local swapdir = lfs.currentdir()..'/Xtest_recover_dir'
+  local testfile = 'Xtest_recover_file2'
+  before_each(function()
+    clear()
+    rmdir(swapdir)
+    lfs.mkdir(swapdir)
+  end)
+  after_each(function()
+    command('%bwipeout!')
+    rmdir(swapdir)
+    os.remove(testfile)
+  end)
+
+  it('can be recovered', function()
+    local init = [[
+      set directory^=]]..swapdir:gsub([[\]], [[\\]])..[[//
+      set swapfile fileformat=unix undolevels=-1
+    ]]
+
+    source(init)
+    command('edit! '..testfile)
+    command('write')
+    command('set updatetime=1')
+    feed('isometext<esc>')
+    -- Written by a worker thread, fsync() is counted when it is done.
+    retry(nil, 3000, function()
+      ok(helpers.request('nvim__stats').fsync >= 1)
+    end)
+
+    -- Start another Nvim instance.
+    local nvim2 = spawn({nvim_prog, '-u', 'NONE', '-i', 'NONE', '--embed'},
+                                true)
+    set_session(nvim2)
+
+    source(init)
+    command('autocmd SwapExists * let v:swapchoice = "r"')
+    command('silent edit! '..testfile)
+    expect('sometext')
+  end)
+end)
+
 describe('swapfile detection', function()
   local swapdir = lfs.currentdir()..'/Xtest_swapdialog_dir'
   before_each(function()
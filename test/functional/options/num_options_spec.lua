@@ -54,6 +54,8 @@ describe(':set validation', function()
     should_fail('iminsert', 3, 'E474')
     should_fail('imsearch', 3, 'E474')
     should_fail('titlelen', -1, 'E487')
+    should_fail('maxfps', -1, 'E487')
+    should_succeed('maxfps', 0)
     should_fail('cmdheight', 0, 'E487')
     should_fail('updatecount', -1, 'E487')
     should_fail('textwidth', -1, 'E487')
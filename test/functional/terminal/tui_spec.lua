@@ -1601,3 +1601,81 @@ describe('TUI bg color', function()
     screen:expect{any='new_bg=dark'}
   end)
 end)
+
+describe('TUI output', function()
+  local screen
+  local child_session
+
+  -- Starts Nvim in :terminal and collects what its TUI writes in g:tui_out.
+  local function setup(sync)
+    clear()
+    helpers.source([[
+      let g:tui_out = ''
+      function! TuiOut(id, data, event) abort
+        let g:tui_out .= join(a:data, "\n")
+      endfunction
+    ]])
+    local child_server = helpers.new_pipename()
+    screen = Screen.new(50, 7)
+    screen:attach({rgb=false})
+    -- KITTY_WINDOW_ID makes the TUI assume synchronized output.
+    helpers.meths.set_var('tui_cmd', {'sh', '-c',
+      'unset KITTY_WINDOW_ID TERM_PROGRAM; '
+      ..(sync and 'export KITTY_WINDOW_ID=1; ' or '')..'exec "$0" "$@"',
+      nvim_prog, '--listen', child_server, '-u', 'NONE', '-i', 'NONE',
+      '--cmd', nvim_set..' laststatus=2'})
+    command("enew | call termopen(g:tui_cmd, {'on_stdout': 'TuiOut'})")
+    screen:expect{any='No Name'}
+    child_session = helpers.connect(child_server)
+  end
+
+  -- Sets the text in the child and waits until the TUI wrote it.
+  local function set_text(text)
+    child_session:request('nvim_buf_set_lines', 0, 0, -1, true, {text})
+    screen:expect{any=text}
+    retry(nil, nil, function()
+      helpers.matches(text, eval('g:tui_out'))
+    end)
+    return eval('g:tui_out')
+  end
+
+  it('does not write cells the terminal already shows', function()
+    setup(false)
+    -- Nvim sends the whole line to the TUI again.
+    child_session:request('nvim_command', 'set redrawdebug+=nodelta')
+    set_text('abcdefghij')
+    command("let g:tui_out = ''")
+    child_session:request('nvim_buf_set_lines', 0, 0, -1, true,
+                          {'abcdefXhij'})
+    screen:expect{any='abcdefXhij'}
+    retry(nil, nil, function()
+      helpers.matches('X', eval('g:tui_out'))
+    end)
+    local out = eval('g:tui_out')
+    eq(nil, out:find('abcdef', 1, true))
+    eq(nil, out:find('hij', 1, true))
+  end)
+
+  it('wraps updates in synchronized output if the terminal has it', function()
+    setup(true)
+    local out = set_text('synced')
+    local function count(s, seq)
+      local _, n = s:gsub(seq, '')
+      return n
+    end
+    retry(nil, nil, function()
+      out = eval('g:tui_out')
+      eq(count(out, '\27%[%?2026h'), count(out, '\27%[%?2026l'))
+    end)
+    ok(count(out, '\27%[%?2026h') > 0)
+    -- The text was written between a begin and an end.
+    local before = out:sub(1, out:find('synced', 1, true))
+    eq(count(before, '\27%[%?2026h'), count(before, '\27%[%?2026l') + 1)
+  end)
+
+  it('does not use synchronized output otherwise', function()
+    setup(false)
+    local out = set_text('unsynced')
+    eq(nil, out:find('\27[?2026', 1, true))
+  end)
+end)
@@ -5,7 +5,7 @@ local clear, feed = helpers.clear, helpers.feed
 local assert_alive = helpers.assert_alive
 local command, feed_command = helpers.command, helpers.feed_command
 local eval = helpers.eval
-local eq = helpers.eq
+local eq, neq = helpers.eq, helpers.neq
 local exec_lua = helpers.exec_lua
 local insert = helpers.insert
 local meths = helpers.meths
@@ -6460,5 +6460,104 @@ describe('float window', function()
   describe('without ext_multigrid', function()
     with_ext_multigrid(false)
   end)
+
+  describe('composed screen', function()
+    local screen
+    local sent  -- number of cells sent, by row
+
+    before_each(function()
+      screen = Screen.new(40, 7)
+      screen:attach()
+      local handle_grid_line = screen._handle_grid_line
+      screen._handle_grid_line = function(self, grid, row, col, items)
+        for _, item in ipairs(items) do
+          sent[row] = (sent[row] or 0) + (item[3] or 1)
+        end
+        handle_grid_line(self, grid, row, col, items)
+      end
+      sent = {}
+    end)
+
+    local function cell(row, col)
+      return screen._grids[1].rows[row+1][col+1]
+    end
+
+    it('sends only the cells that changed when a float moves', function()
+      meths.buf_set_lines(0, 0, -1, true,
+                          {'background', 'background', 'background',
+                           'background', 'background'})
+      local buf = meths.create_buf(false, false)
+      meths.buf_set_lines(buf, 0, -1, true, {'aaaaaaaaaa', 'aaaaaaaaaa'})
+      local win = meths.open_win(buf, false, {relative='editor', width=10,
+                                              height=2, row=1, col=5})
+      screen:expect(function()
+        eq('a', cell(2, 5).text)
+      end)
+
+      sent = {}
+      meths.win_set_config(win, {relative='editor', row=2, col=5})
+      screen:expect(function()
+        eq('a', cell(3, 5).text)
+        eq('r', cell(1, 5).text)
+      end)
+      -- The row the float left and the row it moved to.  The row that shows
+      -- the float before and after is not sent again.
+      eq(10, sent[1])
+      eq(nil, sent[2])
+      eq(10, sent[3])
+    end)
+
+    it('sends only the popupmenu rows that changed', function()
+      feed([[i<C-r>=complete(1, ['aa', 'bb', 'cc', 'dd'])?'':''<CR>]])
+      screen:expect(function()
+        eq('a', cell(0, 0).text)
+        eq('d', cell(4, 1).text)
+      end)
+
+      sent = {}
+      feed('<C-n>')
+      screen:expect(function()
+        eq('b', cell(0, 0).text)
+      end)
+      -- The selection moved from the first item to the second one.
+      neq(nil, sent[1])
+      neq(nil, sent[2])
+      eq(nil, sent[3])
+      eq(nil, sent[4])
+    end)
+
+    it('blends again after a highlight or winblend change', function()
+      command('hi NormalFloat guibg=Red')
+      meths.buf_set_lines(0, 0, -1, true, {'background'})
+      local buf = meths.create_buf(false, false)
+      meths.buf_set_lines(buf, 0, -1, true, {'          '})
+      local win = meths.open_win(buf, false, {relative='editor', width=10,
+                                              height=1, row=0, col=0})
+      meths.win_set_option(win, 'winblend', 30)
+
+      -- Waits until the text behind the float shows through with another
+      -- background than "old".
+      local function blended_bg(old)
+        local bg
+        screen:expect(function()
+          eq('b', cell(0, 0).text)
+          bg = screen:get_hl(cell(0, 0).hl_id).background
+          neq(nil, bg)
+          neq(old, bg)
+        end)
+        return bg
+      end
+
+      local red = blended_bg(nil)
+      command('hi NormalFloat guibg=Blue')
+      local blue = blended_bg(red)
+      command('hi NormalFloat guibg=Red')
+      eq(red, blended_bg(blue))
+      meths.win_set_option(win, 'winblend', 80)
+      local red80 = blended_bg(red)
+      meths.win_set_option(win, 'winblend', 30)
+      eq(red, blended_bg(red80))
+    end)
+  end)
 end)
 
@@ -6,6 +6,8 @@ local feed = helpers.feed
 local feed_command = helpers.feed_command
 local insert = helpers.insert
 local funcs = helpers.funcs
+local eq = helpers.eq
+local meths = helpers.meths
 
 describe("multibyte rendering", function()
   local screen
@@ -50,6 +52,22 @@ describe("multibyte rendering", function()
     ]])
   end)
 
+  it('works with composed chars longer than four bytes', function()
+    -- These do not fit in a screen cell and are kept in the glyph table, they
+    -- must not be mixed up.
+    insert('é̂ è̂ é̂')
+    screen:expect([[
+      é̂ è̂ ^é̂                                                       |
+      {1:~                                                           }|
+      {1:~                                                           }|
+      {1:~                                                           }|
+      {1:~                                                           }|
+                                                                  |
+    ]])
+    eq('è̂', meths._inspect_cell(1, 0, 2)[1])
+    eq(101, funcs.screenchar(1, 3))
+  end)
+
   it('works with doublewidth char at end of line', function()
     feed('58a <esc>a馬<esc>')
     screen:expect([[
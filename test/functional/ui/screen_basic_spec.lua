@@ -1032,3 +1032,134 @@ describe('screen with msgsep deactivated on startup', function()
     feed '<cr>'  -- skip the "Press ENTER..." state or tests will hang
   end)
 end)
+
+describe("'maxfps'", function()
+  local screen
+
+  before_each(function()
+    clear()
+    screen = Screen.new(20, 4)
+    screen:attach()
+    screen:set_default_attr_ids {
+      [0] = {bold=true, foreground=Screen.colors.Blue};
+    }
+  end)
+
+  it('delays redraws for events but draws them', function()
+    command('set maxfps=2')
+    local redraws = helpers.meths._stats().redraw
+    -- Each request changes the buffer, without the limit every one of them
+    -- would be followed by a redraw.
+    for i = 1, 20 do
+      helpers.meths.buf_set_lines(0, 0, -1, true, {'line '..i})
+    end
+    helpers.meths.buf_set_lines(0, 0, -1, true, {'two'})
+    screen:expect{grid=[[
+      ^two                 |
+      {0:~                   }|
+      {0:~                   }|
+                          |
+    ]]}
+    redraws = helpers.meths._stats().redraw - redraws
+    helpers.ok(redraws <= 3, ('%d redraws for 21 changes'):format(redraws))
+    feed('Ax<esc>')
+    screen:expect{grid=[[
+      two^x                |
+      {0:~                   }|
+      {0:~                   }|
+                          |
+    ]]}
+  end)
+
+  it('does not busy-wait in a mode entered during a deferred frame', function()
+    local function cpu_ms()
+      return helpers.exec_lua([[
+        local ru = vim.loop.getrusage()
+        return (ru.utime.sec + ru.stime.sec) * 1000
+               + (ru.utime.usec + ru.stime.usec) / 1000
+      ]])
+    end
+    command('set maxfps=1')
+    for _, keys in ipairs({'i', ':'}) do
+      -- An event in Normal mode defers the frame, the key arrives meanwhile.
+      helpers.meths.set_var('x', 1)
+      feed(keys)
+      eq(keys == 'i' and 'i' or 'c', helpers.meths.get_mode().mode)
+      local start = cpu_ms()
+      helpers.sleep(1500)
+      local used = cpu_ms() - start
+      helpers.ok(used < 500, ('used %.0f ms CPU time'):format(used))
+      feed('<esc>')
+    end
+  end)
+end)
+
+describe('screen with cached lines', function()
+  local screen
+
+  local function lines_drawn()
+    return helpers.request('nvim__redraw_profile', {}).lines
+  end
+
+  before_each(function()
+    clear()
+    screen = Screen.new(20, 6)
+    screen:attach()
+    helpers.exec_lua([[
+      local lines = {}
+      for i = 1, 20 do
+        lines[i] = 'line '..i
+      end
+      vim.api.nvim_buf_set_lines(0, 0, -1, true, lines)
+    ]])
+    screen:expect{grid=[[
+      ^line 1              |
+      line 2              |
+      line 3              |
+      line 4              |
+      line 5              |
+                          |
+    ]]}
+    feed('5<C-E>')
+    screen:expect{grid=[[
+      ^line 6              |
+      line 7              |
+      line 8              |
+      line 9              |
+      line 10             |
+                          |
+    ]]}
+  end)
+
+  it('draws lines from the cache after scrolling back', function()
+    helpers.request('nvim__redraw_profile', {enable=true, reset=true})
+    feed('5<C-Y>')
+    screen:expect{grid=[[
+      line 1              |
+      line 2              |
+      line 3              |
+      line 4              |
+      ^line 5              |
+                          |
+    ]]}
+    -- Line 1 was the cursor line and line 5 is now: they are drawn, lines 2
+    -- to 4 come from the cache.
+    eq(2, lines_drawn())
+  end)
+
+  it('does not use lines of an older changedtick', function()
+    helpers.meths.buf_set_lines(0, 1, 2, true, {'changed'})
+    command('redraw')
+    helpers.request('nvim__redraw_profile', {enable=true, reset=true})
+    feed('5<C-Y>')
+    screen:expect{grid=[[
+      line 1              |
+      changed             |
+      line 3              |
+      line 4              |
+      ^line 5              |
+                          |
+    ]]}
+    eq(5, lines_drawn())
+  end)
+end)
@@ -0,0 +1,71 @@
+local bit = require('bit')
+local helpers = require('test.unit.helpers')(after_each)
+local itp = helpers.gen_itp(it)
+
+local ffi = helpers.ffi
+local eq = helpers.eq
+local cimport = helpers.cimport
+local cppimport = helpers.cppimport
+
+local m = cimport('./src/nvim/memfile.h', './src/nvim/memory.h',
+                  './src/nvim/os/os.h')
+cppimport('fcntl.h')
+
+-- From memfile.h and memfile_defs.h.
+local MFS_ASYNC = 16
+local BH_DIRTY = 1
+local BH_ASYNC = 16
+
+local fname = 'Xtest-unit-memfile.swp'
+
+describe('mf_sync() with MFS_ASYNC', function()
+  before_each(function()
+    os.remove(fname)
+  end)
+
+  after_each(function()
+    os.remove(fname)
+  end)
+
+  itp('keeps a block the worker failed to write and writes it again', function()
+    local mfp = m.mf_open(m.xstrdup(fname),
+                          ffi.C.kO_RDWR + ffi.C.kO_CREAT + ffi.C.kO_EXCL)
+    eq(false, mfp == nil)
+    local size = mfp.mf_page_size
+    local text = ('swap block '):rep(size):sub(1, size)
+    local hp = m.mf_new(mfp, false, 1)
+    ffi.copy(hp.bh_data, text, size)
+    m.mf_put(mfp, hp, true, false)
+
+    -- Let the worker write to a descriptor that is only open for reading.
+    local fd = mfp.mf_fd
+    local ro_fd = m.os_open(fname, ffi.C.kO_RDONLY, 0)
+    eq(true, ro_fd >= 0)
+    mfp.mf_fd = ro_fd
+    eq(helpers.OK, m.mf_sync(mfp, MFS_ASYNC))
+    eq(BH_ASYNC, bit.band(hp.bh_flags, BH_ASYNC + BH_DIRTY))
+    m.mf_async_wait(mfp)
+
+    -- The block is still in memory, with its text, and dirty again.
+    eq(BH_DIRTY, bit.band(hp.bh_flags, BH_ASYNC + BH_DIRTY))
+    eq(true, mfp.mf_dirty)
+    eq(true, mfp.mf_async_failed)
+    eq(true, m.mf_get(mfp, hp.bh_bnum, 1) == hp)
+    m.mf_put(mfp, hp, false, false)
+    eq(text, ffi.string(hp.bh_data, size))
+
+    -- The next sync writes it without the worker, to report errors.
+    mfp.mf_fd = fd
+    m.os_close(ro_fd)
+    eq(helpers.OK, m.mf_sync(mfp, MFS_ASYNC))
+    eq(0, bit.band(hp.bh_flags, BH_ASYNC + BH_DIRTY))
+    eq(false, mfp.mf_async_failed)
+    eq(true, mfp.mf_async == nil)
+    local f = io.open(fname, 'rb')
+    f:seek('set', size * tonumber(hp.bh_bnum))
+    eq(text, f:read(size))
+    f:close()
+
+    m.mf_close(mfp, true)
+  end)
+end)
@@ -50,3 +50,25 @@ describe('xstrlcat()', function()
   end)
 
 end)
+
+describe('arena', function()
+  itp('allocates small and big chunks and frees them at once', function()
+    local arena = ffi.new('Arena[1]')
+    local strs = {}
+    for i = 1, 2000 do
+      local s = 'str'..i
+      strs[i] = cimp.arena_memdupz(arena, s, #s)
+    end
+    local big = ffi.cast('char *', cimp.arena_alloc(arena, 100000, true))
+    ffi.fill(big, 100000, 65)
+    local aligned = cimp.arena_alloc(arena, 8, true)
+    eq(0, tonumber(ffi.cast('uintptr_t', aligned)) % 8)
+    for i = 1, 2000 do
+      eq('str'..i, ffi.string(strs[i]))
+    end
+    eq(65, big[99999])
+    local mem = cimp.arena_finish(arena)
+    eq(nil, arena[0].cur_blk)
+    cimp.arena_mem_free(mem)
+  end)
+end)